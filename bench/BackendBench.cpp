@@ -0,0 +1,129 @@
+// GL 和软件两个烘焙后端的对比：同一批笔画（每种笔刷都有，粗细、形状各不相同）先用 GL 烘焙进底图读出来，
+// 再切到软件后端烘焙一遍，用 SoftRenderer::Compare 逐像素比较，两张结果和差异图存成 PNG。
+// 超出 SoftRenderer::TOLERANCE 的像素多于 SoftRenderer::MAX_OUTLIERS 时返回 1。
+// 没有显卡的机器用 Mesa 的软件光栅（llvmpipe）：LIBGL_ALWAYS_SOFTWARE=1 xmake run BackendBench
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <imgui_impl_opengl3.h>
+#include "Renderer.h"
+#include "SoftRenderer.h"
+#include "BrushRegistry.h"
+#include "TileCanvas.h"
+#include <stb/stb_image_write.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// 每种笔刷几笔：随机游走的折线，粗细 2~40，颜色和不透明度各不相同；再加几条样条、几个矩形和椭圆
+static void BuildStrokes(StrokeStore& strokes) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> ux(60, CANVAS_W - 60), uy(60, CANVAS_H - 60), u(-1, 1);
+    for (int b = 0; b < (int)BrushRegistry::profiles.size(); b++) {
+        for (int s = 0; s < 6; s++) {
+            std::vector<ImVec2> path;
+            ImVec2 p = {ux(rng), uy(rng)};
+            for (int i = 0; i < 40; i++) {
+                path.push_back(p);
+                p = {std::clamp(p.x + 12 * u(rng), 0.0f, (float)CANVAS_W), std::clamp(p.y + 12 * u(rng), 0.0f, (float)CANVAS_H)};
+            }
+            ImU32 color = IM_COL32(rng() % 256, rng() % 256, rng() % 256, 120 + rng() % 136);
+            size_t i = strokes.Add(path.data(), (int)path.size(), color, 2.0f + (rng() % 39), b);
+            if (s == 0) strokes.spline[i] = true;
+        }
+        // 图形是中心和两条半轴的端点
+        ImVec2 c = {ux(rng), uy(rng)};
+        float rx = 20 + 40 * (u(rng) + 1), ry = 20 + 40 * (u(rng) + 1), a = u(rng);
+        ImVec2 shape[] = {c, {c.x + rx * cosf(a), c.y + rx * sinf(a)}, {c.x - ry * sinf(a), c.y + ry * cosf(a)}};
+        size_t i = strokes.Add(shape, 3, IM_COL32(30, 30, 30, 200), 6, b);
+        strokes.shape[i] = b % 2 ? StrokeShape::Rect : StrokeShape::Ellipse;
+    }
+}
+
+static double Bake(const StrokeStore& strokes) {
+    Renderer::ClearTexture();
+    if (Renderer::backend == BakeBackend::OpenGL) glFinish();
+    auto t0 = std::chrono::steady_clock::now();
+    Renderer::BakeStrokes(strokes, 0, strokes.size());
+    if (Renderer::backend == BakeBackend::OpenGL) glFinish();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow* window = glfwCreateWindow(CANVAS_W, CANVAS_H, "BackendBench", NULL, NULL);
+    if (!window) {
+        fprintf(stderr, "Cannot create a GL 3.3 context\n");
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    printf("GL_RENDERER: %s\n", (const char*)glGetString(GL_RENDERER));
+
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = {(float)CANVAS_W, (float)CANVAS_H};
+    io.IniFilename = nullptr;
+    ImGui_ImplOpenGL3_Init("#version 330");
+    Renderer::Init();
+    Renderer::WaitForAssets();
+
+    StrokeStore strokes;
+    BuildStrokes(strokes);
+    size_t n = (size_t)CANVAS_W * CANVAS_H * 4;
+    std::vector<unsigned char> gl(n), soft(n), diff(n);
+    double glMs = Bake(strokes);
+    Renderer::ReadRegion(0, 0, CANVAS_W, CANVAS_H, gl.data());
+
+    // 同一份笔画，笔刷纹理换成软件后端的
+    Renderer::Init(BakeBackend::Software);
+    Renderer::WaitForAssets();
+    double softMs = Bake(strokes);
+    Renderer::ReadRegion(0, 0, CANVAS_W, CANVAS_H, soft.data());
+    int bad = SoftRenderer::Compare(gl.data(), false);
+
+    // 差异图：超出容差的像素标红，其余按 GL 结果淡淡地画出来。
+    // 每次混合的舍入误差会在叠得很深的地方累积（见 SoftRenderer.h），所以再统计一下差值的分布
+    const int BUCKETS[] = {2, 4, 8, 16, 32, 255};
+    int hist[6] = {}, worst = 0;
+    double sum = 0;
+    for (size_t i = 0; i < n; i += 4) {
+        int d = 0;
+        for (int k = 0; k < 4; k++) {
+            int e = abs(gl[i + k] - soft[i + k]);
+            d = std::max(d, e);
+            sum += e;
+        }
+        worst = std::max(worst, d);
+        hist[std::find_if(std::begin(BUCKETS), std::end(BUCKETS), [&](int b) { return d <= b; }) - std::begin(BUCKETS)]++;
+        bool over = d > SoftRenderer::TOLERANCE;
+        diff[i] = over ? 255 : (unsigned char)(255 - gl[i + 3] / 4);
+        diff[i + 1] = diff[i + 2] = over ? 0 : (unsigned char)(255 - gl[i + 3] / 4);
+        diff[i + 3] = 255;
+    }
+    stbi_write_png("backend_gl.png", CANVAS_W, CANVAS_H, 4, gl.data(), CANVAS_W * 4);
+    SoftRenderer::SavePNG("backend_soft.png");
+    stbi_write_png("backend_diff.png", CANVAS_W, CANVAS_H, 4, diff.data(), CANVAS_W * 4);
+
+    int total = CANVAS_W * CANVAS_H;
+    double mean = sum / n;
+    printf("%zu strokes, bake GL %.2f ms, software %.2f ms\n", strokes.size(), glMs, softMs);
+    printf("pixels differing by more than %d/255: %d of %d (%.3f%%), worst %d/255, mean %.3f/255 per channel\n",
+           SoftRenderer::TOLERANCE, bad, total, 100.0 * bad / total, worst, mean);
+    printf("max channel difference:");
+    for (int b = 0; b < 6; b++) printf("  <=%d: %d", BUCKETS[b], hist[b]);
+    printf("\nwrote backend_gl.png, backend_soft.png, backend_diff.png\n");
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui::DestroyContext();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return bad > total * SoftRenderer::MAX_OUTLIERS ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+// 橡皮擦每帧耗时 vs 总点数：对比网格索引和原来的逐点线性扫描
+// 用法: xmake run EraserBench
+#include "CanvasLogic.h"
+#include "StrokeIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// 原来的实现，作为对照
+static void LinearStrokeEraser(std::vector<Stroke>& strokes, ImVec2 relPos, float eraserSize) {
+    strokes.erase(std::remove_if(strokes.begin(), strokes.end(), [&](const Stroke& s) {
+                    for (const auto& p : s.points) {
+                        if (CanvasLogic::GetDistance(p, relPos) < eraserSize + s.thickness) return true;
+                    }
+                    return false;
+                }), strokes.end());
+}
+
+static void LinearPreciseEraser(std::vector<Stroke>& strokes, ImVec2 relPos, float eraserSize) {
+    std::vector<Stroke> next;
+    for (const auto& s : strokes) {
+        std::vector<ImVec2> seg;
+        for (const auto& p : s.points) {
+            if (CanvasLogic::GetDistance(p, relPos) <= eraserSize + s.thickness) {
+                if (seg.size() >= 2) next.push_back({seg, s.color, s.thickness, s.brush});
+                seg.clear();
+            } else {
+                seg.push_back(p);
+            }
+        }
+        if (seg.size() >= 2) next.push_back({seg, s.color, s.thickness, s.brush});
+    }
+    strokes = std::move(next);
+}
+
+static std::vector<Stroke> MakeStrokes(int totalPoints) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> ux(0, CANVAS_W), uy(0, CANVAS_H), ua(-0.6f, 0.6f);
+    std::vector<Stroke> strokes;
+    const int PER_STROKE = 50;
+    for (int n = 0; n < totalPoints; n += PER_STROKE) {
+        std::vector<ImVec2> pts;
+        ImVec2 p = {ux(rng), uy(rng)};
+        float dir = ua(rng) * 10.0f;
+        for (int i = 0; i < PER_STROKE; i++) {
+            pts.push_back(p);
+            dir += ua(rng);
+            p.x = std::clamp(p.x + 3.0f * cosf(dir), 0.0f, (float)CANVAS_W);
+            p.y = std::clamp(p.y + 3.0f * sinf(dir), 0.0f, (float)CANVAS_H);
+        }
+        strokes.emplace_back(pts, IM_COL32(0, 0, 0, 255), 5.0f, 0);
+    }
+    return strokes;
+}
+
+// 原来的实现跑在 std::vector<Stroke> 上，网格索引版跑在 StrokeStore 上
+template <class Store, class Fn>
+static double RunDrag(Store strokes, Fn fn) {
+    const int FRAMES = 120;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++) {
+        float t = (float)f / FRAMES;
+        fn(strokes, {t * CANVAS_W, t * CANVAS_H}, 10.0f);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count() / FRAMES;
+}
+
+static double RunIndexed(const StrokeStore& strokes, void (*fn)(StrokeStore&, ImVec2, float)) {
+    StrokeIndex::Rebuild(strokes);
+    return RunDrag(strokes, fn);
+}
+
+int main() {
+    printf("%10s %14s %14s %14s %14s\n", "points", "stroke/linear", "stroke/grid", "precise/linear", "precise/grid");
+    for (int points : {10000, 50000, 200000, 1000000}) {
+        std::vector<Stroke> strokes = MakeStrokes(points);
+        StrokeStore store;
+        for (const auto& s : strokes) store.Add(s);
+        double sl = RunDrag(strokes, LinearStrokeEraser);
+        double sg = RunIndexed(store, CanvasLogic::ProcessStrokeEraser);
+        double pl = RunDrag(strokes, LinearPreciseEraser);
+        double pg = RunIndexed(store, CanvasLogic::ProcessPreciseEraser);
+        printf("%10d %12.3fms %12.3fms %12.3fms %12.3fms\n", points, sl, sg, pl, pg);
+    }
+    return 0;
+}
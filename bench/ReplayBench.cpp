@@ -0,0 +1,288 @@
+// 无窗口回放输入录制，统计每个阶段（输入处理 / 印章缓存 / RenderStroke）的耗时、内存分配次数和印章数
+// 每个负载跑两遍：不简化（raw）和按 --tolerance 把笔画拟合成样条（fit），最后对比点数、内存和印章数
+// 用法: xmake run ReplayBench                 跑全部内置负载
+//       xmake run ReplayBench grass eraser    只跑指定的内置负载
+//       xmake run ReplayBench session.rec     回放应用里录下的文件
+//       xmake run ReplayBench --tolerance 2   简化误差（像素），默认和应用里一样
+#include "CanvasLogic.h"
+#include "StrokeIndex.h"
+#include "BrushRegistry.h"
+#include "InputRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+namespace fs = std::filesystem;
+
+// 统计所有线程的 operator new 次数
+static std::atomic<size_t> allocCount{0};
+void* operator new(size_t n) {
+    allocCount++;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct Workload {
+    std::string name;
+    std::vector<InputFrame> frames = {};
+    int renderEvery = 1; // 笔画很多时隔几帧渲染一次，否则整个负载跑得太久
+};
+
+// ---------------- 内置负载 ----------------
+static InputFrame Frame(Tool tool, int brush, float size, ImVec2 pos, bool down) {
+    return {pos, down, true, tool, brush, size, IM_COL32(30, 30, 30, 200)};
+}
+
+// 按下 -> 沿 path 拖动 -> 松开
+static void Drag(std::vector<InputFrame>& out, Tool tool, int brush, float size, const std::vector<ImVec2>& path) {
+    for (const auto& p : path) out.push_back(Frame(tool, brush, size, p, true));
+    out.push_back(Frame(tool, brush, size, path.back(), false));
+}
+
+static ImVec2 Clamp(ImVec2 p) {
+    return {std::clamp(p.x, 0.0f, (float)CANVAS_W - 1), std::clamp(p.y, 0.0f, (float)CANVAS_H - 1)};
+}
+
+// 草地笔刷来回密集涂抹
+static Workload GrassScribbles() {
+    Workload w{"grass"};
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> ux(100, CANVAS_W - 100), uy(100, CANVAS_H - 100), u(-1, 1);
+    int brush = std::max(0, BrushRegistry::Find("brush_grass"));
+    for (int s = 0; s < 60; s++) {
+        std::vector<ImVec2> path;
+        ImVec2 c = {ux(rng), uy(rng)};
+        for (int i = 0; i < 120; i++) {
+            float t = i * 0.35f;
+            path.push_back(Clamp({c.x + 80 * sinf(t) + 10 * u(rng), c.y + i * 0.8f - 48 + 10 * u(rng)}));
+        }
+        Drag(w.frames, Tool::Brush, brush, 20, path);
+    }
+    return w;
+}
+
+// 一万笔短线条的速写
+static Workload Sketch10k() {
+    Workload w{"sketch10k"};
+    w.renderEvery = 10;
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> ux(0, CANVAS_W), uy(0, CANVAS_H), ua(0, 6.2831853f);
+    int brush = std::max(0, BrushRegistry::Find("brush_pencil"));
+    for (int s = 0; s < 10000; s++) {
+        ImVec2 p = {ux(rng), uy(rng)};
+        float a = ua(rng);
+        std::vector<ImVec2> path;
+        for (int i = 0; i < 3; i++) path.push_back(Clamp({p.x + cosf(a) * 6 * i, p.y + sinf(a) * 6 * i}));
+        Drag(w.frames, Tool::Brush, brush, 3, path);
+    }
+    return w;
+}
+
+// 先画 2000 笔，再用精确橡皮擦和整笔橡皮擦各拖一长段
+static Workload EraserDrags() {
+    Workload w{"eraser"};
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> ux(0, CANVAS_W), uy(0, CANVAS_H), ua(-0.6f, 0.6f);
+    int brush = std::max(0, BrushRegistry::Find("brush_ink"));
+    for (int s = 0; s < 2000; s++) {
+        std::vector<ImVec2> path;
+        ImVec2 p = {ux(rng), uy(rng)};
+        float dir = ua(rng) * 10;
+        for (int i = 0; i < 12; i++) {
+            path.push_back(p);
+            dir += ua(rng);
+            p = Clamp({p.x + 8 * cosf(dir), p.y + 8 * sinf(dir)});
+        }
+        Drag(w.frames, Tool::Brush, brush, 5, path);
+    }
+    std::vector<ImVec2> zigzag;
+    for (int i = 0; i < 600; i++) {
+        float t = i / 600.0f;
+        zigzag.push_back(Clamp({t * CANVAS_W, CANVAS_H * (0.5f + 0.45f * sinf(t * 25))}));
+    }
+    Drag(w.frames, Tool::PreciseEraser, brush, 15, zigzag);
+    std::vector<ImVec2> diagonal;
+    for (int i = 0; i < 300; i++) diagonal.push_back(Clamp({i / 300.0f * CANVAS_W, (1 - i / 300.0f) * CANVAS_H}));
+    Drag(w.frames, Tool::StrokeEraser, brush, 15, diagonal);
+    return w;
+}
+
+// 拖出大椭圆：每帧都要重算 360 个点
+static Workload LargeEllipses() {
+    Workload w{"ellipses"};
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> ux(0, CANVAS_W * 0.3f), uy(0, CANVAS_H * 0.3f);
+    for (int s = 0; s < 200; s++) {
+        ImVec2 a = {ux(rng), uy(rng)};
+        ImVec2 b = {CANVAS_W - ux(rng), CANVAS_H - uy(rng)};
+        std::vector<ImVec2> path;
+        for (int i = 0; i <= 30; i++) {
+            float t = i / 30.0f;
+            path.push_back({a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t});
+        }
+        Drag(w.frames, Tool::Circle, 0, 10, path);
+    }
+    return w;
+}
+
+static const std::vector<std::pair<std::string, std::function<Workload()>>> CANNED = {
+    {"grass", GrassScribbles},
+    {"sketch10k", Sketch10k},
+    {"eraser", EraserDrags},
+    {"ellipses", LargeEllipses},
+};
+
+// ---------------- 回放 ----------------
+struct Stage {
+    double ms = 0;
+    size_t allocs = 0;
+};
+
+template <typename Fn>
+static void Timed(Stage& st, Fn fn) {
+    size_t a0 = allocCount;
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    st.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    st.allocs += allocCount - a0;
+}
+
+struct Totals {
+    size_t points = 0, stamps = 0;
+};
+
+// 和 AppUI::Canvas 同样的顺序：输入 -> 更新缓存 -> RenderStroke
+static Totals Run(const Workload& w, const char* variant) {
+    ImGuiIO& io = ImGui::GetIO();
+    StrokeStore strokes;
+    StrokeIndex::Clear();
+    bool isDrawing = false;
+    ImVec2 startPos = {0, 0};
+    ImDrawList dl(ImGui::GetDrawListSharedData());
+
+    Stage input, cache, render;
+    double maxFrame = 0;
+    size_t stamps = 0, vertices = 0;
+    for (size_t f = 0; f < w.frames.size(); f++) {
+        const InputFrame& in = w.frames[f];
+        io.AddMousePosEvent(in.pos.x, in.pos.y);
+        io.AddMouseButtonEvent(0, in.down);
+        ImGui::NewFrame();
+        auto t0 = std::chrono::steady_clock::now();
+
+        Timed(input, [&] {
+            if (in.hovered) CanvasLogic::Process(in.tool, strokes, in.pos, startPos, in.color, in.size, isDrawing, in.brush);
+            if (ImGui::IsMouseReleased(0)) isDrawing = false;
+        });
+        bool draw = (f + 1) % w.renderEvery == 0 || f + 1 == w.frames.size();
+        if (draw) {
+            Timed(cache, [&] { UpdateStrokeCaches(strokes); });
+            Timed(render, [&] {
+                dl._ResetForNewFrame();
+                dl.PushClipRect({0, 0}, {(float)CANVAS_W, (float)CANVAS_H});
+                for (size_t i = 0; i < strokes.size(); i++) RenderStroke(&dl, strokes, i, {0, 0});
+                dl.PopClipRect();
+            });
+            vertices += dl.VtxBuffer.Size;
+        }
+
+        maxFrame = std::max(maxFrame, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        ImGui::EndFrame();
+    }
+    Totals t;
+    for (size_t i = 0; i < strokes.size(); i++) {
+        stamps += strokes.Cache(i).stamps.size();
+        t.points += strokes.Count(i);
+    }
+    t.stamps = stamps;
+
+    double total = input.ms + cache.ms + render.ms;
+    std::string label = w.name + "/" + variant;
+    printf("%-16s %7zu %7zu %9zu | %9.1f %9.1f %9.1f | %8zu %8zu %8zu | %7.3f %7.2f | %10zu\n",
+           label.c_str(), w.frames.size(), strokes.size(), stamps,
+           input.ms, cache.ms, render.ms, input.allocs, cache.allocs, render.allocs,
+           total / w.frames.size(), maxFrame, vertices / 4);
+    return t;
+}
+
+// 和 Renderer::ScanAssets 一样按文件名排序注册笔刷，只是不加载纹理
+static void RegisterBrushes() {
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator("assets", ec))
+        if (e.path().extension() == ".png" || e.path().extension() == ".jpg") files.push_back(e.path());
+    std::sort(files.begin(), files.end());
+    for (const auto& f : files) BrushRegistry::Register(f.stem().string(), 0, fs::path(f).replace_extension(".brush").string());
+}
+
+int main(int argc, char** argv) {
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = {(float)CANVAS_W, (float)CANVAS_H};
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    io.ConfigInputTrickleEventQueue = false; // 每帧的输入当帧生效，和录制时一致
+    unsigned char* fontPixels;
+    int fontW, fontH;
+    io.Fonts->GetTexDataAsRGBA32(&fontPixels, &fontW, &fontH);
+    RegisterBrushes();
+
+    float tolerance = CanvasLogic::fitTolerance;
+    std::vector<Workload> todo;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = (float)atof(argv[++i]);
+            continue;
+        }
+        auto it = std::find_if(CANNED.begin(), CANNED.end(), [&](const auto& c) { return c.first == arg; });
+        if (it != CANNED.end()) {
+            todo.push_back(it->second());
+            continue;
+        }
+        Workload w{fs::path(arg).filename().string()};
+        if (!InputRecorder::Load(arg, w.frames)) {
+            fprintf(stderr, "Cannot load recording %s\n", arg.c_str());
+            return 1;
+        }
+        todo.push_back(std::move(w));
+    }
+    if (todo.empty())
+        for (const auto& c : CANNED) todo.push_back(c.second());
+
+    printf("%-16s %7s %7s %9s | %9s %9s %9s | %8s %8s %8s | %7s %7s | %10s\n",
+           "workload", "frames", "strokes", "stamps", "input ms", "cache ms", "render ms",
+           "in alloc", "cache al", "rend al", "avg ms", "max ms", "quads out");
+    std::vector<std::pair<Totals, Totals>> results;
+    for (const auto& w : todo) {
+        CanvasLogic::fitTolerance = 0.0f;
+        Totals raw = Run(w, "raw");
+        CanvasLogic::fitTolerance = tolerance;
+        Totals fit = Run(w, "fit");
+        results.push_back({raw, fit});
+    }
+
+    // 点的内存按 ImVec2 算，印章缓存按每个印章 4 个 ImDrawVert 算
+    printf("\nsimplification, tolerance %.2f px\n", tolerance);
+    printf("%-12s %10s %10s %7s | %10s %10s %7s | %9s %9s\n", "workload", "raw pts", "fit pts", "ratio",
+           "raw stamps", "fit stamps", "ratio", "raw KB", "fit KB");
+    for (size_t i = 0; i < todo.size(); i++) {
+        const Totals& r = results[i].first;
+        const Totals& f = results[i].second;
+        auto kb = [](const Totals& t) { return (t.points * sizeof(ImVec2) + t.stamps * 4 * sizeof(ImDrawVert)) / 1024.0; };
+        printf("%-12s %10zu %10zu %6.1f%% | %10zu %10zu %6.1f%% | %9.0f %9.0f\n", todo[i].name.c_str(),
+               r.points, f.points, r.points ? 100.0 * f.points / r.points : 0.0,
+               r.stamps, f.stamps, r.stamps ? 100.0 * f.stamps / r.stamps : 0.0, kb(r), kb(f));
+    }
+
+    ImGui::DestroyContext();
+    return 0;
+}
\ No newline at end of file
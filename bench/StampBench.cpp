@@ -0,0 +1,202 @@
+// 顶点拉取印章 vs CPU 顶点：同一批笔画在同一个 GL 上下文里用两条路径各画若干帧，
+// 比较每帧上传到 GPU 的字节数、CPU 时间、帧时间（glFinish 之后）和画出来的像素；
+// 最后用一批细笔画比较笔刷 mipmap 开关前后的烘焙时间和帧时间
+// 没有显卡的机器用 Mesa 的软件光栅（llvmpipe）：LIBGL_ALWAYS_SOFTWARE=1 xmake run StampBench
+// 用法: xmake run StampBench [帧数]
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <imgui_impl_opengl3.h>
+#include "Renderer.h"
+#include "SoftRenderer.h"
+#include "BrushRegistry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+// 和 ReplayBench 的 grass 负载一样：草地笔刷来回密集涂抹，最后一笔当作正在画的笔画
+static void BuildGrass(StrokeStore& strokes) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> ux(100, CANVAS_W - 100), uy(100, CANVAS_H - 100), u(-1, 1);
+    int brush = std::max(0, BrushRegistry::Find("brush_grass"));
+    for (int s = 0; s < 60; s++) {
+        std::vector<ImVec2> path;
+        ImVec2 c = {ux(rng), uy(rng)};
+        for (int i = 0; i < 120; i++) {
+            float t = i * 0.35f;
+            path.push_back({c.x + 80 * sinf(t) + 10 * u(rng), c.y + i * 0.8f - 48 + 10 * u(rng)});
+        }
+        strokes.Add(path.data(), (int)path.size(), IM_COL32(40, 120, 30, 200), 20, brush);
+    }
+}
+
+// 细笔画：粗细 1~3 的墨水笔刷，256px 的笔刷图缩到几个像素宽
+static void BuildSmall(StrokeStore& strokes) {
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> ux(50, CANVAS_W - 50), uy(50, CANVAS_H - 50), u(-1, 1);
+    int brush = std::max(0, BrushRegistry::Find("brush_ink"));
+    for (int s = 0; s < 400; s++) {
+        std::vector<ImVec2> path;
+        ImVec2 p = {ux(rng), uy(rng)};
+        for (int i = 0; i < 60; i++) {
+            path.push_back(p);
+            p = {std::clamp(p.x + 6 * u(rng), 0.0f, (float)CANVAS_W), std::clamp(p.y + 6 * u(rng), 0.0f, (float)CANVAS_H)};
+        }
+        strokes.Add(path.data(), (int)path.size(), IM_COL32(20, 20, 60, 220), 1.0f + (s % 3), brush);
+    }
+}
+
+// zoomed：缩小到 1/8（大画布全局视图），印章都还在画但几乎没有填充量，剩下的主要是顶点和上传的开销
+enum class Scene { Still, Pan, Drawing, Zoomed };
+static const char* SCENE_NAMES[] = {"still", "pan", "drawing", "zoomed"};
+
+struct Result {
+    double cpuMs = 0, frameMs = 0;
+    size_t uploadBytes = 0;
+};
+
+static Result Run(GLFWwindow* window, StrokeStore& strokes, bool pulled, Scene scene, int frames) {
+    Renderer::vertexPulling = pulled;
+    ImGuiIO& io = ImGui::GetIO();
+    Result r;
+    for (int f = 0; f < frames; f++) {
+        auto t0 = std::chrono::steady_clock::now();
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui::NewFrame();
+        ImVec2 origin = {0, 0};
+        float zoom = scene == Scene::Zoomed ? 0.125f : 1.0f;
+        if (scene == Scene::Pan) origin = {20 * sinf(f * 0.1f), 20 * cosf(f * 0.1f)};
+        if (scene == Scene::Drawing) {
+            size_t last = strokes.size() - 1;
+            ImVec2 p = strokes.Points(last)[strokes.Count(last) - 1];
+            strokes.AppendPoint(last, {p.x + 2 * cosf(f * 0.2f), p.y + 2 * sinf(f * 0.2f)});
+        }
+        ImDrawList* dl = ImGui::GetBackgroundDrawList();
+        dl->AddRectFilled({0, 0}, io.DisplaySize, IM_COL32_WHITE);
+        UpdateStrokeCaches(strokes, !pulled);
+        for (size_t i = 0; i < strokes.size(); i++) Renderer::DrawStroke(dl, strokes, i, origin, zoom);
+        ImGui::Render();
+        ImDrawData* data = ImGui::GetDrawData();
+        glViewport(0, 0, CANVAS_W, CANVAS_H);
+        glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        Renderer::RenderDrawData(data);
+        auto t1 = std::chrono::steady_clock::now();
+        glFinish();
+        auto t2 = std::chrono::steady_clock::now();
+        Renderer::EndFrame();
+        // 第一帧要把所有印章传上去，不算在平均里
+        if (f == 0) continue;
+        r.cpuMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        r.frameMs += std::chrono::duration<double, std::milli>(t2 - t0).count();
+        r.uploadBytes += (size_t)data->TotalVtxCount * sizeof(ImDrawVert) + (size_t)data->TotalIdxCount * sizeof(ImDrawIdx) +
+                         Renderer::stampUploadBytes;
+        glfwSwapBuffers(window);
+    }
+    int n = std::max(1, frames - 1);
+    r.cpuMs /= n;
+    r.frameMs /= n;
+    r.uploadBytes /= n;
+    return r;
+}
+
+// 当前后缓冲（还没 swap 的那一帧）读成 RGBA，自下而上
+static std::vector<unsigned char> Capture(StrokeStore& strokes, GLFWwindow* window, bool pulled) {
+    Run(window, strokes, pulled, Scene::Still, 1);
+    std::vector<unsigned char> px((size_t)CANVAS_W * CANVAS_H * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, CANVAS_W, CANVAS_H, GL_RGBA, GL_UNSIGNED_BYTE, px.data());
+    return px;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::max(2, atoi(argv[1])) : 30;
+    glfwInit();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow* window = glfwCreateWindow(CANVAS_W, CANVAS_H, "StampBench", NULL, NULL);
+    if (!window) {
+        fprintf(stderr, "Cannot create a GL 3.3 context\n");
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    printf("GL_RENDERER: %s\n", (const char*)glGetString(GL_RENDERER));
+
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = {(float)CANVAS_W, (float)CANVAS_H};
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    ImGui_ImplOpenGL3_Init("#version 330");
+    Renderer::Init();
+    Renderer::WaitForAssets();
+    if (!Renderer::stampsAvailable) {
+        fprintf(stderr, "Vertex-pulled stamps unavailable on this context\n");
+        return 1;
+    }
+
+    StrokeStore strokes;
+    BuildGrass(strokes);
+    UpdateStrokeCaches(strokes);
+    size_t stamps = 0;
+    for (size_t i = 0; i < strokes.size(); i++) stamps += strokes.Cache(i).stamps.size();
+    printf("%zu strokes, %zu stamps, %d frames per run\n\n", strokes.size(), stamps, frames);
+
+    // 两条路径画同一帧，逐像素比较
+    std::vector<unsigned char> cpu = Capture(strokes, window, false), gpu = Capture(strokes, window, true);
+    int bad = 0;
+    for (size_t i = 0; i < cpu.size(); i += 4) {
+        for (int k = 0; k < 4; k++) {
+            if (abs(cpu[i + k] - gpu[i + k]) > SoftRenderer::TOLERANCE) { bad++; break; }
+        }
+    }
+    printf("pixels differing by more than %d/255: %d of %d\n\n", SoftRenderer::TOLERANCE, bad, CANVAS_W * CANVAS_H);
+
+    printf("%-8s %-10s %10s %10s %12s\n", "scene", "path", "cpu ms", "frame ms", "upload KB");
+    for (Scene scene : {Scene::Still, Scene::Pan, Scene::Drawing, Scene::Zoomed}) {
+        for (bool pulled : {false, true}) {
+            StrokeStore copy;
+            BuildGrass(copy);
+            Result r = Run(window, copy, pulled, scene, frames);
+            printf("%-8s %-10s %10.2f %10.2f %12.1f\n", SCENE_NAMES[(int)scene], pulled ? "pulled" : "vertices",
+                   r.cpuMs, r.frameMs, r.uploadBytes / 1024.0);
+        }
+    }
+
+    // 细笔画：每种设置烘焙几遍取平均（glFinish 之后计时），再按 still 场景画若干帧
+    printf("\n%-10s %-10s %10s %10s\n", "small", "path", "bake ms", "frame ms");
+    for (bool mips : {false, true}) {
+        Renderer::SetBrushMipmaps(mips);
+        for (bool pulled : {false, true}) {
+            StrokeStore small;
+            BuildSmall(small);
+            Renderer::vertexPulling = pulled;
+            UpdateStrokeCaches(small, !pulled);
+            const int BAKES = 5;
+            double bakeMs = 0;
+            for (int k = 0; k < BAKES; k++) {
+                Renderer::ClearTexture();
+                glFinish();
+                auto t0 = std::chrono::steady_clock::now();
+                Renderer::BakeStrokes(small, 0, small.size());
+                glFinish();
+                bakeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            }
+            Result r = Run(window, small, pulled, Scene::Still, frames);
+            printf("%-10s %-10s %10.2f %10.2f\n", mips ? "mipmaps" : "no mips", pulled ? "pulled" : "vertices",
+                   bakeMs / BAKES, r.frameMs);
+        }
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui::DestroyContext();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+// 印章生成：批量路径（有 SSE2 时是 SinCos4）生成的旋转和标量 StampSinCos 逐位对比，
+// 顺便给出多项式相对 libm cosf/sinf 的最大误差和每个印章的生成耗时
+// 用法: xmake run StampGenBench    （有不一致的印章时返回 1）
+#include "StrokeStore.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+// 默认笔刷：随机旋转、没有大小抖动，所以 (a, b) = 粗细 × (cos, sin)(角度)
+static StrokeStore MakeStrokes(size_t strokes) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> ux(0, CANVAS_W), uy(0, CANVAS_H), ua(-3.14f, 3.14f), ut(1.0f, 40.0f);
+    std::uniform_int_distribution<int> un(8, 64);
+    StrokeStore store;
+    std::vector<ImVec2> pts;
+    for (size_t i = 0; i < strokes; i++) {
+        ImVec2 p = {ux(rng), uy(rng)};
+        float dir = ua(rng);
+        pts.clear();
+        for (int k = 0, n = un(rng); k < n; k++) {
+            pts.push_back(p);
+            dir += 0.05f;
+            p = {p.x + 3.0f * cosf(dir), p.y + 3.0f * sinf(dir)};
+        }
+        store.Add(pts.data(), (int)pts.size(), IM_COL32(0, 0, 0, 255), ut(rng), -1);
+    }
+    return store;
+}
+
+static bool SameBits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+int main() {
+    StrokeStore store = MakeStrokes(20000);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < store.size(); i++) BuildStrokeCache(store, i);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    size_t total = 0, mismatched = 0;
+    float maxLibmErr = 0.0f;
+    for (size_t i = 0; i < store.size(); i++) {
+        StrokeView s = store.View(i);
+        const std::vector<StampInstance>& stamps = store.Cache(i).stamps;
+        for (size_t k = 0; k < stamps.size(); k++) {
+            float angle = StampRandom(s.seed, s.stampBase + (uint32_t)k, 3) * 6.2831853f;
+            float sn, cs;
+            StampSinCos(angle, sn, cs);
+            if (!SameBits(stamps[k].a, s.thickness * cs) || !SameBits(stamps[k].b, s.thickness * sn)) {
+                if (mismatched++ < 5)
+                    fprintf(stderr, "stroke %zu stamp %zu: (%.9g, %.9g) vs scalar (%.9g, %.9g)\n", i, k, stamps[k].a,
+                            stamps[k].b, s.thickness * cs, s.thickness * sn);
+            }
+            maxLibmErr = std::max({maxLibmErr, fabsf(cs - cosf(angle)), fabsf(sn - sinf(angle))});
+            total++;
+        }
+    }
+    printf("%zu stamps in %.1f ms (%.1f ns/stamp), %zu differ from scalar StampSinCos\n", total, ms,
+           ms * 1e6 / std::max<size_t>(total, 1), mismatched);
+    printf("max |polynomial - libm| over [0, 2pi): %.3g\n", maxLibmErr);
+    return mismatched ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+// 笔画存储对比：每笔一个 std::vector 的 std::vector<Stroke>（原来的布局） vs StrokeStore（点 arena + 属性列）
+// 测建立、遍历全部点、扫 id 列、批量删除的耗时，以及内存分配次数和占用
+// 用法: xmake run StrokeStoreBench
+#include "StrokeStore.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+static std::atomic<size_t> allocCount{0};
+void* operator new(size_t n) {
+    allocCount++;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const size_t MALLOC_HEADER = 16; // 每次分配的堆管理开销，粗略按 16 字节算
+
+template <class Fn>
+static double Ms(Fn fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// 随机游走的笔画，点数 8..64；和画的时候一样一个点一个点追加
+struct Shape {
+    ImVec2 start;
+    float dir;
+    int n;
+};
+
+static std::vector<Shape> MakeShapes(size_t strokes) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> ux(0, CANVAS_W), uy(0, CANVAS_H), ua(-3.14f, 3.14f);
+    std::uniform_int_distribution<int> un(8, 64);
+    std::vector<Shape> shapes(strokes);
+    for (auto& s : shapes) s = {{ux(rng), uy(rng)}, ua(rng), un(rng)};
+    return shapes;
+}
+
+static ImVec2 Walk(const Shape& s, int k) {
+    float a = s.dir + 0.05f * k;
+    return {s.start.x + 3.0f * k * cosf(a), s.start.y + 3.0f * k * sinf(a)};
+}
+
+struct Result {
+    double build, iterate, scan, erase;
+    size_t allocs, bytes, liveBytes; // bytes 按 capacity 算，liveBytes 只算实际用到的
+};
+
+// 每个阶段各跑 REPEAT 遍取平均
+static const int REPEAT = 5;
+
+static Result RunVector(const std::vector<Shape>& shapes) {
+    Result r{};
+    std::vector<Stroke> strokes;
+    size_t a0 = allocCount;
+    r.build = Ms([&] {
+        for (const auto& sh : shapes) {
+            strokes.push_back(Stroke({Walk(sh, 0)}, IM_COL32(0, 0, 0, 255), 4.0f, 0));
+            for (int k = 1; k < sh.n; k++) strokes.back().points.push_back(Walk(sh, k));
+        }
+    });
+    r.allocs = allocCount - a0;
+    r.bytes = strokes.capacity() * sizeof(Stroke) + strokes.size() * MALLOC_HEADER;
+    r.liveBytes = strokes.size() * (sizeof(Stroke) + MALLOC_HEADER);
+    for (const auto& s : strokes) {
+        r.bytes += s.points.capacity() * sizeof(ImVec2);
+        r.liveBytes += s.points.size() * sizeof(ImVec2);
+    }
+
+    // 和缓存重建 / 橡皮擦一样逐笔逐点走一遍，算包围盒
+    float sink = 0;
+    r.iterate = Ms([&] {
+        for (int rep = 0; rep < REPEAT; rep++) {
+            for (const auto& s : strokes) {
+                ImVec2 lo = {FLT_MAX, FLT_MAX}, hi = {-FLT_MAX, -FLT_MAX};
+                for (const auto& p : s.points) {
+                    lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y);
+                    hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y);
+                }
+                sink += hi.x - lo.x + hi.y - lo.y;
+            }
+        }
+    }) / REPEAT;
+    // 橡皮擦按 id 找下标
+    int hits = 0;
+    r.scan = Ms([&] {
+        for (int rep = 0; rep < REPEAT; rep++)
+            for (const auto& s : strokes) hits += (s.id & 1023) == rep;
+    }) / REPEAT;
+    // 每次删掉 1% 的笔画，删 REPEAT 次
+    r.erase = Ms([&] {
+        for (int rep = 0; rep < REPEAT; rep++)
+            strokes.erase(std::remove_if(strokes.begin(), strokes.end(), [&](const Stroke& s) { return s.id % 100 == rep; }), strokes.end());
+    }) / REPEAT;
+    if (sink == 1.0f && hits == -1) printf(" ");
+    return r;
+}
+
+static Result RunStore(const std::vector<Shape>& shapes) {
+    Result r{};
+    StrokeStore strokes;
+    size_t a0 = allocCount;
+    r.build = Ms([&] {
+        for (const auto& sh : shapes) {
+            ImVec2 p0 = Walk(sh, 0);
+            size_t i = strokes.Add(&p0, 1, IM_COL32(0, 0, 0, 255), 4.0f, 0);
+            for (int k = 1; k < sh.n; k++) strokes.AppendPoint(i, Walk(sh, k));
+        }
+    });
+    r.allocs = allocCount - a0;
+    r.bytes = strokes.MemoryBytes() + 16 * MALLOC_HEADER; // 15 列加 arena
+    r.liveBytes = r.bytes - (strokes.arena.capacity() - strokes.arena.size()) * sizeof(ImVec2);
+
+    float sink = 0;
+    r.iterate = Ms([&] {
+        for (int rep = 0; rep < REPEAT; rep++) {
+            for (size_t i = 0; i < strokes.size(); i++) {
+                ImVec2 lo = {FLT_MAX, FLT_MAX}, hi = {-FLT_MAX, -FLT_MAX};
+                const ImVec2* pts = strokes.Points(i);
+                for (int k = 0; k < strokes.Count(i); k++) {
+                    lo.x = std::min(lo.x, pts[k].x); lo.y = std::min(lo.y, pts[k].y);
+                    hi.x = std::max(hi.x, pts[k].x); hi.y = std::max(hi.y, pts[k].y);
+                }
+                sink += hi.x - lo.x + hi.y - lo.y;
+            }
+        }
+    }) / REPEAT;
+    int hits = 0;
+    r.scan = Ms([&] {
+        for (int rep = 0; rep < REPEAT; rep++)
+            for (int id : strokes.id) hits += (id & 1023) == rep;
+    }) / REPEAT;
+    std::vector<uint32_t> doomed;
+    r.erase = Ms([&] {
+        for (int rep = 0; rep < REPEAT; rep++) {
+            doomed.clear();
+            for (size_t i = 0; i < strokes.size(); i++)
+                if (strokes.id[i] % 100 == rep) doomed.push_back((uint32_t)i);
+            strokes.Remove(doomed);
+        }
+    }) / REPEAT;
+    if (sink == 1.0f && hits == -1) printf(" ");
+    return r;
+}
+
+int main() {
+    printf("%8s %-7s | %9s %10s %9s %9s | %9s %9s %9s\n", "strokes", "layout", "build ms", "allocs", "MB",
+           "live MB", "iter ms", "scan ms", "erase ms");
+    for (size_t n : {100000, 250000, 500000}) {
+        std::vector<Shape> shapes = MakeShapes(n);
+        Result v = RunVector(shapes);
+        Result s = RunStore(shapes);
+        for (auto [name, r] : {std::pair<const char*, Result>{"vector", v}, {"store", s}})
+            printf("%8zu %-7s | %9.1f %10zu %9.1f %9.1f | %9.2f %9.3f %9.2f\n", n, name, r.build, r.allocs,
+                   r.bytes / (1024.0 * 1024.0), r.liveBytes / (1024.0 * 1024.0), r.iterate, r.scan, r.erase);
+    }
+    return 0;
+}
\ No newline at end of file
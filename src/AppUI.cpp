@@ -1,128 +1,156 @@
 #include "AppUI.h"
 #include "Renderer.h"
 #include "CanvasLogic.h"
+#include "StrokeIndex.h"
+#include "BrushRegistry.h"
+#include "History.h"
+#include "Document.h"
+#include "InputRecorder.h"
+#include "Profiler.h"
+#include "TileCanvas.h"
+#include "Layers.h"
+#include "Compositor.h"
+#include "Exporter.h"
+#include "FloodFill.h"
+#include "InputQueue.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <chrono>
 
 Tool AppUI::currentTool = Tool::Brush;
 BrushType AppUI::brushType = BrushType::Solid;
-std::string brushName;
+int brushId = 0;
 float AppUI::brushSize = 5.0f;
 ImVec4 AppUI::brushColor = {1,0,0,1};
-std::vector<Stroke> AppUI::strokes;
 bool AppUI::isDrawing = false;
 ImVec2 AppUI::rectStartPos = {0,0};
+ImVec2 AppUI::pan = {0, 0};
+float AppUI::zoom = 1.0f;
+int AppUI::newCanvasSize[2] = {16384, 16384};
+bool AppUI::autoBake = true;
+int AppUI::budgetMode = 0;
+int AppUI::maxLiveStamps = 200000;
+float AppUI::frameBudgetMs = 6.0f;
+int AppUI::keepRecent = 20;
+int AppUI::liveStamps = 0;
+float AppUI::vectorPassMs = 0.0f;
+char AppUI::docPath[256] = "drawing.pdoc";
+char AppUI::exportPath[256] = "export.png";
+float AppUI::exportScale = 4.0f;
+bool AppUI::showDrawStats = false;
+int AppUI::canvasDrawCmds = 0;
+int AppUI::brushSwitchCmds = 0;
+int AppUI::frameDrawCmds = 0;
+size_t AppUI::frameVertexBytes = 0;
 
-void RenderStroke(ImDrawList* dl, const Stroke& s, ImVec2 canvasP0) {
-    if (s.points.size() < 2) return;
-    srand(s.id);
-
-    GLuint texID = 0;
-    if (Renderer::brushTextures.count(s.brushName)) 
-        texID = Renderer::brushTextures[s.brushName];
-
-    // 特殊配置参数
-    float spacing = 0.1f;
-    float jitterPos = 0.0f;
-    float jitterSize = 0.0f;
-    bool randomRotation = true;
-
-    // 根据笔刷名字设置特殊表现
-    if (s.brushName.find("star") != std::string::npos) {
-        spacing = 0.8f;      // 星星要稀疏一点，才像撒出来的
-        jitterPos = 2.0f;    // 坐标乱跳
-        jitterSize = 0.5f;   // 大小不一
-    } else if (s.brushName.find("smoke") != std::string::npos) {
-        spacing = 0.2f;
-        jitterSize = 1.2f;   // 烟雾忽大忽小
-    } else if (s.brushName.find("grass") != std::string::npos) {
-        spacing = 0.05f;
-        randomRotation = false; // 草丛通常随鼠标方向，而不是乱转
-    } else if (s.brushName.find("glitch") != std::string::npos) {
-        spacing = 0.3f;
-        jitterPos = 1.5f;
-    }
-
-    for (size_t i = 0; i < s.points.size() - 1; i++) {
-        ImVec2 p1 = s.points[i];
-        ImVec2 p2 = s.points[i+1];
-        float dist = CanvasLogic::GetDistance(p1, p2);
-        float step = fmax(1.0f, s.thickness * spacing);
-
-        for (float d = 0; d < dist; d += step) {
-            float t = d / dist;
-            ImVec2 basePos = { p1.x + (p2.x-p1.x)*t + canvasP0.x, p1.y + (p2.y-p1.y)*t + canvasP0.y };
-
-            // 1. 坐标抖动
-            float px = basePos.x + (rand()%100 - 50)/50.0f * s.thickness * jitterPos;
-            float py = basePos.y + (rand()%100 - 50)/50.0f * s.thickness * jitterPos;
-
-            // 2. 随机大小
-            float currentSize = s.thickness * (1.0f + (rand()%100 - 50)/50.0f * jitterSize);
-
-            // 3. 旋转逻辑
-            float angle = 0;
-            if (randomRotation) {
-                angle = (rand() % 360) * (3.1415f / 180.0f);
-            } else {
-                // 如果不随机旋转，就跟随鼠标移动方向
-                angle = atan2f(p2.y - p1.y, p2.x - p1.x);
-            }
+// 每帧最多烘焙这么多印章，避免一次烘太多造成卡顿
+static const int BAKE_STAMPS_PER_FRAME = 30000;
+static const float MIN_ZOOM = 1.0f / 64, MAX_ZOOM = 32.0f;
 
-            // 4. 准备绘制顶点
-            float cosA = cosf(angle); float sinA = sinf(angle);
-            ImVec2 corners[4] = {{-currentSize,-currentSize}, {currentSize,-currentSize}, {currentSize,currentSize}, {-currentSize,currentSize}};
-            ImVec2 q[4];
-            for (int n=0; n<4; n++) {
-                q[n].x = px + (corners[n].x * cosA - corners[n].y * sinA);
-                q[n].y = py + (corners[n].x * sinA + corners[n].y * cosA);
-            }
+void AppUI::Render(bool& shouldBake) {
+    PROFILE_SCOPE("AppUI::Render");
+    Document::Pump();
+    FloodFill::Pump(); // 填好的结果在合成之前写回，这一帧就能看到
+    Sidebar();
+    // 用上一帧的统计决定要不要退休旧笔画；放在 Canvas 之前，避免同一帧里既烘焙又矢量绘制
+    AutoBake();
+    Canvas();
+    Exporter::Pump();
+    if (shouldBake && !Exporter::Busy()) {
+        History::Bake(Layers::Active(), 0, Layers::Active().strokes.size());
+        shouldBake = false;
+    }
 
-            dl->AddImageQuad((ImTextureID)(intptr_t)texID, q[0], q[1], q[2], q[3], 
-                             {0,0}, {1,0}, {1,1}, {0,1}, s.color);
+    // Ctrl+Z 撤销，Ctrl+Y / Ctrl+Shift+Z 重做；画到一半时不响应，导出期间底图要保持不变也不响应
+    ImGuiIO& io = ImGui::GetIO();
+    if (!Exporter::Busy()) {
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Z, false)) {
+            if (io.KeyShift) History::Redo();
+            else History::Undo();
         }
+        if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Y, false)) History::Redo();
     }
+    if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_S, false)) Document::Save(docPath);
+
+    // 底图瓦片和合成缓存超出预算时丢掉最久没看到的
+    TileCanvas::EndFrame();
+    Compositor::EndFrame();
 }
 
-void AppUI::Render(bool& shouldBake) {
-    Sidebar();
-    Canvas();
-    if (shouldBake) {
-        Renderer::PerformBake(strokes);
-        shouldBake = false;
+void AppUI::RecordFrameStats(const ImDrawData* data) {
+    frameDrawCmds = 0;
+    for (int i = 0; i < data->CmdListsCount; i++) frameDrawCmds += data->CmdLists[i]->CmdBuffer.Size;
+    // ImGui 后端每帧把所有顶点和索引重新上传一遍
+    frameVertexBytes = (size_t)data->TotalVtxCount * sizeof(ImDrawVert) + (size_t)data->TotalIdxCount * sizeof(ImDrawIdx);
+}
+
+// 只退休当前层的笔画
+void AppUI::AutoBake() {
+    PROFILE_SCOPE("AppUI::AutoBake");
+    StrokeStore& strokes = Layers::Active().strokes;
+    // 导出期间底图要保持不变；撤销之后（还能重做时）也不烘焙，否则重做记录对不上、又会被清掉
+    if (!autoBake || (int)strokes.size() <= keepRecent || Exporter::Busy() || History::CanRedo()) return;
+    bool over = (budgetMode == 0) ? liveStamps > maxLiveStamps : vectorPassMs > frameBudgetMs;
+    if (!over) return;
+
+    // 从最老的笔画开始退休；stamp 模式下退到预算以内为止，两种模式每帧都有上限
+    size_t limit = strokes.size() - keepRecent;
+    size_t n = 0;
+    int baked = 0;
+    int remaining = liveStamps;
+    while (n < limit && baked < BAKE_STAMPS_PER_FRAME) {
+        if (budgetMode == 0 && remaining <= maxLiveStamps) break;
+        // 这一帧还没建缓存的笔画（比如刚接进来的、图层隐藏着的）要先建出来，不然印章数算成 0，一下退休太多
+        if (strokes.Count(n) >= 2) EnsureStrokeCache(strokes, n);
+        int stamps = (int)strokes.Cache(n).stamps.size();
+        baked += stamps;
+        remaining -= stamps;
+        n++;
     }
+    if (n == 0) return;
+
+    History::Bake(Layers::Active(), 0, n, true);
+    liveStamps = remaining;
 }
 
 void AppUI::Sidebar() {
+    PROFILE_SCOPE("AppUI::Sidebar");
     ImGui::SetNextWindowPos({0,0});
     ImGui::SetNextWindowSize({250, 720});
     ImGui::Begin("Tools", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize);
+    StrokeStore& strokes = Layers::Active().strokes;
     
     if (ImGui::RadioButton("Brush", currentTool == Tool::Brush)) currentTool = Tool::Brush;
     if (ImGui::RadioButton("Rectangle", currentTool == Tool::Rectangle)) currentTool = Tool::Rectangle;
     if (ImGui::RadioButton("Circle", currentTool == Tool::Circle)) currentTool = Tool::Circle;
     if (ImGui::RadioButton("StrokeEraser", currentTool == Tool::StrokeEraser)) currentTool = Tool::StrokeEraser;
     if (ImGui::RadioButton("PreciseEraser", currentTool == Tool::PreciseEraser)) currentTool = Tool::PreciseEraser;
+    if (ImGui::RadioButton("Eyedropper", currentTool == Tool::Eyedropper)) currentTool = Tool::Eyedropper;
+    if (ImGui::RadioButton("Fill", currentTool == Tool::Fill)) currentTool = Tool::Fill;
     if (ImGui::Button("test")) {
-        for (int i = 0; i < Renderer::brushNames.size(); i++) {
+        History::BeginEdit(Layers::Active());
+        for (int i = 0; i < (int)BrushRegistry::profiles.size(); i++) {
             ImU32 color = IM_COL32(rand() % 255, rand() % 255, rand() % 255, rand() % 255); // 使用宏创建，最安全
             std::vector<ImVec2> points;
             for (int j = 0; j < 100; j++)
                 points.push_back(ImVec2(j * 20, i * 50 + 50));
-            AppUI::strokes.emplace_back(
-                points, color, 15, Renderer::brushNames[i]
+            size_t s = strokes.Add(
+                points.data(), (int)points.size(), color, 15, i
             );
+            StrokeIndex::Insert(strokes.View(s));
         }
+        History::EndEdit(Layers::Active());
     }
     
     static int currentBrushIdx = 0;
     
-    if (!Renderer::brushNames.empty()) {
+    if (!BrushRegistry::profiles.empty()) {
         // ImGui 的 Combo 需要处理字符串数组，我们可以用一个 lambda 表达式
-        if (ImGui::BeginCombo("Brush Style", Renderer::brushNames[currentBrushIdx].c_str())) {
-            for (int n = 0; n < Renderer::brushNames.size(); n++) {
+        if (ImGui::BeginCombo("Brush Style", BrushRegistry::profiles[currentBrushIdx].name.c_str())) {
+            for (int n = 0; n < (int)BrushRegistry::profiles.size(); n++) {
                 const bool is_selected = (currentBrushIdx == n);
-                if (ImGui::Selectable(Renderer::brushNames[n].c_str(), is_selected))
+                if (ImGui::Selectable(BrushRegistry::profiles[n].name.c_str(), is_selected))
                     currentBrushIdx = n;
                 
                 if (is_selected)
@@ -133,11 +161,24 @@ void AppUI::Sidebar() {
     } else {
         ImGui::Text("No brushes found in /assets");
     }
-    brushName = Renderer::brushNames[currentBrushIdx];
+    brushId = currentBrushIdx;
 
     // 在 AppUI::Sidebar() 中
     ImGui::Text("Brush Settings");
     ImGui::SliderFloat("Size", &brushSize, 1.0f, 50.0f);
+    // 松开鼠标时把笔画简化成样条，0 = 保留原始点
+    ImGui::SliderFloat("Simplify", &CanvasLogic::fitTolerance, 0.0f, 4.0f, "%.2f px");
+    if (CanvasLogic::fitPointsIn > 0)
+        ImGui::Text("Fitted: %zu -> %zu points", CanvasLogic::fitPointsIn, CanvasLogic::fitPointsOut);
+    // 矩形 / 椭圆的旋转角，拖出来的框是旋转前的大小
+    if (currentTool == Tool::Rectangle || currentTool == Tool::Circle)
+        ImGui::SliderAngle("Rotation", &CanvasLogic::shapeRotation, -180.0f, 180.0f);
+    // 油漆桶只看当前层的底图，每个通道和点到的颜色差不超过 Tolerance 的连通区域都填上
+    if (currentTool == Tool::Fill) {
+        ImGui::SliderInt("Tolerance", &FloodFill::tolerance, 0, 255);
+        if (!FloodFill::status.empty())
+            ImGui::Text("%s\n%.1f ms (fill %.1f ms)", FloodFill::status.c_str(), FloodFill::latencyMs, FloodFill::fillMs);
+    }
 
     // 重点：开启 AlphaBar 标记，这样取色器右侧会出现透明度滑条
     ImGui::ColorEdit4("Color", (float*)&brushColor, ImGuiColorEditFlags_AlphaBar | ImGuiColorEditFlags_AlphaPreview);
@@ -147,42 +188,223 @@ void AppUI::Sidebar() {
     // ImGui::SliderFloat("Size", &brushSize, 1, 50);
     // ImGui::ColorEdit4("Color", (float*)&brushColor);
     
-    if (ImGui::Button("Bake", {-1, 40})) Renderer::PerformBake(strokes);
-    if (ImGui::Button("Clear All", {-1, 40})) { strokes.clear(); Renderer::ClearTexture(); }
+    ImGui::Checkbox("Auto Bake", &autoBake);
+    if (autoBake) {
+        ImGui::RadioButton("Stamp budget", &budgetMode, 0); ImGui::SameLine();
+        ImGui::RadioButton("Frame budget", &budgetMode, 1);
+        if (budgetMode == 0) ImGui::SliderInt("Max stamps", &maxLiveStamps, 10000, 1000000);
+        else ImGui::SliderFloat("Max ms", &frameBudgetMs, 1.0f, 16.0f);
+        ImGui::SliderInt("Keep recent", &keepRecent, 1, 200);
+    }
+    ImGui::Text("Live: %d strokes, %d stamps, %.2f ms", (int)strokes.size(), liveStamps, vectorPassMs);
+
+    ImGui::Checkbox("Draw call stats", &showDrawStats);
+    if (showDrawStats) {
+        bool atlas = BrushRegistry::useAtlas;
+        if (BrushRegistry::atlasTexture != 0 && ImGui::Checkbox("Use atlas", &atlas)) BrushRegistry::SetAtlasEnabled(atlas);
+        bool mips = Renderer::brushMipmaps;
+        if (ImGui::Checkbox("Brush mipmaps", &mips)) Renderer::SetBrushMipmaps(mips);
+        // 顶点拉取的印章和 CPU 顶点两条路径对比每帧上传量
+        if (Renderer::stampsAvailable) ImGui::Checkbox("Vertex-pulled stamps", &Renderer::vertexPulling);
+        ImGui::Text("Canvas: %d cmds (per-brush: %d)", canvasDrawCmds, brushSwitchCmds);
+        ImGui::Text("Frame: %d cmds", frameDrawCmds);
+        ImGui::Text("ImGui vertices: %.1f KB", frameVertexBytes / 1024.0f);
+        ImGui::Text("Input: %d samples, %.1f ms old, %zu dropped", InputQueue::lastCount, InputQueue::lastLatencyMs,
+                    InputQueue::dropped.load());
+        if (Renderer::vertexPulling)
+            ImGui::Text("Stamps: %d, upload %.1f KB", Renderer::stampsDrawn, Renderer::stampUploadBytes / 1024.0f);
+    }
+
+    // 导出只拷了笔画，底图还是从 TileCanvas 里读，会改底图的按钮导出期间都停用
+    bool exporting = Exporter::Busy();
+    ImGui::BeginDisabled(exporting);
+    if (ImGui::Button("Undo", {118, 0})) History::Undo();
+    ImGui::SameLine();
+    if (ImGui::Button("Redo", {118, 0})) History::Redo();
+    ImGui::EndDisabled();
+    static int historyMB = (int)(History::memoryCap >> 20);
+    if (ImGui::SliderInt("History MB", &historyMB, 8, 2048)) History::memoryCap = (size_t)historyMB << 20;
+    ImGui::Text("History: %d steps, %.1f MB", History::UndoCount(), History::MemoryUsed() / (1024.0f * 1024.0f));
+
+    // 录下画布输入，给 ReplayBench 回放
+    if (!InputRecorder::recording) {
+        if (ImGui::Button("Record input", {-1, 0})) InputRecorder::Start();
+    } else if (ImGui::Button("Stop recording", {-1, 0})) {
+        InputRecorder::Stop("session.rec");
+    }
+    if (InputRecorder::recording) ImGui::Text("Recording: %d frames", (int)InputRecorder::frames.size());
+
+    ImGui::InputText("File", docPath, sizeof(docPath));
+    if (ImGui::Button("Save", {118, 0})) Document::Save(docPath);
+    ImGui::SameLine();
+    ImGui::BeginDisabled(exporting);
+    if (ImGui::Button("Open", {118, 0}) && !Document::Saving() && Document::Load(docPath)) FitView();
+    ImGui::EndDisabled();
+    if (Document::Loading()) ImGui::ProgressBar(Document::LoadProgress(), {-1, 0});
+    if (!Document::status.empty()) ImGui::TextWrapped("%s", Document::status.c_str());
+
+    // 按倍数重新渲染可见图层导出 PNG，扩展名是 .rgba / .raw 时存裸 RGBA
+    ImGui::InputText("Export", exportPath, sizeof(exportPath));
+    ImGui::SliderFloat("Scale", &exportScale, 1.0f, 8.0f, "%.1fx");
+    if (ImGui::Button("Export", {-1, 0})) Exporter::Start(exportPath, exportScale);
+    if (Exporter::Busy()) ImGui::ProgressBar(Exporter::Progress(), {-1, 0});
+    if (!Exporter::status.empty()) ImGui::TextWrapped("%s", Exporter::status.c_str());
+
+    // 画布尺寸和视口：中键或空格 + 左键拖动平移，滚轮缩放
+    ImGui::Text("Canvas %d x %d, zoom %.1f%%", canvasW, canvasH, zoom * 100);
+    if (ImGui::Button("100%", {118, 0})) zoom = 1.0f;
+    ImGui::SameLine();
+    if (ImGui::Button("Fit", {118, 0})) FitView();
+    ImGui::InputInt2("Size", newCanvasSize);
+    ImGui::BeginDisabled(exporting);
+    if (ImGui::Button("New canvas", {-1, 0}) && !Document::Saving())
+        NewCanvas(std::clamp(newCanvasSize[0], 1, MAX_CANVAS), std::clamp(newCanvasSize[1], 1, MAX_CANVAS));
+    ImGui::EndDisabled();
+    static int tileMB = (int)(TileCanvas::residentBudget >> 20);
+    if (ImGui::SliderInt("Tile MB", &tileMB, 32, 4096)) TileCanvas::residentBudget = (size_t)tileMB << 20;
+    ImGui::Text("Tiles: %d painted, %d resident, %d drawn", TileCanvas::TileCount(), TileCanvas::ResidentCount(), Compositor::tilesDrawn);
+    ImGui::Text("Swapped: %.1f MB in RAM, %.1f MB on disk", TileCanvas::PackedBytes() / (1024.0f * 1024.0f),
+                TileCanvas::SwapBytes() / (1024.0f * 1024.0f));
+
+    ImGui::BeginDisabled(exporting);
+    if (ImGui::Button("Bake", {-1, 40})) History::Bake(Layers::Active(), 0, strokes.size());
+    if (ImGui::Button("Clear All", {-1, 40})) History::ClearAll(Layers::Active());
+    ImGui::EndDisabled();
+
+    // 图层面板：最上面的图层列在最前面；画到一半时不能改
+    ImGui::Text("Layers");
+    ImGui::BeginDisabled(isDrawing || History::Editing());
+    for (int k = Layers::Count() - 1; k >= 0; k--) {
+        const Layer& l = Layers::At(k);
+        ImGui::PushID(l.id);
+        bool visible = l.visible;
+        if (ImGui::Checkbox("##visible", &visible)) Layers::SetVisible(k, visible);
+        ImGui::SameLine();
+        if (ImGui::Selectable(l.name.c_str(), k == Layers::active)) Layers::Select(k);
+        ImGui::PopID();
+    }
+    float opacity = Layers::Active().opacity;
+    if (ImGui::SliderFloat("Opacity", &opacity, 0.0f, 1.0f)) Layers::SetOpacity(Layers::active, opacity);
+    int blend = (int)Layers::Active().blend;
+    if (ImGui::Combo("Blend", &blend, Layers::BLEND_NAMES, IM_ARRAYSIZE(Layers::BLEND_NAMES)))
+        Layers::SetBlend(Layers::active, (BlendMode)blend);
+    if (ImGui::Button("Add", {56, 0})) Layers::Add();
+    ImGui::SameLine();
+    if (ImGui::Button("Delete", {56, 0})) Layers::Remove(Layers::active);
+    ImGui::SameLine();
+    if (ImGui::Button("Up", {56, 0})) Layers::Move(Layers::active, Layers::active + 1);
+    ImGui::SameLine();
+    if (ImGui::Button("Down", {56, 0})) Layers::Move(Layers::active, Layers::active - 1);
+    ImGui::EndDisabled();
+    ImGui::Text("Composite: %d cached, %d composed", Compositor::CachedTiles(), Compositor::tilesComposed);
     
     ImGui::End();
 }
 
 #include<iostream>
 void AppUI::Canvas() {
+    PROFILE_SCOPE("AppUI::Canvas");
     ImGui::SetNextWindowPos({250, 0});
     ImGui::SetNextWindowSize({CANVAS_W, CANVAS_H});
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, {0,0});
-    ImGui::Begin("Canvas", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize);
+    ImGui::Begin("Canvas", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollWithMouse);
     
     ImVec2 p0 = ImGui::GetCursorScreenPos();
     ImVec2 mousePos = ImGui::GetMousePos();
-    ImVec2 relPos = {mousePos.x - p0.x, mousePos.y - p0.y};
     ImDrawList* dl = ImGui::GetWindowDrawList();
+    ImGuiIO& io = ImGui::GetIO();
+    bool hovered = ImGui::IsWindowHovered();
+    Layer& layer = Layers::Active();
+    StrokeStore& strokes = layer.strokes;
+
+    // 0. 视口：中键拖动或按住空格左键拖动平移，滚轮以鼠标为中心缩放
+    bool panning = hovered && !isDrawing && (ImGui::IsMouseDown(2) || ImGui::IsKeyDown(ImGuiKey_Space));
+    if (panning && (ImGui::IsMouseDown(0) || ImGui::IsMouseDown(2))) {
+        pan.x -= io.MouseDelta.x / zoom;
+        pan.y -= io.MouseDelta.y / zoom;
+    }
+    if (hovered && io.MouseWheel != 0.0f) {
+        ImVec2 under = {(mousePos.x - p0.x) / zoom + pan.x, (mousePos.y - p0.y) / zoom + pan.y};
+        zoom = std::clamp(zoom * powf(1.15f, io.MouseWheel), MIN_ZOOM, MAX_ZOOM);
+        // 缩放后鼠标下面还是同一个画布点
+        pan = {under.x - (mousePos.x - p0.x) / zoom, under.y - (mousePos.y - p0.y) / zoom};
+    }
+    ImVec2 origin = {p0.x - pan.x * zoom, p0.y - pan.y * zoom}; // 画布 (0, 0) 在屏幕上的位置
+    ImVec2 relPos = {(mousePos.x - p0.x) / zoom + pan.x, (mousePos.y - p0.y) / zoom + pan.y};
 
-    // 1. 底图
-    dl->AddImage((ImTextureID)(intptr_t)Renderer::bakedTexture, p0, {p0.x + CANVAS_W, p0.y + CANVAS_H}, {0,1}, {1,0});
+    // 上一帧以来按着左键时的光标采样，换成画布坐标；每帧都取空，不在画布上时直接丢掉
+    static std::vector<InputSample> pending;
+    static std::vector<ImVec2> samples;
+    InputQueue::Drain(pending);
+    samples.clear();
+    for (const InputSample& s : pending)
+        if (s.down) samples.push_back({(s.x - p0.x) / zoom + pan.x, (s.y - p0.y) / zoom + pan.y});
 
-    // 2. 交互
-    if (ImGui::IsWindowHovered()) {
-        if (currentTool == Tool::Brush) CanvasLogic::ProcessBrush(strokes, relPos, ImGui::ColorConvertFloat4ToU32(brushColor), brushSize, isDrawing, brushName);
-        else if (currentTool == Tool::Rectangle) CanvasLogic::ProcessRectangle(strokes, relPos, rectStartPos, ImGui::ColorConvertFloat4ToU32(brushColor), brushSize, isDrawing);
-        else if (currentTool == Tool::Circle) CanvasLogic::ProcessCircle(strokes, relPos, rectStartPos, ImGui::ColorConvertFloat4ToU32(brushColor), brushSize, isDrawing);
-        else if (currentTool == Tool::StrokeEraser && ImGui::IsMouseDown(0)) CanvasLogic::ProcessStrokeEraser(strokes, relPos, brushSize);
-        else if (currentTool == Tool::PreciseEraser && ImGui::IsMouseDown(0)) CanvasLogic::ProcessPreciseEraser(strokes, relPos, brushSize);
+    // 1. 交互（只作用在当前层）；取色不改笔画，在下面合成完之后处理；油漆桶改的是底图
+    bool onCanvas = relPos.x >= 0 && relPos.y >= 0 && relPos.x < canvasW && relPos.y < canvasH;
+    if (currentTool == Tool::Fill) {
+        if (hovered && !panning && onCanvas && !Exporter::Busy() && ImGui::IsMouseClicked(0)) FloodFill::Start(layer, relPos, ImGui::ColorConvertFloat4ToU32(brushColor));
+    } else if (hovered && !panning && currentTool != Tool::Eyedropper) {
+        if (ImGui::IsMouseClicked(0)) History::BeginEdit(layer);
+        CanvasLogic::Process(currentTool, strokes, relPos, rectStartPos, ImGui::ColorConvertFloat4ToU32(brushColor), brushSize, isDrawing, brushId,
+                             samples.data(), (int)samples.size());
+    }
+    InputRecorder::Capture({relPos, ImGui::IsMouseDown(0) && !panning, hovered && !panning, currentTool, brushId, brushSize, ImGui::ColorConvertFloat4ToU32(brushColor)});
+    if (ImGui::IsMouseReleased(0)) {
+        isDrawing = false;
+        History::EndEdit(layer);
     }
-    if (ImGui::IsMouseReleased(0)) isDrawing = false;
 
-    // 3. 矢量层渲染
-    for (const auto& s : strokes) {
-        RenderStroke(dl, s, p0);
+    // 2. 图层合成：可见图层的底图和未烘焙笔画叠好后按瓦片画出来
+    PROFILE_SCOPE("AppUI::Canvas vector pass");
+    auto t0 = std::chrono::steady_clock::now();
+    int cmdsBefore = dl->CmdBuffer.Size;
+    ImVec2 viewMax = {pan.x + CANVAS_W / zoom, pan.y + CANVAS_H / zoom};
+    Compositor::Draw(dl, origin, zoom, pan, viewMax);
+    liveStamps = 0;
+    int lastBrush = -1;
+    brushSwitchCmds = 1 + Compositor::tilesDrawn; // 白底和每块瓦片
+    for (size_t i = 0; i < strokes.size(); i++) {
+        liveStamps += (int)strokes.Cache(i).stamps.size();
+        if (strokes.brush[i] != lastBrush) { brushSwitchCmds++; lastBrush = strokes.brush[i]; }
     }
+    // 每块瓦片一个；笔画都画进了合成缓存
+    canvasDrawCmds = dl->CmdBuffer.Size - cmdsBefore;
+
+    // 3. 取色：按住左键时读回光标下显示出来的颜色（合成好的画布，不含之后画的界面），一两帧后才到，透明度保持不变
+    if (currentTool == Tool::Eyedropper && hovered && !panning && onCanvas && ImGui::IsMouseDown(0)) {
+        Renderer::SamplePixel(dl, mousePos, [](ImU32 c) {
+            ImVec4 v = ImGui::ColorConvertU32ToFloat4(c);
+            brushColor = {v.x, v.y, v.z, brushColor.w};
+        });
+    }
+    PROFILE_COUNTER("stamps", liveStamps);
+    PROFILE_COUNTER("strokes", strokes.size());
+    vectorPassMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
 
     ImGui::End();
     ImGui::PopStyleVar();
+}
+
+bool AppUI::Busy() {
+    return isDrawing || History::Editing() || ImGui::IsMouseDown(0) || ImGui::IsMouseDown(2) || ImGui::IsAnyItemActive() ||
+           Document::Loading() || Document::Saving() || Exporter::Busy() || Renderer::AssetsPending() ||
+           Renderer::ReadbacksPending() > 0 || FloodFill::Busy() || Compositor::pending || TileCanvas::RestoresPending();
+}
+
+// 整张画布缩放到窗口里居中，最多放大到 100%
+void AppUI::FitView() {
+    zoom = std::clamp(std::min((float)CANVAS_W / canvasW, (float)CANVAS_H / canvasH), MIN_ZOOM, 1.0f);
+    pan = {canvasW * 0.5f - CANVAS_W * 0.5f / zoom, canvasH * 0.5f - CANVAS_H * 0.5f / zoom};
+}
+
+// 换一张 w x h 的空白画布：图层、笔画、撤销记录、底图瓦片、合成缓存都丢掉
+void AppUI::NewCanvas(int w, int h) {
+    if (isDrawing) return;
+    TileCanvas::Init(w, h);
+    Layers::Reset();
+    StrokeIndex::Clear();
+    History::Reset();
+    Compositor::Clear();
+    FitView();
 }
\ No newline at end of file
@@ -1,18 +1,48 @@
 #pragma once
 #include "Common.h"
+#include "StrokeStore.h"
 
 class AppUI {
 public:
     static void Render(bool& shouldBake);
+    static void RecordFrameStats(const ImDrawData* data); // ImGui::Render 之后调用，统计整帧的 draw call
+    // 还有没做完的事（加载、保存、导出、回读、填充、笔刷上传、瓦片换回、合成、正在拖动），主循环不能睡
+    static bool Busy();
 private:
     static void Sidebar();
     static void Canvas();
+    static void AutoBake();
+    static void FitView();
+    static void NewCanvas(int w, int h);
     
     static Tool currentTool;
     static BrushType brushType;
     static float brushSize;
     static ImVec4 brushColor;
-    static std::vector<Stroke> strokes;
     static bool isDrawing;
     static ImVec2 rectStartPos;
+
+    // 视口：画布坐标 c 显示在画布窗口里的 (c - pan) * zoom 处
+    static ImVec2 pan;
+    static float zoom;
+    static int newCanvasSize[2];
+
+    // 自动烘焙：超出预算时把最老的笔画分批烘进底图，最近 keepRecent 笔保持可编辑
+    static bool autoBake;
+    static int budgetMode;          // 0 = 印章数，1 = 矢量层每帧毫秒数
+    static int maxLiveStamps;
+    static float frameBudgetMs;
+    static int keepRecent;
+    static int liveStamps;          // 上一帧当前层未烘焙的印章数
+    static float vectorPassMs;      // 上一帧图层合成耗时
+    static char docPath[256];
+    static char exportPath[256];
+    static float exportScale;
+
+    // 调试浮层：画布实际的 draw call 数，以及不用图集时按笔刷纹理切换估算的数目
+    static bool showDrawStats;
+    static int canvasDrawCmds;
+    static int brushSwitchCmds;
+    static int frameDrawCmds;
+    static size_t frameVertexBytes; // 整帧 ImDrawList 顶点 + 索引的字节数
 };
\ No newline at end of file
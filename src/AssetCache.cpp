@@ -0,0 +1,154 @@
+#include "AssetCache.h"
+#include <stb/stb_image.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+namespace fs = std::filesystem;
+
+std::string AssetCache::cacheDir = ".cache/brushes";
+
+// 缓存文件头，后面紧跟 w * h * 4 字节的 RGBA，再按级接着 mip 链
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t mtime;
+    uint64_t size;
+    int32_t w, h;
+};
+static const uint32_t CACHE_VERSION = 2;
+
+static bool SourceStamp(const std::string& srcPath, int64_t& mtime, uint64_t& size) {
+    std::error_code ec;
+    auto t = fs::last_write_time(srcPath, ec);
+    if (ec) return false;
+    size = fs::file_size(srcPath, ec);
+    if (ec) return false;
+    mtime = (int64_t)t.time_since_epoch().count();
+    return true;
+}
+
+// 按源文件带扩展名的完整相对路径放，brush_x.png 和 brush_x.jpg 各有各的缓存；
+// 绝对路径去掉根，".." 换成 "_"，缓存不会写到 cacheDir 外面
+static std::string CachePath(const std::string& srcPath) {
+    fs::path key;
+    for (const fs::path& part : fs::path(srcPath).lexically_normal().relative_path())
+        key /= part == ".." ? fs::path("_") : part;
+    return (fs::path(AssetCache::cacheDir) / key).string() + ".rgba";
+}
+
+bool AssetCache::Load(const std::string& srcPath, DecodedImage& out) {
+    int64_t mtime;
+    uint64_t size;
+    if (!SourceStamp(srcPath, mtime, size)) return false;
+
+    std::ifstream in(CachePath(srcPath), std::ios::binary);
+    if (!in) return false;
+    CacheHeader h;
+    if (!in.read((char*)&h, sizeof(h))) return false;
+    if (memcmp(h.magic, "BRC1", 4) != 0 || h.version != CACHE_VERSION) return false;
+    if (h.mtime != mtime || h.size != size || h.w <= 0 || h.h <= 0) return false;
+
+    out.w = h.w;
+    out.h = h.h;
+    out.rgba.resize((size_t)h.w * h.h * 4);
+    if (!in.read((char*)out.rgba.data(), out.rgba.size())) return false;
+    out.mips.clear();
+    for (int k = 1; MipSize(h.w, k - 1) > 1 || MipSize(h.h, k - 1) > 1; k++) {
+        out.mips.emplace_back((size_t)MipSize(h.w, k) * MipSize(h.h, k) * 4);
+        if (!in.read((char*)out.mips.back().data(), out.mips.back().size())) return false;
+    }
+    return true;
+}
+
+void AssetCache::Store(const std::string& srcPath, const DecodedImage& img) {
+    CacheHeader h;
+    memcpy(h.magic, "BRC1", 4);
+    h.version = CACHE_VERSION;
+    if (!SourceStamp(srcPath, h.mtime, h.size)) return;
+    h.w = img.w;
+    h.h = img.h;
+
+    // 先写临时文件再改名，避免并发或中途退出留下半个缓存
+    std::string path = CachePath(srcPath);
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) return;
+        out.write((const char*)&h, sizeof(h));
+        out.write((const char*)img.rgba.data(), img.rgba.size());
+        for (const auto& level : img.mips) out.write((const char*)level.data(), level.size());
+        if (!out) return;
+    }
+    fs::rename(tmp, path, ec);
+}
+
+bool AssetCache::Decode(const std::string& srcPath, DecodedImage& out, bool& fromCache) {
+    fromCache = Load(srcPath, out);
+    if (fromCache) return true;
+
+    int channels;
+    unsigned char* data = stbi_load(srcPath.c_str(), &out.w, &out.h, &channels, 4);
+    if (!data) return false;
+    out.rgba.assign(data, data + (size_t)out.w * out.h * 4);
+    stbi_image_free(data);
+    BuildMips(out);
+    Store(srcPath, out);
+    return true;
+}
+
+
+static float SrgbToLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static unsigned char LinearToSrgb(float c) {
+    c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+void AssetCache::BuildMips(DecodedImage& img) {
+    static float toLinear[256];
+    static bool lutReady = [] {
+        for (int i = 0; i < 256; i++) toLinear[i] = SrgbToLinear(i / 255.0f);
+        return true;
+    }();
+    (void)lutReady;
+
+    img.mips.clear();
+    const unsigned char* src = img.rgba.data();
+    int sw = img.w, sh = img.h;
+    while (sw > 1 || sh > 1) {
+        int dw = std::max(1, sw / 2), dh = std::max(1, sh / 2);
+        std::vector<unsigned char> dst((size_t)dw * dh * 4);
+        for (int y = 0; y < dh; y++) {
+            // 奇数边长时最后一行/列并进前一格，边长为 1 的方向只取一行/列
+            int y0 = std::min(y * 2, sh - 1), y1 = std::min(y * 2 + 1, sh - 1);
+            for (int x = 0; x < dw; x++) {
+                int x0 = std::min(x * 2, sw - 1), x1 = std::min(x * 2 + 1, sw - 1);
+                const unsigned char* px[4] = {src + ((size_t)y0 * sw + x0) * 4, src + ((size_t)y0 * sw + x1) * 4,
+                                              src + ((size_t)y1 * sw + x0) * 4, src + ((size_t)y1 * sw + x1) * 4};
+                float rgb[3] = {0, 0, 0}, plain[3] = {0, 0, 0}, alpha = 0;
+                for (const unsigned char* p : px) {
+                    float a = p[3] / 255.0f;
+                    for (int c = 0; c < 3; c++) {
+                        rgb[c] += toLinear[p[c]] * a;
+                        plain[c] += toLinear[p[c]];
+                    }
+                    alpha += a;
+                }
+                unsigned char* out = &dst[((size_t)y * dw + x) * 4];
+                // 全透明时按不加权的平均保留颜色，以后再缩小也不会把黑色带进来
+                for (int c = 0; c < 3; c++) out[c] = LinearToSrgb(alpha > 0 ? rgb[c] / alpha : plain[c] / 4);
+                out[3] = (unsigned char)(alpha / 4 * 255.0f + 0.5f);
+            }
+        }
+        img.mips.push_back(std::move(dst));
+        src = img.mips.back().data();
+        sw = dw;
+        sh = dh;
+    }
+}
\ No newline at end of file
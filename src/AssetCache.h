@@ -0,0 +1,27 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// 第 level 级 mip 的边长
+inline int MipSize(int size, int level) { return std::max(1, size >> level); }
+
+struct DecodedImage {
+    int w = 0, h = 0;
+    std::vector<unsigned char> rgba;
+    std::vector<std::vector<unsigned char>> mips; // 第 1 级起到 1x1，第 k 级在 mips[k - 1]
+};
+
+// 解码好的笔刷 RGBA 连同 mip 链缓存在 .cache/brushes/<源文件路径>.rgba，用源文件的修改时间和大小校验；
+// 热启动时直接读缓存，跳过 PNG 解码和缩小。可以在任意线程调用
+class AssetCache {
+public:
+    static std::string cacheDir;
+
+    static bool Decode(const std::string& srcPath, DecodedImage& out, bool& fromCache);
+    static bool Load(const std::string& srcPath, DecodedImage& out);
+    static void Store(const std::string& srcPath, const DecodedImage& img);
+    // 逐级 2x2 缩小：先把 sRGB 转到线性光、按 alpha 加权平均，再转回 sRGB 和非预乘，
+    // 细笔刷缩小后不会发暗，透明边缘的颜色也不会渗进来
+    static void BuildMips(DecodedImage& img);
+};
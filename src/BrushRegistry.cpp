@@ -0,0 +1,94 @@
+#include "BrushRegistry.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+std::vector<BrushProfile> BrushRegistry::profiles;
+int BrushRegistry::generation = 0;
+GLuint BrushRegistry::atlasTexture = 0;
+bool BrushRegistry::useAtlas = true;
+
+int BrushRegistry::Register(const std::string& name, GLuint texture, const std::string& sidecarPath) {
+    BrushProfile p;
+    p.name = name;
+    p.texture = texture;
+    p.ownTexture = texture;
+    LoadSidecar(sidecarPath, p);
+    int id = Find(name);
+    if (id >= 0) {
+        profiles[id] = p;
+        return id;
+    }
+    profiles.push_back(p);
+    return (int)profiles.size() - 1;
+}
+
+int BrushRegistry::Find(const std::string& name) {
+    for (int i = 0; i < (int)profiles.size(); i++) {
+        if (profiles[i].name == name) return i;
+    }
+    return -1;
+}
+
+const BrushProfile& BrushRegistry::Get(int id) {
+    static const BrushProfile fallback;
+    if (id < 0 || id >= (int)profiles.size()) return fallback;
+    return profiles[id];
+}
+
+// 格式：每行 key = value，# 开头是注释
+//   spacing = 0.8
+//   jitter_pos = 2.0
+//   jitter_size = 0.5
+//   rotation = random | follow
+bool BrushRegistry::LoadSidecar(const std::string& path, BrushProfile& profile) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+
+        std::string key, value;
+        std::istringstream(line.substr(0, eq)) >> key;
+        std::istringstream(line.substr(eq + 1)) >> value;
+        if (key.empty() || value.empty()) continue;
+
+        float* number = key == "spacing" ? &profile.spacing : key == "jitter_pos" ? &profile.jitterPos :
+                        key == "jitter_size" ? &profile.jitterSize : nullptr;
+        if (number) {
+            // 写错的值整行忽略，保留默认值
+            char* end = nullptr;
+            float v = strtof(value.c_str(), &end);
+            if (end != value.c_str() + value.size() || !std::isfinite(v)) std::cout << path << ": bad value for " << key << ": " << value << std::endl;
+            else *number = v;
+        } else if (key == "rotation") profile.rotation = (value == "follow") ? RotationMode::FollowStroke : RotationMode::Random;
+        else std::cout << path << ": unknown key " << key << std::endl;
+    }
+    return true;
+}
+
+void BrushRegistry::SetTexture(int id, GLuint texture) {
+    profiles[id].ownTexture = texture;
+    if (!(useAtlas && atlasTexture)) profiles[id].texture = texture;
+}
+
+void BrushRegistry::SetAtlas(GLuint atlas) {
+    atlasTexture = atlas;
+    SetAtlasEnabled(useAtlas);
+}
+
+void BrushRegistry::SetAtlasEnabled(bool enabled) {
+    useAtlas = enabled;
+    bool on = enabled && atlasTexture != 0;
+    for (auto& p : profiles) {
+        p.texture = on ? atlasTexture : p.ownTexture;
+        p.uvMin = on ? p.atlasUvMin : ImVec2(0, 0);
+        p.uvMax = on ? p.atlasUvMax : ImVec2(1, 1);
+    }
+    generation++;
+}
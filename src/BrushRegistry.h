@@ -0,0 +1,36 @@
+#pragma once
+#include "Common.h"
+
+enum class RotationMode { Random, FollowStroke };
+
+// 一个笔刷的全部参数；可以用 assets/ 里和 PNG 同名的 .brush 文件覆盖默认值
+struct BrushProfile {
+    std::string name;
+    float spacing = 0.1f;     // 印章间距（相对粗细）
+    float jitterPos = 0.0f;   // 坐标抖动（相对粗细）
+    float jitterSize = 0.0f;  // 大小抖动
+    RotationMode rotation = RotationMode::Random;
+    GLuint texture = 0;        // 实际绑定的纹理：图集或者单独的纹理
+    ImVec2 uvMin = {0, 0};     // 在 texture 里的 UV 矩形
+    ImVec2 uvMax = {1, 1};
+
+    GLuint ownTexture = 0;     // 单独上传的纹理
+    ImVec2 atlasUvMin = {0, 0}, atlasUvMax = {1, 1};
+};
+
+// 笔刷注册表：ScanAssets 里按顺序分配小整数 id，笔画只存 id，渲染时直接下标取参数
+class BrushRegistry {
+public:
+    static std::vector<BrushProfile> profiles;
+    static int generation;  // texture/UV 改变时加一，笔画缓存据此重建
+    static GLuint atlasTexture;
+    static bool useAtlas;
+
+    static int Register(const std::string& name, GLuint texture, const std::string& sidecarPath);
+    static int Find(const std::string& name); // 找不到返回 -1
+    static const BrushProfile& Get(int id);   // id 无效时返回默认参数
+    static bool LoadSidecar(const std::string& path, BrushProfile& profile);
+    static void SetTexture(int id, GLuint texture);
+    static void SetAtlas(GLuint atlas);              // 每个笔刷的 atlasUvMin/Max 要先填好
+    static void SetAtlasEnabled(bool enabled);
+};
@@ -1,135 +1,369 @@
 #include "CanvasLogic.h"
+#include "StrokeIndex.h"
+#include "Profiler.h"
 #include <string>
 #include <algorithm>
 
+#include "BrushRegistry.h"
+
 #define DEFAULT_BRUSH "brush_ink"
 
+void (*CanvasLogic::onRemove)(const StrokeStore& strokes, size_t i) = nullptr;
+float CanvasLogic::fitTolerance = 1.0f;
+float CanvasLogic::shapeRotation = 0.0f;
+size_t CanvasLogic::fitPointsIn = 0;
+size_t CanvasLogic::fitPointsOut = 0;
+
 float CanvasLogic::GetDistance(ImVec2 p1, ImVec2 p2) {
     return std::sqrt(std::pow(p1.x - p2.x, 2) + std::pow(p1.y - p2.y, 2));
 }
 
-std::vector<ImVec2> densify(std::vector<ImVec2> s, int iter = 2) {
-    std::vector<ImVec2> dense;
-    dense.push_back(s[0]);
-    for (int i = 1; i < (int)s.size(); i++) {
-        ImVec2 lst = s[i - 1];
-        ImVec2 cur = s[i];
-        for (int j = 1; j < iter; j++) {
-            dense.push_back(
-                ImVec2(
-                    (lst.x * (iter - j) + cur.x * j) / iter,
-                    (lst.y * (iter - j) + cur.y * j) / iter
-                )
-            );
+float CanvasLogic::GetDistanceSq(ImVec2 p1, ImVec2 p2) {
+    float dx = p1.x - p2.x, dy = p1.y - p2.y;
+    return dx * dx + dy * dy;
+}
+
+float CanvasLogic::SegmentDistanceSq(ImVec2 p, ImVec2 a, ImVec2 b) {
+    float abx = b.x - a.x, aby = b.y - a.y;
+    float len2 = abx * abx + aby * aby;
+    if (len2 <= 0.0f) return GetDistanceSq(p, a);
+    float t = ((p.x - a.x) * abx + (p.y - a.y) * aby) / len2;
+    t = std::clamp(t, 0.0f, 1.0f);
+    return GetDistanceSq(p, {a.x + abx * t, a.y + aby * t});
+}
+
+
+// Ramer–Douglas–Peucker：保留首尾，离弦最远的点超过 tolerance 就保留并分两半继续；用栈代替递归
+void CanvasLogic::SimplifyRDP(const ImVec2* in, int n, float tolerance, std::vector<ImVec2>& out) {
+    out.clear();
+    if (n < 3) {
+        out.assign(in, in + n);
+        return;
+    }
+    std::vector<char> keep(n, 0);
+    keep.front() = keep.back() = 1;
+    std::vector<std::pair<int, int>> stack = {{0, n - 1}};
+    float tol2 = tolerance * tolerance;
+    while (!stack.empty()) {
+        auto [a, b] = stack.back();
+        stack.pop_back();
+        int far = -1;
+        float farDist = tol2;
+        for (int i = a + 1; i < b; i++) {
+            float d = SegmentDistanceSq(in[i], in[a], in[b]);
+            if (d > farDist) { farDist = d; far = i; }
+        }
+        if (far < 0) continue;
+        keep[far] = 1;
+        stack.push_back({a, far});
+        stack.push_back({far, b});
+    }
+    for (int i = 0; i < n; i++)
+        if (keep[i]) out.push_back(in[i]);
+}
+
+void CanvasLogic::FitStroke(StrokeStore& strokes, size_t i) {
+    if (fitTolerance <= 0.0f || strokes.spline[i] || strokes.Count(i) < 3) return;
+    static std::vector<ImVec2> fitted;
+    SimplifyRDP(strokes.Points(i), strokes.Count(i), fitTolerance, fitted);
+    fitPointsIn += strokes.Count(i);
+    fitPointsOut += fitted.size();
+    strokes.SetPoints(i, fitted.data(), (int)fitted.size());
+    strokes.spline[i] = 1;
+}
+
+void CanvasLogic::Process(Tool tool, StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing, int brush,
+                          const ImVec2* samples, int sampleCount) {
+    PROFILE_SCOPE("CanvasLogic::Process");
+    if (tool == Tool::Brush) ProcessBrush(strokes, relPos, color, size, isDrawing, brush, samples, sampleCount);
+    else if (tool == Tool::Rectangle) ProcessRectangle(strokes, relPos, startPos, color, size, isDrawing);
+    else if (tool == Tool::Circle) ProcessCircle(strokes, relPos, startPos, color, size, isDrawing);
+    else if ((tool == Tool::StrokeEraser || tool == Tool::PreciseEraser) && ImGui::IsMouseDown(0)) {
+        // 帧间的采样也擦一遍；挨得太近的跳过，擦除比追加点贵得多
+        ImVec2 last = {-FLT_MAX, -FLT_MAX};
+        for (int k = 0; k <= sampleCount; k++) {
+            ImVec2 p = k < sampleCount ? samples[k] : relPos;
+            if (k < sampleCount && GetDistanceSq(p, last) < size * size * 0.0625f) continue;
+            if (tool == Tool::StrokeEraser) ProcessStrokeEraser(strokes, p, size);
+            else ProcessPreciseEraser(strokes, p, size);
+            last = p;
         }
-        dense.push_back(cur);
     }
-    return dense;
 }
 
-void CanvasLogic::ProcessBrush(std::vector<Stroke>& strokes, ImVec2 relPos, ImU32 color, float size, bool& isDrawing, std::string brushName) {
+void CanvasLogic::ProcessBrush(StrokeStore& strokes, ImVec2 relPos, ImU32 color, float size, bool& isDrawing, int brush,
+                               const ImVec2* samples, int sampleCount) {
+    PROFILE_SCOPE("CanvasLogic::ProcessBrush");
     if (ImGui::IsMouseClicked(0)) {
         isDrawing = true;
-        strokes.push_back(Stroke({relPos}, color, size, brushName));
+        // 有采样时从按下的那个点开始
+        ImVec2 start = sampleCount > 0 ? samples[0] : relPos;
+        StrokeIndex::Insert(strokes.View(strokes.Add(&start, 1, color, size, brush)));
     }
-    if (isDrawing && ImGui::IsMouseDown(0)) {
-        if (GetDistance(strokes.back().points.back(), relPos) > 2.0f)
-            strokes.back().points.push_back(relPos);
+    if (strokes.empty()) return;
+    size_t i = strokes.size() - 1;
+    // 松开那一帧也把松开之前的采样接上
+    if (isDrawing && (ImGui::IsMouseDown(0) || ImGui::IsMouseReleased(0))) {
+        for (int k = 0; k <= sampleCount; k++) {
+            if (k == sampleCount && !ImGui::IsMouseDown(0)) break;
+            ImVec2 p = k < sampleCount ? samples[k] : relPos;
+            if (GetDistance(strokes.Points(i)[strokes.Count(i) - 1], p) > 2.0f) {
+                strokes.AppendPoint(i, p); // 只追加点，渲染缓存会自己补上新线段
+                StrokeIndex::AddSegment(strokes.View(i), strokes.Count(i) - 2);
+            }
+        }
+    }
+    if (isDrawing && ImGui::IsMouseReleased(0)) {
+        StrokeIndex::Remove(strokes.View(i));
+        FitStroke(strokes, i);
+        StrokeIndex::Insert(strokes.View(i));
     }
 }
-// #include <iostream>
-void CanvasLogic::ProcessRectangle(std::vector<Stroke>& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing) {
+// 矩形和椭圆存成参数化图形：拖动时只改 3 个控制点（中心和两条半轴的端点），图形多大都不多占内存，
+// 印章按弧长沿精确的边界放；松开时什么都不用做
+static void DragShape(StrokeShape shape, StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing) {
     if (ImGui::IsMouseClicked(0)) {
         isDrawing = true;
         startPos = relPos;
-        std::vector<ImVec2> pts(5, relPos);
-        strokes.push_back(Stroke(pts, color, size, DEFAULT_BRUSH));
+        ImVec2 pts[3] = {relPos, relPos, relPos};
+        size_t i = strokes.Add(pts, 3, color, size, BrushRegistry::Find(DEFAULT_BRUSH));
+        strokes.shape[i] = shape;
+        StrokeIndex::Insert(strokes.View(i));
     }
+    if (strokes.empty()) return;
+    size_t i = strokes.size() - 1;
     if (isDrawing && ImGui::IsMouseDown(0)) {
-        Stroke& s = strokes.back();
-        s.points[1] = { relPos.x, startPos.y };
-        s.points[2] = relPos;
-        s.points[3] = { startPos.x, relPos.y };
-        s.points[4] = startPos;
+        StrokeIndex::Remove(strokes.View(i));
+        ImVec2 c = {(relPos.x + startPos.x) / 2, (relPos.y + startPos.y) / 2};
+        float rx = fabsf(relPos.x - startPos.x) / 2, ry = fabsf(relPos.y - startPos.y) / 2;
+        float cs = cosf(CanvasLogic::shapeRotation), sn = sinf(CanvasLogic::shapeRotation);
+        ImVec2* p = strokes.MutablePoints(i);
+        p[0] = c;
+        p[1] = {c.x + rx * cs, c.y + rx * sn};
+        p[2] = {c.x - ry * sn, c.y + ry * cs};
+        strokes.MarkDirty(i);
+        StrokeIndex::Insert(strokes.View(i));
     }
-    if (isDrawing && ImGui::IsMouseReleased(0)) {
-        // std::cout << "released" << std::endl;
-        Stroke& s = strokes.back();
-        s.points.clear();
-        std::vector<ImVec2> des;
-        des.push_back(startPos);
-        des.push_back({relPos.x, startPos.y});
-        des.push_back(relPos);
-        des.push_back({startPos.x, relPos.y});
-        des.push_back(startPos);
-        // s.points.push_back(startPos);
-        const int SPLIT = 5;
-        for (int k = 1; k < 5; k++) {
-            ImVec2 lst = des[k - 1];
-            ImVec2 cur = des[k];
-            for (int i = 0; i < SPLIT; i++) {
-                ImVec2 mid = {
-                    ((SPLIT - i) * lst.x + i * cur.x) / SPLIT,
-                    ((SPLIT - i) * lst.y + i * cur.y) / SPLIT
-                };
-                s.points.push_back(mid);
-            }
-        }
-        s.points.push_back(startPos);
+}
 
-    }
+void CanvasLogic::ProcessRectangle(StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing) {
+    PROFILE_SCOPE("CanvasLogic::ProcessRectangle");
+    DragShape(StrokeShape::Rect, strokes, relPos, startPos, color, size, isDrawing);
 }
 
-// #include <iostream>
-void CanvasLogic::ProcessCircle(std::vector<Stroke>& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing) {
-    if (ImGui::IsMouseClicked(0)) {
-        isDrawing = true;
-        startPos = relPos;
-        std::vector<ImVec2> pts(360, relPos);
-        strokes.push_back(Stroke(pts, color, size, DEFAULT_BRUSH));
+void CanvasLogic::ProcessCircle(StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing) {
+    PROFILE_SCOPE("CanvasLogic::ProcessCircle");
+    DragShape(StrokeShape::Ellipse, strokes, relPos, startPos, color, size, isDrawing);
+}
+
+// 两个橡皮擦都先查网格拿到命中的线段（按 id 排好序），没命中就不碰 strokes。
+// 矩形和椭圆用 ShapeDistance 精确判断，只有真的被擦掉一部分时才展开成折线再切
+static const float SHAPE_SLACK = 1.0f;
+void CanvasLogic::ProcessStrokeEraser(StrokeStore& strokes, ImVec2 relPos, float eraserSize) {
+    PROFILE_SCOPE("CanvasLogic::ProcessStrokeEraser");
+    static std::vector<StrokeIndex::Entry> hits;
+    static std::vector<std::pair<int, bool>> doomed; // (id, 折线段真的擦到了)
+    StrokeIndex::Query(relPos, eraserSize + SHAPE_SLACK, hits);
+    doomed.clear();
+    for (const auto& e : hits) {
+        // 图形在网格里是展开的弦，比曲线略靠里，放宽 SHAPE_SLACK 先圈进来，下面再按精确距离判
+        float r = eraserSize + e.thickness, d2 = SegmentDistanceSq(relPos, e.a, e.b);
+        if (d2 >= (r + SHAPE_SLACK) * (r + SHAPE_SLACK)) continue;
+        if (doomed.empty() || doomed.back().first != e.id) doomed.push_back({e.id, false});
+        doomed.back().second |= d2 < r * r;
     }
-    if (isDrawing && ImGui::IsMouseDown(0)) {
-        Stroke& s = strokes.back();
-        ImVec2 origin((relPos.x + startPos.x) / 2, (relPos.y + startPos.y) / 2);
-        float radiusX = abs(relPos.x - startPos.x) / 2;
-        float radiusY = abs(relPos.y - startPos.y) / 2;
-        for (int i = 0; i < 360; i++) {
-            s.points[i] = {
-                float(origin.x + radiusX * cos(i / 360.0 * 2.0 * 3.1415926)),
-                float(origin.y + radiusY * sin(i / 360.0 * 2.0 * 3.1415926))
-            };
-        }
-        // std::cout << "Drawing" << std::endl;
+    if (doomed.empty()) return;
+
+    // 只扫 id 这一列找下标
+    static std::vector<uint32_t> removed;
+    removed.clear();
+    for (size_t i = 0; i < strokes.size(); i++) {
+        auto it = std::lower_bound(doomed.begin(), doomed.end(), std::make_pair(strokes.id[i], false));
+        if (it == doomed.end() || it->first != strokes.id[i]) continue;
+        StrokeView view = strokes.View(i);
+        bool whole = view.shape != StrokeShape::Path && view.range.Whole(); // 切过的椭圆只剩一段弧，按折线判断
+        bool hit = whole ? ShapeDistance(view, relPos) < eraserSize + view.thickness : it->second;
+        if (!hit) continue;
+        if (onRemove) onRemove(strokes, i);
+        StrokeIndex::Remove(strokes.View(i));
+        removed.push_back((uint32_t)i);
     }
-    if (isDrawing && ImGui::IsMouseReleased(0)) {
-        Stroke& s = strokes.back();
-        s.points = densify(s.points, 2);
+    strokes.Remove(removed);
+}
+
+// 线段 a→b 落在圆内的参数区间 [t0, t1]；不相交或只擦到一点点（< 0.01 像素）返回 false
+static bool ClipSegment(ImVec2 a, ImVec2 b, ImVec2 c, float r, float& t0, float& t1) {
+    float dx = b.x - a.x, dy = b.y - a.y, fx = a.x - c.x, fy = a.y - c.y;
+    float A = dx * dx + dy * dy, B = fx * dx + fy * dy, C = fx * fx + fy * fy - r * r;
+    if (A <= 0.0f) {
+        t0 = 0.0f;
+        t1 = 1.0f;
+        return C <= 0.0f;
     }
+    float disc = B * B - A * C;
+    if (disc <= 0.0f) return false;
+    float sq = sqrtf(disc);
+    t0 = std::max(0.0f, (-B - sq) / A);
+    t1 = std::min(1.0f, (-B + sq) / A);
+    return (t1 - t0) * sqrtf(A) > 0.01f;
+}
+
+static ImVec2 LerpPoint(ImVec2 a, ImVec2 b, float t) {
+    return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t};
 }
 
+// 擦剩下的一截：从第 sa 段的 ta 到第 sb 段的 tb。端点正好落在顶点上的挪到相邻段，空的返回 false
+struct ErasePiece {
+    int sa, sb;
+    float ta, tb;
+    bool Normalize(const ImVec2* pts) {
+        if (ta >= 1.0f) { sa++; ta = 0.0f; }
+        if (tb <= 0.0f) { sb--; tb = 1.0f; }
+        if (sa > sb) return false;
+        if (sa < sb) return true;
+        return (tb - ta) * CanvasLogic::GetDistance(pts[sa], pts[sa + 1]) > 0.01f;
+    }
+};
 
-void CanvasLogic::ProcessStrokeEraser(std::vector<Stroke>& strokes, ImVec2 relPos, float eraserSize) {
-    strokes.erase(std::remove_if(strokes.begin(), strokes.end(), [&](const Stroke& s) {
-                    for (const auto& p : s.points) {
-                        if (GetDistance(p, relPos) < eraserSize + s.thickness) return true;
-                    }
-                    return false;
-                }), strokes.end());
+// 折线切下的一截从切点起算，phase 是第一个印章离切点的距离
+static void PiecePhase(const StrokeView& s, int seg, float t, uint32_t& index, float& phase) {
+    float cut = t * CanvasLogic::GetDistance(s.points[seg], s.points[seg + 1]);
+    StampPhaseAt(s, seg, cut, index, phase);
+    phase -= cut;
 }
 
-void CanvasLogic::ProcessPreciseEraser(std::vector<Stroke>& strokes, ImVec2 relPos, float eraserSize) {
-    std::vector<Stroke> next;
-    for (const auto& s : strokes) {
-        std::vector<ImVec2> seg;
-        for (const auto& p : s.points) {
-            if (GetDistance(p, relPos) <= eraserSize + s.thickness) {
-                if (seg.size() >= 2) next.push_back({seg, s.color, s.thickness, s.brushName});
-                seg.clear();
-            } else {
-                seg.push_back(p);
-            }
+// 样条、椭圆切下的一截：拷出用到的控制点（样条第 k 段要用 points[k-1..k+2]，椭圆就是那 3 个），
+// 记成原曲线第 sa 段弧长 da 到第 sb 段 db，每段的细分和印章位置跟着控制点走，和原来完全一样
+static Stroke CurvePiece(const StrokeView& s, int sa, float da, int sb, float db) {
+    int base = s.spline ? std::max(sa - 1, 0) : 0, end = s.spline ? std::min(sb + 3, s.count) : s.count;
+    Stroke piece(std::vector<ImVec2>(s.points + base, s.points + end), s.color, s.thickness, s.brush);
+    piece.spline = s.spline;
+    piece.shape = s.shape;
+    piece.seed = s.seed;
+    piece.range = {sa - base, sb - base, da, db};
+    StampPhaseAt(s, sa, da, piece.stampBase, piece.phase);
+    return piece;
+}
+
+// 只处理和橡皮擦圆相交的笔画，在圆上精确切开：
+// 第一截原地改写（点数组就地挪、不重新分配），其余几截才新建 Stroke 插在它后面；
+// 每截沿用原笔画的种子、接上原来的印章序号和位置，剩下的印章不会重新随机
+void CanvasLogic::ProcessPreciseEraser(StrokeStore& strokes, ImVec2 relPos, float eraserSize) {
+    PROFILE_SCOPE("CanvasLogic::ProcessPreciseEraser");
+    static std::vector<StrokeIndex::Entry> hits;
+    static std::vector<int> hitIds;
+    static std::vector<ErasePiece> pieces;
+    static std::vector<ImVec2> flat;
+    static std::vector<FlatChord> chords;
+    static std::vector<uint32_t> doomed;               // 整条擦掉的下标（递增）
+    static std::vector<std::pair<size_t, Stroke>> cut; // (原笔画下标, 多出来的一截)
+    static std::vector<std::pair<int, Stroke>> extra;
+    StrokeIndex::Query(relPos, eraserSize, hits);
+    if (hits.empty()) return;
+    hitIds.clear();
+    for (const auto& e : hits)
+        if (hitIds.empty() || hitIds.back() != e.id) hitIds.push_back(e.id);
+    doomed.clear();
+    cut.clear();
+
+    for (size_t i = 0; i < strokes.size(); i++) {
+        if (!std::binary_search(hitIds.begin(), hitIds.end(), strokes.id[i])) continue;
+        int sid = strokes.id[i];
+        auto lo = std::lower_bound(hits.begin(), hits.end(), sid, [](const StrokeIndex::Entry& e, int id) { return e.id < id; });
+
+        // 命中的线段按段号排好了，圆是凸的，每段最多一个擦除区间；索引里样条已经是展开后的折线
+        float r = eraserSize + strokes.thickness[i];
+        pieces.clear();
+        ErasePiece cur = {0, 0, 0.0f, 1.0f};
+        bool touched = false;
+        for (auto it = lo; it != hits.end() && it->id == sid; ++it) {
+            float t0, t1;
+            if (!ClipSegment(it->a, it->b, relPos, r, t0, t1)) continue;
+            touched = true;
+            cur.sb = it->seg;
+            cur.tb = t0;
+            pieces.push_back(cur);
+            cur = {it->seg, 0, t1, 1.0f};
+        }
+        if (!touched) continue;
+        bool closed = strokes.shape[i] != StrokeShape::Path && strokes.range[i].Whole();
+        if (closed && ShapeDistance(strokes.View(i), relPos) >= r) continue;
+        pieces.push_back(cur);
+
+        if (onRemove) onRemove(strokes, i);
+        StrokeIndex::Remove(strokes.View(i));
+        // 矩形的边本来就是直的，展开成折线再切；样条和椭圆不展开，每截记成原曲线上的一段弧，
+        // 索引里的折线段号换算回 (段号, 弧长)。闭合的椭圆擦一处之后从接缝处断成两截，头上那截的序号不变
+        bool curved = strokes.spline[i] || strokes.shape[i] == StrokeShape::Ellipse;
+        if (curved) {
+            FlattenStroke(strokes.View(i), flat, &chords);
+        } else if (!strokes.View(i).Flat()) {
+            FlattenStroke(strokes.View(i), flat);
+            strokes.SetPoints(i, flat.data(), (int)flat.size());
+            strokes.shape[i] = StrokeShape::Path;
         }
-        if (seg.size() >= 2) next.push_back({seg, s.color, s.thickness, s.brushName});
+        const ImVec2* pts = curved ? flat.data() : strokes.Points(i);
+        int n = curved ? (int)flat.size() : strokes.Count(i);
+        pieces.back().sb = n - 2;    // 最后一截到终点为止
+        if (n < 2) pieces.clear();   // 单点笔画被擦到就整条删掉
+        pieces.erase(std::remove_if(pieces.begin(), pieces.end(), [&](ErasePiece& p) { return !p.Normalize(pts); }), pieces.end());
+        if (pieces.empty()) {
+            doomed.push_back((uint32_t)i);
+            continue;
+        }
+
+        if (curved) {
+            StrokeView view = strokes.View(i);
+            auto arc = [&](const ErasePiece& p) {
+                const FlatChord &a = chords[p.sa], &b = chords[p.sb];
+                return CurvePiece(view, a.seg, a.d0 + (a.d1 - a.d0) * p.ta, b.seg, b.d0 + (b.d1 - b.d0) * p.tb);
+            };
+            for (size_t k = 1; k < pieces.size(); k++) cut.push_back({i, arc(pieces[k])});
+            Stroke first = arc(pieces[0]);
+            strokes.SetPoints(i, first.points.data(), (int)first.points.size());
+            strokes.range[i] = first.range;
+            strokes.stampBase[i] = first.stampBase;
+            strokes.phase[i] = first.phase;
+            strokes.id[i] = first.id;
+            StrokeIndex::Insert(strokes.View(i));
+            continue;
+        }
+
+        // 先拷出第二截以后的，再把第一截原地写回：两端的切点正好落在 pts[sa] 和 pts[sb+1] 上，只改这两个点和区间
+        StrokeView view = strokes.View(i);
+        for (size_t k = 1; k < pieces.size(); k++) {
+            const ErasePiece& p = pieces[k];
+            std::vector<ImVec2> piecePts;
+            piecePts.reserve(p.sb - p.sa + 2);
+            piecePts.push_back(LerpPoint(pts[p.sa], pts[p.sa + 1], p.ta));
+            piecePts.insert(piecePts.end(), pts + p.sa + 1, pts + p.sb + 1);
+            piecePts.push_back(LerpPoint(pts[p.sb], pts[p.sb + 1], p.tb));
+            Stroke piece(std::move(piecePts), view.color, view.thickness, view.brush);
+            piece.seed = view.seed;
+            PiecePhase(view, p.sa, p.ta, piece.stampBase, piece.phase);
+            cut.push_back({i, std::move(piece)});
+        }
+        const ErasePiece& p = pieces[0];
+        PiecePhase(view, p.sa, p.ta, strokes.stampBase[i], strokes.phase[i]);
+        ImVec2* w = strokes.MutablePoints(i);
+        ImVec2 first = LerpPoint(w[p.sa], w[p.sa + 1], p.ta);
+        ImVec2 last = LerpPoint(w[p.sb], w[p.sb + 1], p.tb);
+        w[p.sa] = first;
+        w[p.sb + 1] = last;
+        strokes.Trim(i, p.sa, p.sb - p.sa + 2);
+        strokes.id[i] = count++; // 换 id，撤销记录按 id 对比时才会把它当成删旧加新
+        StrokeIndex::Insert(strokes.View(i));
     }
-    strokes = std::move(next);
-}
+
+    // 整条擦掉的删掉；多出来的几截插到各自原笔画后面，下标按删完、插完之后算
+    strokes.Remove(doomed);
+    if (cut.empty()) return;
+    extra.clear();
+    for (size_t k = 0; k < cut.size(); k++) {
+        size_t i = cut[k].first;
+        size_t before = std::lower_bound(doomed.begin(), doomed.end(), (uint32_t)i) - doomed.begin();
+        extra.push_back({(int)(i + 1 - before + k), std::move(cut[k].second)});
+        StrokeIndex::Insert(extra.back().second.View());
+    }
+    strokes.Insert(extra);
+}
\ No newline at end of file
@@ -1,13 +1,31 @@
 #pragma once
 #include "Common.h"
+#include "StrokeStore.h"
 #include <string>
 
 class CanvasLogic {
 public:
+    static void (*onRemove)(const StrokeStore& strokes, size_t i); // 橡皮擦删掉/改动第 i 笔之前回调（撤销记录用），可以为空
+
+    // 画笔松开时用 RDP 把点简化到误差 fitTolerance 像素以内，存成样条控制点；0 表示不简化
+    static float fitTolerance;
+    static size_t fitPointsIn, fitPointsOut; // 累计简化前后的点数
+    static void SimplifyRDP(const ImVec2* in, int n, float tolerance, std::vector<ImVec2>& out);
+    static void FitStroke(StrokeStore& strokes, size_t i);
+
+    static float shapeRotation; // 矩形/椭圆工具的旋转角（弧度），拖出来的框是旋转前的半轴
+
     static float GetDistance(ImVec2 p1, ImVec2 p2);
-    static void ProcessBrush(std::vector<Stroke>& strokes, ImVec2 relPos, ImU32 color, float size, bool& isDrawing, std::string brushName);
-    static void ProcessRectangle(std::vector<Stroke>& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing);
-    static void ProcessCircle(std::vector<Stroke>& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing);
-    static void ProcessStrokeEraser(std::vector<Stroke>& strokes, ImVec2 relPos, float eraserSize);
-    static void ProcessPreciseEraser(std::vector<Stroke>& strokes, ImVec2 relPos, float eraserSize);
+    static float GetDistanceSq(ImVec2 p1, ImVec2 p2);
+    static float SegmentDistanceSq(ImVec2 p, ImVec2 a, ImVec2 b);
+    // 按当前工具分发一帧的鼠标输入；AppUI 和 ReplayBench 共用。
+    // samples 是上一帧以来按着左键时的光标采样（画布坐标，按时间顺序），画笔和橡皮擦先依次处理它们再处理 relPos
+    static void Process(Tool tool, StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing, int brush,
+                        const ImVec2* samples = nullptr, int sampleCount = 0);
+    static void ProcessBrush(StrokeStore& strokes, ImVec2 relPos, ImU32 color, float size, bool& isDrawing, int brush,
+                             const ImVec2* samples = nullptr, int sampleCount = 0);
+    static void ProcessRectangle(StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing);
+    static void ProcessCircle(StrokeStore& strokes, ImVec2 relPos, ImVec2& startPos, ImU32 color, float size, bool& isDrawing);
+    static void ProcessStrokeEraser(StrokeStore& strokes, ImVec2 relPos, float eraserSize);
+    static void ProcessPreciseEraser(StrokeStore& strokes, ImVec2 relPos, float eraserSize);
 };
\ No newline at end of file
@@ -1,4 +1,18 @@
 #include "Common.h"
+#include "BrushRegistry.h"
+#include "CanvasLogic.h"
+#include "StrokeStore.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STAMP_USE_SSE 1
+#include <emmintrin.h>
+#endif
     
 void DrawStroke(ImDrawList* dl, const Stroke& s, ImVec2 p0) {
     return ;
@@ -42,4 +56,598 @@ ImVec2 InterpolateCatmullRom(ImVec2 p0, ImVec2 p1, ImVec2 p2, ImVec2 p3, float t
         0.5f * ((2.0f * p1.x) + (-p0.x + p2.x) * t + (2.0f * p0.x - 5.0f * p1.x + 4.0f * p2.x - p3.x) * t2 + (-p0.x + 3.0f * p1.x - 3.0f * p2.x + p3.x) * t3),
         0.5f * ((2.0f * p1.y) + (-p0.y + p2.y) * t + (2.0f * p0.y - 5.0f * p1.y + 4.0f * p2.y - p3.y) * t2 + (-p0.y + 3.0f * p1.y - 3.0f * p2.y + p3.y) * t3)
     );
+}
+
+// ---------------- 样条 ----------------
+// 端点处缺的邻居用端点自己代替
+ImVec2 SplinePoint(const StrokeView& s, int seg, float t) {
+    int last = s.count - 1;
+    ImVec2 p0 = s.points[std::max(seg - 1, 0)];
+    ImVec2 p3 = s.points[std::min(seg + 2, last)];
+    return InterpolateCatmullRom(p0, s.points[seg], s.points[seg + 1], p3, t);
+}
+
+// ---------------- 参数化图形 ----------------
+// 控制点换成正交的半轴：v 只取长度，方向转到 u 的法向（u 退化成 0 时沿用 v 原来的方向）
+static void ShapeAxes(const StrokeView& s, ImVec2& c, ImVec2& u, ImVec2& v) {
+    c = s.points[0];
+    u = {s.points[1].x - c.x, s.points[1].y - c.y};
+    v = {s.points[2].x - c.x, s.points[2].y - c.y};
+    float lu = sqrtf(u.x * u.x + u.y * u.y);
+    if (lu < 1e-6f) return;
+    float lv = sqrtf(v.x * v.x + v.y * v.y);
+    v = {-u.y / lu * lv, u.x / lu * lv};
+}
+
+// 矩形第 k 个角：(-u-v) (u-v) (u+v) (-u+v)
+static ImVec2 RectCorner(ImVec2 c, ImVec2 u, ImVec2 v, int k) {
+    float su = (k == 1 || k == 2) ? 1.0f : -1.0f, sv = k >= 2 ? 1.0f : -1.0f;
+    return {c.x + u.x * su + v.x * sv, c.y + u.y * su + v.y * sv};
+}
+
+int StrokeSegments(const StrokeView& s) {
+    if (s.shape != StrokeShape::Path) return s.count >= 3 ? 4 : 0;
+    return s.count - 1;
+}
+
+// 直线段的两个端点（折线和矩形的边）
+static void SegmentEnds(const StrokeView& s, int seg, ImVec2& a, ImVec2& b) {
+    if (s.shape == StrokeShape::Rect) {
+        ImVec2 c, u, v;
+        ShapeAxes(s, c, u, v);
+        a = RectCorner(c, u, v, seg);
+        b = RectCorner(c, u, v, (seg + 1) % 4);
+        return;
+    }
+    a = s.points[seg];
+    b = s.points[seg + 1];
+}
+
+static inline bool CurvedSegments(const StrokeView& s) {
+    return s.spline || s.shape == StrokeShape::Ellipse;
+}
+
+ImVec2 SegmentPoint(const StrokeView& s, int seg, float t) {
+    if (s.shape == StrokeShape::Ellipse) {
+        ImVec2 c, u, v;
+        ShapeAxes(s, c, u, v);
+        float angle = (seg + t) * 1.5707963f;
+        float cs = cosf(angle), sn = sinf(angle);
+        return {c.x + u.x * cs + v.x * sn, c.y + u.y * cs + v.y * sn};
+    }
+    if (s.spline) return SplinePoint(s, seg, t);
+    ImVec2 a, b;
+    SegmentEnds(s, seg, a, b);
+    return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t};
+}
+
+// 第 seg 段的起点；seg 可以等于段数，这时是终点（闭合图形绕回起点）
+static ImVec2 SegmentStart(const StrokeView& s, int seg) {
+    if (s.shape == StrokeShape::Path) return s.points[seg];
+    return SegmentPoint(s, seg % 4, 0.0f);
+}
+
+// 大约每 3 像素一个细分点，弧长表和橡皮擦用的折线都按这个细分
+int SegmentSubdivisions(const StrokeView& s, int seg) {
+    const int MAX_SUBDIVISIONS = 64;
+    float chord = CanvasLogic::GetDistance(SegmentStart(s, seg), SegmentStart(s, seg + 1));
+    // 四分之一椭圆的弧长最多是弦长的 pi / (2 sqrt 2) 倍，多给一点
+    if (s.shape == StrokeShape::Ellipse) chord *= 1.12f;
+    return std::clamp((int)ceilf(chord / 3.0f), 1, MAX_SUBDIVISIONS);
+}
+
+// 曲线段的细分点和累计弧长，返回细分数；印章、碎片切点和展开的折线共用，保证算出的长度一致
+static int CurveSamples(const StrokeView& s, int seg, ImVec2* pts, float* acc) {
+    int n = SegmentSubdivisions(s, seg);
+    pts[0] = SegmentStart(s, seg);
+    acc[0] = 0.0f;
+    for (int k = 1; k <= n; k++) {
+        pts[k] = k == n ? SegmentStart(s, seg + 1) : SegmentPoint(s, seg, (float)k / n);
+        acc[k] = acc[k - 1] + CanvasLogic::GetDistance(pts[k - 1], pts[k]);
+    }
+    return n;
+}
+
+// 在弧长表里找到 d 所在的细分段 k（顺序查找时接着上次的 k 往后找），反推参数再求曲线上的点
+static ImVec2 CurvePointAt(const StrokeView& s, int seg, const float* acc, int sub, float d, int& k) {
+    while (k + 1 < sub && acc[k + 1] <= d) k++;
+    float len = acc[k + 1] - acc[k];
+    float u = len > 0.0f ? std::min(1.0f, (d - acc[k]) / len) : 0.0f;
+    return SegmentPoint(s, seg, (k + u) / sub);
+}
+
+// 曲线碎片只画 [range.first, range.last] 这几段
+static inline bool SegmentInRange(const StrokeView& s, int seg) {
+    return s.range.Whole() || (seg >= s.range.first && seg <= s.range.last);
+}
+
+// 第 seg 段（整段长 len）实际要画的区间 [lo, hi]
+static inline void SegmentExtent(const StrokeView& s, int seg, float len, float& lo, float& hi) {
+    lo = seg == s.range.first ? s.range.start : 0.0f;
+    hi = !s.range.Whole() && seg == s.range.last ? s.range.end : len;
+}
+
+void FlattenStroke(const StrokeView& s, std::vector<ImVec2>& out, std::vector<FlatChord>* chords) {
+    if (chords) chords->clear();
+    if (s.Flat() || s.count < 2) {
+        out.assign(s.points, s.points + s.count);
+        for (int i = 0; chords && i + 1 < s.count; i++) chords->push_back({i, 0.0f, CanvasLogic::GetDistance(s.points[i], s.points[i + 1])});
+        return;
+    }
+    out.clear();
+    int segs = StrokeSegments(s);
+    if (!CurvedSegments(s)) {
+        out.push_back(SegmentStart(s, 0));
+        for (int i = 0; i < segs; i++) {
+            out.push_back(SegmentStart(s, i + 1));
+            if (chords) chords->push_back({i, 0.0f, CanvasLogic::GetDistance(out[i], out[i + 1])});
+        }
+        return;
+    }
+    ImVec2 pts[65];
+    float acc[65];
+    for (int i = 0; i < segs; i++) {
+        if (!SegmentInRange(s, i)) continue;
+        int sub = CurveSamples(s, i, pts, acc), k = 0;
+        float lo, hi;
+        SegmentExtent(s, i, acc[sub], lo, hi);
+        // 上一段的终点就是这一段的起点，只有第一段要补起点
+        if (out.empty()) out.push_back(lo > 0.0f ? CurvePointAt(s, i, acc, sub, lo, k) : pts[0]);
+        float prev = lo;
+        for (int j = 1; j <= sub; j++) {
+            if (acc[j] <= lo && j < sub) continue;
+            bool end = acc[j] >= hi || j == sub;
+            out.push_back(end && hi != acc[j] ? CurvePointAt(s, i, acc, sub, hi, k) : pts[j]);
+            float d = end ? hi : acc[j];
+            if (chords) chords->push_back({i, prev, d});
+            prev = d;
+            if (end) break;
+        }
+    }
+}
+
+// 轴对齐椭圆 (x/a)^2 + (y/b)^2 = 1（a >= b）上离第一象限的点 (x, y) 最近的点：
+// 按 Eberly 的做法对一元方程二分求根，不用迭代近似曲线
+static float EllipseDistance(float a, float b, float x, float y) {
+    if (b < 1e-6f) { // 退化成线段
+        float dx = std::max(x - a, 0.0f);
+        return sqrtf(dx * dx + y * y);
+    }
+    if (y > 0.0f) {
+        if (x <= 0.0f) return fabsf(y - b);
+        double z0 = x / a, z1 = y / b, g = z0 * z0 + z1 * z1 - 1.0;
+        if (g == 0.0) return 0.0f;
+        double r0 = (double)(a / b) * (a / b), n0 = r0 * z0;
+        double s0 = z1 - 1.0, s1 = g < 0.0 ? 0.0 : sqrt(n0 * n0 + z1 * z1) - 1.0, sm = 0.0;
+        for (int it = 0; it < 64; it++) {
+            sm = (s0 + s1) * 0.5;
+            if (sm == s0 || sm == s1) break;
+            double q0 = n0 / (sm + r0), q1 = z1 / (sm + 1.0);
+            double gm = q0 * q0 + q1 * q1 - 1.0;
+            if (gm > 0.0) s0 = sm;
+            else if (gm < 0.0) s1 = sm;
+            else break;
+        }
+        double ex = r0 * x / (sm + r0) - x, ey = y / (sm + 1.0) - y;
+        return (float)sqrt(ex * ex + ey * ey);
+    }
+    double numer = (double)a * x, denom = (double)a * a - (double)b * b;
+    if (numer < denom) {
+        double xd = numer / denom, ex = a * xd - x, ey = b * sqrt(std::max(0.0, 1.0 - xd * xd));
+        return (float)sqrt(ex * ex + ey * ey);
+    }
+    return fabsf(x - a);
+}
+
+float ShapeDistance(const StrokeView& s, ImVec2 p) {
+    ImVec2 c, u, v;
+    ShapeAxes(s, c, u, v);
+    float a = sqrtf(u.x * u.x + u.y * u.y), b = sqrtf(v.x * v.x + v.y * v.y);
+    // 换到半轴坐标系，再利用对称性折到第一象限
+    float dx = p.x - c.x, dy = p.y - c.y;
+    float x = a > 1e-6f ? fabsf((dx * u.x + dy * u.y) / a) : 0.0f;
+    float y = b > 1e-6f ? fabsf((dx * v.x + dy * v.y) / b) : 0.0f;
+    if (a < 1e-6f && b < 1e-6f) return sqrtf(dx * dx + dy * dy);
+    if (a < 1e-6f) x = fabsf(dx * v.y - dy * v.x) / b; // 只剩 v 方向时 u 方向是它的法向
+    if (b < 1e-6f) y = fabsf(dx * u.y - dy * u.x) / a;
+    if (s.shape == StrokeShape::Rect) {
+        float ox = x - a, oy = y - b;
+        if (ox <= 0.0f && oy <= 0.0f) return -std::max(ox, oy); // 在里面：到最近一条边
+        ox = std::max(ox, 0.0f);
+        oy = std::max(oy, 0.0f);
+        return sqrtf(ox * ox + oy * oy);
+    }
+    return a >= b ? EllipseDistance(a, b, x, y) : EllipseDistance(b, a, y, x);
+}
+
+// ---------------- 印章生成 ----------------
+// 每个印章的抖动/大小/角度只由 (笔画种子, 印章序号, 通道) 决定，和生成顺序、线程无关。
+// 每 4 个印章一批用 SSE 算随机数、sin/cos 和四个角。
+
+static inline uint32_t HashU32(uint32_t x) {
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float StampRandom(uint32_t seed, uint32_t index, uint32_t channel) {
+    uint32_t h = HashU32(seed ^ HashU32(index * 4u + channel));
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// 按 pi/2 取整做区间约简，再在 [-pi/4, pi/4] 上用 Cephes 的多项式；运算顺序和下面的 SinCos4 逐条对应，
+// 不开 FMA 收缩时两条路径的结果逐位相同（StampGenBench 检查）
+void StampSinCos(float x, float& sinOut, float& cosOut) {
+    int q = (int)lrintf(x * 0.63661977236f);
+    float j = (float)q;
+    float r = x - j * 1.5707963705062866f;
+    r = r + j * 4.37113900018624e-8f;
+    float z = r * r;
+
+    float sp = -1.9515295891e-4f * z + 8.3321608736e-3f;
+    sp = sp * z + -1.6666654611e-1f;
+    sp = sp * z * r + r;
+
+    float cp = 2.443315711809948e-5f * z + -1.388731625493765e-3f;
+    cp = cp * z + 4.166664568298827e-2f;
+    cp = (cp * z * z - 0.5f * z) + 1.0f;
+
+    float sn = (q & 1) ? cp : sp, cs = (q & 1) ? sp : cp;
+    sinOut = (q & 2) ? -sn : sn;
+    cosOut = ((q + 1) & 2) ? -cs : cs;
+}
+
+#ifdef STAMP_USE_SSE
+static inline __m128i MulLo32(__m128i a, __m128i b) {
+    // SSE2 没有 _mm_mullo_epi32，用两次 32x32->64 拼出低 32 位
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i HashU32x4(__m128i x) {
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16)); x = MulLo32(x, _mm_set1_epi32(0x7feb352d));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15)); x = MulLo32(x, _mm_set1_epi32((int)0x846ca68bu));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    return x;
+}
+
+static inline __m128 StampRandom4(uint32_t seed, __m128i index4, uint32_t channel) {
+    __m128i c = _mm_add_epi32(index4, _mm_set1_epi32((int)channel));
+    __m128i h = HashU32x4(_mm_xor_si128(_mm_set1_epi32((int)seed), HashU32x4(c)));
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+// 四个一组的 StampSinCos
+static inline void SinCos4(__m128 x, __m128& sinOut, __m128& cosOut) {
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236f)));
+    __m128 j = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(1.5707963705062866f)));
+    r = _mm_add_ps(r, _mm_mul_ps(j, _mm_set1_ps(4.37113900018624e-8f)));
+    __m128 z = _mm_mul_ps(r, r);
+
+    __m128 sp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+    sp = _mm_add_ps(_mm_mul_ps(sp, z), _mm_set1_ps(-1.6666654611e-1f));
+    sp = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sp, z), r), r);
+
+    __m128 cp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(-1.388731625493765e-3f));
+    cp = _mm_add_ps(_mm_mul_ps(cp, z), _mm_set1_ps(4.166664568298827e-2f));
+    cp = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(cp, z), z), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+
+    // 象限 q&1 交换 sin/cos，q&2 翻转 sin 的符号，(q+1)&2 翻转 cos 的符号
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sn = _mm_or_ps(_mm_and_ps(swap, cp), _mm_andnot_ps(swap, sp));
+    __m128 cs = _mm_or_ps(_mm_and_ps(swap, sp), _mm_andnot_ps(swap, cp));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    sinOut = _mm_xor_ps(sn, sinSign);
+    cosOut = _mm_xor_ps(cs, cosSign);
+}
+#endif
+
+// 把一批 n (<=4) 个印章的中心点变成 n 个实例；index 是这批第一个印章的序号
+static void FinishBatch(const StrokeView& s, const BrushProfile& bp, const float* bx, const float* by, const float* dir,
+                        int n, uint32_t index, StampInstance* out) {
+    uint32_t seed = s.seed;
+#ifdef STAMP_USE_SSE
+    __m128i idx4 = _mm_slli_epi32(_mm_add_epi32(_mm_set1_epi32((int)index), _mm_setr_epi32(0, 1, 2, 3)), 2);
+    __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+    __m128 thick = _mm_set1_ps(s.thickness);
+    // 1. 坐标抖动  2. 随机大小
+    __m128 jp = _mm_mul_ps(thick, _mm_set1_ps(bp.jitterPos));
+    __m128 px = _mm_add_ps(_mm_loadu_ps(bx), _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(StampRandom4(seed, idx4, 0), two), one), jp));
+    __m128 py = _mm_add_ps(_mm_loadu_ps(by), _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(StampRandom4(seed, idx4, 1), two), one), jp));
+    __m128 size = _mm_mul_ps(thick, _mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(StampRandom4(seed, idx4, 2), two), one), _mm_set1_ps(bp.jitterSize))));
+    // 3. 旋转：随机角度，或者跟随笔画方向
+    __m128 angle = bp.rotation == RotationMode::Random ? _mm_mul_ps(StampRandom4(seed, idx4, 3), _mm_set1_ps(6.2831853f)) : _mm_loadu_ps(dir);
+    __m128 sinA, cosA;
+    SinCos4(angle, sinA, cosA);
+    __m128 a = _mm_mul_ps(size, cosA), b = _mm_mul_ps(size, sinA);
+    // 4. 转成每个印章一条 (x, y, a, b)
+    _MM_TRANSPOSE4_PS(px, py, a, b);
+    alignas(16) StampInstance tmp[4];
+    _mm_store_ps(&tmp[0].x, px); _mm_store_ps(&tmp[1].x, py);
+    _mm_store_ps(&tmp[2].x, a); _mm_store_ps(&tmp[3].x, b);
+    for (int k = 0; k < n; k++) out[k] = tmp[k];
+#else
+    for (int k = 0; k < n; k++) {
+        uint32_t i = index + k;
+        float px = bx[k] + (StampRandom(seed, i, 0) * 2.0f - 1.0f) * s.thickness * bp.jitterPos;
+        float py = by[k] + (StampRandom(seed, i, 1) * 2.0f - 1.0f) * s.thickness * bp.jitterPos;
+        float size = s.thickness * (1.0f + (StampRandom(seed, i, 2) * 2.0f - 1.0f) * bp.jitterSize);
+        float angle = bp.rotation == RotationMode::Random ? StampRandom(seed, i, 3) * 6.2831853f : dir[k];
+        float sn, cs;
+        StampSinCos(angle, sn, cs);
+        out[k] = {px, py, size * cs, size * sn};
+    }
+#endif
+}
+
+// 实例展开成四边形：(-s,-s) (s,-s) (s,s) (-s,s) 旋转后平移，UV 取笔刷在图集里的矩形
+static void ExpandStamps(const StampInstance* in, size_t n, const BrushProfile& bp, ImU32 color, ImDrawVert* out) {
+    const ImVec2 uvs[4] = {bp.uvMin, {bp.uvMax.x, bp.uvMin.y}, bp.uvMax, {bp.uvMin.x, bp.uvMax.y}};
+    for (size_t k = 0; k < n; k++) {
+        const StampInstance& s = in[k];
+        const ImVec2 corners[4] = {{s.x - s.a + s.b, s.y - s.b - s.a}, {s.x + s.a + s.b, s.y + s.b - s.a},
+                                   {s.x + s.a - s.b, s.y + s.b + s.a}, {s.x - s.a - s.b, s.y - s.b + s.a}};
+        for (int c = 0; c < 4; c++) {
+            ImDrawVert& v = out[k * 4 + c];
+            v.pos = corners[c];
+            v.uv = uvs[c];
+            v.col = color;
+        }
+    }
+}
+
+static inline float StampStep(const StrokeView& s) {
+    return fmax(1.0f, s.thickness * BrushRegistry::Get(s.brush).spacing);
+}
+
+// 每段的印章数：沿线段（样条则沿弧长）每 step 放一个，d = from, from+step, ... < 长度；
+// 只有第一段的 from 是 phase，曲线碎片范围外的段没有印章
+static inline int SegmentStampCount(const StrokeView& s, int seg, float step) {
+    if (!SegmentInRange(s, seg)) return 0;
+    float dist;
+    if (CurvedSegments(s)) {
+        ImVec2 pts[65];
+        float acc[65];
+        dist = acc[CurveSamples(s, seg, pts, acc)];
+    } else {
+        ImVec2 a, b;
+        SegmentEnds(s, seg, a, b);
+        dist = CanvasLogic::GetDistance(a, b);
+    }
+    float lo, hi;
+    SegmentExtent(s, seg, dist, lo, hi);
+    float from = seg == s.range.first ? s.phase : 0.0f;
+    return hi > from ? (int)ceilf((hi - from) / step) : 0;
+}
+
+void StampPhaseAt(const StrokeView& s, int seg, float d, uint32_t& index, float& at) {
+    float step = StampStep(s);
+    index = s.stampBase;
+    for (int i = 0; i < seg; i++) index += SegmentStampCount(s, i, step);
+    float from = seg == s.range.first ? s.phase : 0.0f;
+    int k = d > from ? (int)ceilf((d - from) / step) : 0;
+    index += k;
+    at = from + k * step;
+}
+
+// 生成 [segBegin, segEnd) 这几段的印章，index 是第一个印章的全局序号
+static void EmitStamps(const StrokeView& s, const BrushProfile& bp, float step, int segBegin, int segEnd, uint32_t index, StampInstance* out) {
+    float bx[4], by[4], dir[4];
+    int n = 0;
+    for (int i = segBegin; i < segEnd; i++) {
+        if (!SegmentInRange(s, i)) continue;
+        float from = i == s.range.first ? s.phase : 0.0f;
+        if (CurvedSegments(s)) {
+            // 印章按弧长等距，和图形大小无关
+            ImVec2 pts[65];
+            float acc[65];
+            int sub = CurveSamples(s, i, pts, acc);
+            float lo, hi;
+            SegmentExtent(s, i, acc[sub], lo, hi);
+            int count = hi > from ? (int)ceilf((hi - from) / step) : 0;
+            int k = 0;
+            for (int j = 0; j < count; j++) {
+                ImVec2 p = CurvePointAt(s, i, acc, sub, from + j * step, k);
+                bx[n] = p.x;
+                by[n] = p.y;
+                dir[n] = bp.rotation == RotationMode::Random ? 0.0f : atan2f(pts[k + 1].y - pts[k].y, pts[k + 1].x - pts[k].x);
+                if (++n == 4) {
+                    FinishBatch(s, bp, bx, by, dir, 4, index, out);
+                    out += 4;
+                    index += 4;
+                    n = 0;
+                }
+            }
+            continue;
+        }
+        ImVec2 p1, p2;
+        SegmentEnds(s, i, p1, p2);
+        float dist = CanvasLogic::GetDistance(p1, p2);
+        int count = SegmentStampCount(s, i, step);
+        float angle = bp.rotation == RotationMode::Random ? 0.0f : atan2f(p2.y - p1.y, p2.x - p1.x);
+        for (int j = 0; j < count; j++) {
+            float t = (from + j * step) / dist;
+            bx[n] = p1.x + (p2.x - p1.x) * t;
+            by[n] = p1.y + (p2.y - p1.y) * t;
+            dir[n] = angle;
+            if (++n == 4) {
+                FinishBatch(s, bp, bx, by, dir, 4, index, out);
+                out += 4;
+                index += 4;
+                n = 0;
+            }
+        }
+    }
+    if (n) FinishBatch(s, bp, bx, by, dir, n, index, out);
+}
+
+// UpdateStrokeCaches 在多个线程里同时重建同一个 store 的不同笔画
+static std::mutex damageMutex;
+static void DamageLocked(const StrokeStore& store, ImVec2 bmin, ImVec2 bmax) {
+    if (bmin.x > bmax.x) return;
+    std::lock_guard<std::mutex> lock(damageMutex);
+    store.Damage(bmin, bmax);
+}
+
+void BuildStrokeCache(const StrokeStore& store, size_t i) {
+    PROFILE_SCOPE("BuildStrokeCache");
+    StrokeView s = store.View(i);
+    StrokeCache& c = store.Cache(i);
+    ImVec2& bmin = store.boundsMin[i];
+    ImVec2& bmax = store.boundsMax[i];
+    int segs = StrokeSegments(s);
+    if (c.dirty || c.generation != BrushRegistry::generation) {
+        DamageLocked(store, bmin, bmax);
+        c.stamps.clear();
+        c.vtx.clear();
+        c.segments = 0;
+        bmin = {FLT_MAX, FLT_MAX};
+        bmax = {-FLT_MAX, -FLT_MAX};
+    }
+    c.dirty = false;
+    c.generation = BrushRegistry::generation;
+    // 只在末尾追加了点（正在画的笔画）时，只补新线段的印章
+    int firstSeg = c.segments;
+    if (segs <= firstSeg) return;
+
+    const BrushProfile& bp = BrushRegistry::Get(s.brush);
+    float step = StampStep(s);
+
+    // 每段第一个印章的序号（前缀和），用来把长笔画切块并行生成
+    std::vector<int> start(segs - firstSeg + 1);
+    start[0] = (int)c.stamps.size();
+    for (int k = firstSeg; k < segs; k++)
+        start[k - firstSeg + 1] = start[k - firstSeg] + SegmentStampCount(s, k, step);
+    int oldStamps = start[0], total = start.back();
+    c.stamps.resize(total);
+
+    const int CHUNK_STAMPS = 8192;
+    std::vector<int> chunkSeg = {firstSeg};
+    for (int k = firstSeg; k < segs; k++) {
+        if (start[k - firstSeg + 1] - start[chunkSeg.back() - firstSeg] >= CHUNK_STAMPS) chunkSeg.push_back(k + 1);
+    }
+    if (chunkSeg.back() != segs) chunkSeg.push_back(segs);
+    ThreadPool::ParallelFor((int)chunkSeg.size() - 1, [&](int ci) {
+        int b = chunkSeg[ci], e = chunkSeg[ci + 1];
+        int first = start[b - firstSeg];
+        EmitStamps(s, bp, step, b, e, s.stampBase + (uint32_t)first, c.stamps.data() + first);
+    });
+
+    // 旋转后的正方形在 x、y 方向上的半宽都是 |a| + |b|
+    ImVec2 nmin = {FLT_MAX, FLT_MAX}, nmax = {-FLT_MAX, -FLT_MAX};
+    for (size_t k = oldStamps; k < c.stamps.size(); k++) {
+        const StampInstance& p = c.stamps[k];
+        float r = fabsf(p.a) + fabsf(p.b);
+        nmin.x = fminf(nmin.x, p.x - r); nmin.y = fminf(nmin.y, p.y - r);
+        nmax.x = fmaxf(nmax.x, p.x + r); nmax.y = fmaxf(nmax.y, p.y + r);
+    }
+    bmin = {fminf(bmin.x, nmin.x), fminf(bmin.y, nmin.y)};
+    bmax = {fmaxf(bmax.x, nmax.x), fmaxf(bmax.y, nmax.y)};
+    // 正在画的笔画只有新长出来的那一截算变化
+    DamageLocked(store, nmin, nmax);
+    c.segments = segs;
+}
+
+static inline bool CacheStale(const StrokeStore& store, size_t i) {
+    const StrokeCache* c = store.cache[i].get();
+    return !c || c->dirty || c->generation != BrushRegistry::generation || c->segments != StrokeSegments(store.View(i));
+}
+
+void EnsureStrokeCache(const StrokeStore& store, size_t i) {
+    if (CacheStale(store, i)) BuildStrokeCache(store, i);
+}
+
+// 顶点只在末尾追加实例后落后，补上后面那一截
+void EnsureStampVertices(const StrokeStore& store, size_t i) {
+    EnsureStrokeCache(store, i);
+    StrokeCache& c = store.Cache(i);
+    size_t done = c.vtx.size() / 4;
+    if (done == c.stamps.size()) return;
+    c.vtx.resize(c.stamps.size() * 4);
+    ExpandStamps(c.stamps.data() + done, c.stamps.size() - done, BrushRegistry::Get(store.brush[i]), store.color[i], c.vtx.data() + done * 4);
+}
+
+void UpdateStrokeCaches(const StrokeStore& store, bool vertices) {
+    PROFILE_SCOPE("UpdateStrokeCaches");
+    static std::vector<size_t> stale;
+    stale.clear();
+    for (size_t i = 0; i < store.size(); i++) {
+        if (store.length[i] >= 2 && (CacheStale(store, i) || (vertices && store.cache[i]->vtx.size() != store.cache[i]->stamps.size() * 4)))
+            stale.push_back(i);
+    }
+    // 不同笔画分给不同线程，各自写自己的缓存，最后在主线程按顺序拷进 ImDrawList
+    ThreadPool::ParallelFor((int)stale.size(), [&](int k) {
+        if (vertices) EnsureStampVertices(store, stale[k]);
+        else BuildStrokeCache(store, stale[k]);
+    });
+}
+
+void RenderStroke(ImDrawList* dl, const StrokeStore& store, size_t i, ImVec2 canvasP0, float zoom) {
+    if (store.length[i] < 2) return;
+    EnsureStampVertices(store, i);
+    const std::vector<ImDrawVert>& cacheVtx = store.Cache(i).vtx;
+    if (cacheVtx.empty()) return;
+
+    // 包围盒完全在裁剪区外就不画
+    ImVec2 clipMin = dl->GetClipRectMin(), clipMax = dl->GetClipRectMax();
+    const ImVec2& bmin = store.boundsMin[i];
+    const ImVec2& bmax = store.boundsMax[i];
+    if (bmax.x * zoom + canvasP0.x < clipMin.x || bmin.x * zoom + canvasP0.x > clipMax.x ||
+        bmax.y * zoom + canvasP0.y < clipMin.y || bmin.y * zoom + canvasP0.y > clipMax.y) return;
+
+    // 按笔刷的大小抖动估出印章边长的范围：全都小于 MIN_STAMP_PX 就整笔跳过，有可能小于时才逐个检查
+    const BrushProfile& bp = BrushRegistry::Get(store.brush[i]);
+    float sideMax = 2.0f * store.thickness[i] * (1.0f + bp.jitterSize) * zoom;
+    float sideMin = 2.0f * store.thickness[i] * (1.0f - bp.jitterSize) * zoom;
+    if (sideMax < MIN_STAMP_PX) return;
+    float minSide2 = sideMin < MIN_STAMP_PX ? MIN_STAMP_PX * MIN_STAMP_PX / (zoom * zoom) : 0.0f;
+
+    // 直接把缓存的顶点拷进 ImDrawList，分批提交，保证 16 位索引不溢出
+    const int QUADS_PER_BATCH = 4096;
+    int quadCount = (int)cacheVtx.size() / 4;
+    dl->PushTextureID((ImTextureID)(intptr_t)bp.texture);
+    for (int first = 0; first < quadCount; first += QUADS_PER_BATCH) {
+        int n = std::min(QUADS_PER_BATCH, quadCount - first);
+        dl->PrimReserve(n * 6, n * 4);
+        ImDrawVert* vtx = dl->_VtxWritePtr;
+        ImDrawIdx* idx = dl->_IdxWritePtr;
+        unsigned int base = dl->_VtxCurrentIdx;
+        const ImDrawVert* src = &cacheVtx[(size_t)first * 4];
+        if (minSide2 > 0.0f) {
+            int kept = 0;
+            for (int q = 0; q < n; q++) {
+                const ImDrawVert* s = src + q * 4;
+                float ex = s[1].pos.x - s[0].pos.x, ey = s[1].pos.y - s[0].pos.y;
+                if (ex * ex + ey * ey < minSide2) continue;
+                for (int c = 0; c < 4; c++) {
+                    vtx[kept * 4 + c] = s[c];
+                    vtx[kept * 4 + c].pos.x = s[c].pos.x * zoom + canvasP0.x;
+                    vtx[kept * 4 + c].pos.y = s[c].pos.y * zoom + canvasP0.y;
+                }
+                kept++;
+            }
+            dl->PrimUnreserve((n - kept) * 6, (n - kept) * 4);
+            n = kept;
+        } else {
+            for (int i = 0; i < n * 4; i++) {
+                vtx[i] = src[i];
+                vtx[i].pos.x = src[i].pos.x * zoom + canvasP0.x;
+                vtx[i].pos.y = src[i].pos.y * zoom + canvasP0.y;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            unsigned int b = base + i * 4;
+            idx[0] = (ImDrawIdx)b; idx[1] = (ImDrawIdx)(b + 1); idx[2] = (ImDrawIdx)(b + 2);
+            idx[3] = (ImDrawIdx)b; idx[4] = (ImDrawIdx)(b + 2); idx[5] = (ImDrawIdx)(b + 3);
+            idx += 6;
+        }
+        dl->_VtxWritePtr += n * 4;
+        dl->_IdxWritePtr += n * 6;
+        dl->_VtxCurrentIdx += n * 4;
+    }
+    dl->PopTextureID();
 }
\ No newline at end of file
@@ -4,25 +4,104 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <cstdint>
 
 enum class BrushType { Solid, Crayon, Pencil, Watercolor };
-enum class Tool { Brush, StrokeEraser, PreciseEraser, Rectangle, Circle };
+enum class Tool { Brush, StrokeEraser, PreciseEraser, Rectangle, Circle, Eyedropper, Fill };
 
-static int count = 0;
+inline int count = 0; // 各个 .cpp 共用一个计数器，id 全局唯一
+
+// 矩形和椭圆不展开成点，points 只有 3 个控制点 {c, c + u, c + v}：中心和两条半轴的端点。
+// u 的长度是第一条半轴、方向就是旋转角；v 只看长度，方向总是 u 转 90 度（量化后也保持正交）。
+// 矩形的边界是 c ± u ± v 围成的四条边，椭圆是 c + u cos t + v sin t
+enum class StrokeShape : uint8_t { Path, Rect, Ellipse };
+
+// 精确橡皮擦从样条、椭圆上切下的一截：控制点原样保留（样条前后各多留一个邻居点），只画第 first 段离段起点 start 处
+// 到第 last 段 end 处（弧长），曲线形状、每段的细分和印章位置都和原笔画一样。last < 0 表示整条
+struct CurveRange {
+    int first = 0, last = -1;
+    float start = 0.0f, end = 0.0f;
+    bool Whole() const { return last < 0; }
+};
+
+// 一条笔画的几何和样式，不持有点：points 指向 StrokeStore 的 arena 或者 Stroke::points。
+// 样条、印章生成、网格索引都只看这些字段，所以画布上的笔画和单独拿出来的 Stroke 可以共用
+struct StrokeView {
+    const ImVec2* points;
+    int count;
+    ImU32 color;
+    float thickness;
+    int brush;
+    int id;
+    bool spline;
+    uint32_t seed;
+    uint32_t stampBase;
+    float phase;
+    StrokeShape shape;
+    CurveRange range;
+    bool Flat() const { return !spline && shape == StrokeShape::Path; } // points 本身就是要画的折线
+};
+
+// 单独的一条笔画（自己持有点）：撤销记录、文档加载、橡皮擦切出的碎片用它搬运，
+// 画布上正在用的笔画都在 StrokeStore 里
 struct Stroke {
     std::vector<ImVec2> points;
     ImU32 color;
     float thickness;
-    std::string brushName; // 改为存储名字，不再用枚举
+    int brush;             // BrushRegistry 里的笔刷 id，不再存名字
     int id;
+    bool spline = false;   // true 时 points 是松开鼠标时拟合出的 Catmull-Rom 控制点，曲线经过每个点
+    StrokeShape shape = StrokeShape::Path;
+    // 印章随机数的种子和第一个印章的序号，第一段（曲线碎片是第 range.first 段）从离段起点 phase 处开始放印章。
+    // 新笔画是 (id, 0, 0)；精确橡皮擦切出的碎片沿用原笔画的种子并接上原来的序号和位置，擦完剩下的印章不会变
+    uint32_t seed;
+    uint32_t stampBase = 0;
+    float phase = 0.0f;
+    CurveRange range;
 
-    Stroke(std::vector<ImVec2> p, ImU32 c, float t, std::string name) 
-        : points(p), color(c), thickness(t), brushName(name) {id = count++;}
+    Stroke(std::vector<ImVec2> p, ImU32 c, float t, int b) 
+        : points(p), color(c), thickness(t), brush(b) {id = count++; seed = (uint32_t)id;}
+    StrokeView View() const {
+        return {points.data(), (int)points.size(), color, thickness, brush, id, spline, seed, stampBase, phase, shape, range};
+    }
 };
 
-const int CANVAS_W = 1030; // 1280 - 250
+class StrokeStore;
+
+const int CANVAS_W = 1030; // 画布窗口（视口）的大小：1280 - 250
 const int CANVAS_H = 720;
+// 画布（文档）本身的大小，新建 / 打开文档时改；底图按瓦片稀疏分配，所以可以比窗口大得多
+inline int canvasW = CANVAS_W, canvasH = CANVAS_H;
+const int MAX_CANVAS = 65536;
 
 // void DrawStroke(ImDrawList* dl, const Stroke& s, ImVec2 p0);
 ImVec2 InterpolateCatmullRom(ImVec2 p0, ImVec2 p1, ImVec2 p2, ImVec2 p3, float t);
-void RenderStroke(ImDrawList* dl, const Stroke& s, ImVec2 canvasP0);
\ No newline at end of file
+float StampRandom(uint32_t seed, uint32_t index, uint32_t channel); // [0, 1)
+void StampSinCos(float x, float& sinOut, float& cosOut);           // 印章旋转用，SSE 和标量路径共用一个多项式
+// 样条笔画第 seg 段（points[seg] 到 points[seg+1]）在 t ∈ [0,1] 处的点
+ImVec2 SplinePoint(const StrokeView& s, int seg, float t);
+// 印章和渲染缓存按段生成：折线和样条是 count - 1 段，矩形是 4 条边，椭圆是 4 个象限
+int StrokeSegments(const StrokeView& s);
+ImVec2 SegmentPoint(const StrokeView& s, int seg, float t);
+int SegmentSubdivisions(const StrokeView& s, int seg); // 曲线段（样条、椭圆）弧长表的细分数
+// 展开后的第 j 段折线是原笔画第 seg 段弧长 [d0, d1] 这一截
+struct FlatChord {
+    int seg;
+    float d0, d1;
+};
+// 曲线按细分点、矩形按四个角展开成折线（曲线碎片只展开 range 那一截）；折线笔画原样拷贝
+void FlattenStroke(const StrokeView& s, std::vector<ImVec2>& out, std::vector<FlatChord>* chords = nullptr);
+float ShapeDistance(const StrokeView& s, ImVec2 p); // p 到矩形/椭圆边界的精确距离
+// 从第 seg 段离段起点 d 处（曲线按弧长）切开后，后半截第一个印章的全局序号和它离段起点的距离 at（用作碎片的 stampBase / phase）
+void StampPhaseAt(const StrokeView& s, int seg, float d, uint32_t& index, float& at);
+// 渲染缓存存在 StrokeStore 的 cache / bounds 列里
+void BuildStrokeCache(const StrokeStore& store, size_t i);
+void EnsureStrokeCache(const StrokeStore& store, size_t i);
+void EnsureStampVertices(const StrokeStore& store, size_t i); // CPU 路径：缓存的实例展开成四边形顶点
+// 多线程重建所有过期的缓存；vertices 为 false 时（顶点拉取渲染）不展开顶点
+void UpdateStrokeCaches(const StrokeStore& store, bool vertices = true);
+// 边长不到这么多像素的印章不画：盖不住四分之一个像素，mip 链最后一级也只剩一个平均色，
+// 画出来几乎看不见却照样要走一遍光栅和混合（缩小的全局视图、小倍率导出里大量都是这种）
+const float MIN_STAMP_PX = 0.5f;
+// 画布坐标 p 画到屏幕上的 canvasP0 + p * zoom
+void RenderStroke(ImDrawList* dl, const StrokeStore& store, size_t i, ImVec2 canvasP0, float zoom = 1.0f);
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "Compositor.h"
+#include "Layers.h"
+#include "Renderer.h"
+#include "TileCanvas.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+size_t Compositor::budget = (size_t)256 << 20;
+int Compositor::tilesComposed = 0;
+int Compositor::tilesDrawn = 0;
+bool Compositor::pending = false;
+
+static const int TILE = TileCanvas::TILE;
+static const int CLEAN = INT_MAX;
+static const int FRESH_PER_FRAME = 32; // 第一次显示的瓦片每帧最多合成这么多，缩小看全图时不会卡一下
+static const int MAX_SCALE = 8;        // 放大时有未烘焙笔画的瓦片按屏幕分辨率合成，最多每个画布像素 8x8 个纹素（2048 边长）
+
+struct CompositeTile {
+    GLuint full = 0;   // 所有可见图层
+    GLuint below = 0;  // 当前层以下的可见图层，第一次在当前层往上增量重叠时才建
+    int belowFor = -1; // below 是按哪个当前层合成的，-1 表示无效
+    int dirtyFrom = 0; // 这一层及以上要重新叠，CLEAN 表示不用
+    int scale = 1;     // 两张纹理每个画布像素占 scale x scale 个纹素
+    uint64_t lastUsed = 0;
+};
+
+static std::unordered_map<uint32_t, CompositeTile> cache; // key = ty * TilesX + tx
+static size_t textureBytes = 0;
+static uint64_t frame = 1;
+static int freshThisFrame = 0;
+static GLuint scratch = 0; // 有未烘焙笔画的图层先在这里画成一张，再叠上去
+static int scratchScale = 0;
+static ImDrawList* list = nullptr;
+static ImDrawList* scratchList = nullptr;
+
+static uint32_t Key(int tx, int ty) {
+    return (uint32_t)ty * TileCanvas::TilesX() + tx;
+}
+
+static bool UseGL() {
+    return Renderer::backend == BakeBackend::OpenGL;
+}
+
+static GLuint NewTexture(int scale) {
+    textureBytes += TileCanvas::TILE_BYTES * scale * scale;
+    return Renderer::CreateTexture(TILE * scale, TILE * scale, nullptr);
+}
+
+static void DropTile(CompositeTile& t) {
+    for (GLuint* tex : {&t.full, &t.below}) {
+        if (!*tex) continue;
+        glDeleteTextures(1, tex);
+        *tex = 0;
+        textureBytes -= TileCanvas::TILE_BYTES * t.scale * t.scale;
+    }
+    t.belowFor = -1;
+}
+
+// 缩放 zoom 下合成用的分辨率：取不小于 zoom 的 2 的幂，缩放连续变化时不用每帧重合成
+static int ScaleFor(float zoom) {
+    int s = 1;
+    while (s < zoom && s < MAX_SCALE) s *= 2;
+    return s;
+}
+
+static void Attach(GLuint tex) {
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer::fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+}
+
+// ---------------- 混合 ----------------
+// 颜色都是预乘的，目标是不透明的白纸（alpha 一直是 1），几种模式都能用固定管线的混合因子表示
+static void SetBlend(const ImDrawList*, const ImDrawCmd* cmd) {
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    switch ((BlendMode)(intptr_t)cmd->UserCallbackData) {
+    case BlendMode::Multiply: glBlendFuncSeparate(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+    case BlendMode::Screen: glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_COLOR, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+    case BlendMode::Add: glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+    default: glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+    }
+}
+
+// 原样拷贝
+static void SetCopy(const ImDrawList*, const ImDrawCmd*) {
+    glDisable(GL_BLEND);
+}
+
+// 预乘的颜色乘上不透明度，四个通道一起乘
+static ImU32 OpacityTint(float opacity) {
+    int o = (int)(opacity * 255.0f + 0.5f);
+    return IM_COL32(o, o, o, o);
+}
+
+// 整块瓦片纹理铺到 origin 处；纹理自下而上，v 要翻过来
+static void AddTile(ImDrawList* dl, GLuint tex, ImVec2 origin, ImU32 tint) {
+    dl->AddImage((ImTextureID)(intptr_t)tex, origin, {origin.x + TILE, origin.y + TILE}, {0, 1}, {1, 0}, tint);
+}
+
+// ---------------- 合成 ----------------
+// 包围盒碰到 [a, b] 的未烘焙笔画
+static bool HasLive(const Layer& l, ImVec2 a, ImVec2 b) {
+    const StrokeStore& s = l.strokes;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s.Count(i) < 2) continue;
+        if (s.boundsMax[i].x >= a.x && s.boundsMin[i].x <= b.x && s.boundsMax[i].y >= a.y && s.boundsMin[i].y <= b.y)
+            return true;
+    }
+    return false;
+}
+
+static void Flush(ImVec2 origin, int scale) {
+    if (list->VtxBuffer.Size > 0 || list->CmdBuffer.Size > 1) Renderer::RenderTile(list, origin, 0, scale);
+    Renderer::BeginTile(list, origin);
+}
+
+// 一个图层在这块瓦片上的样子：底图瓦片 base（可能没有）加上碰到的未烘焙笔画，画在透明的 scratch 上
+static void RenderLayer(const Layer& l, GLuint base, ImVec2 origin, int scale) {
+    if (scratchScale != scale) {
+        glDeleteTextures(1, &scratch);
+        scratch = Renderer::CreateTexture(TILE * scale, TILE * scale, nullptr);
+        scratchScale = scale;
+    }
+    Attach(scratch);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    Renderer::BeginTile(scratchList, origin);
+    if (base) {
+        scratchList->AddCallback(SetCopy, nullptr);
+        AddTile(scratchList, base, origin, IM_COL32_WHITE);
+        scratchList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    }
+    ImVec2 a = {origin.x - 1, origin.y - 1}, b = {origin.x + TILE + 1, origin.y + TILE + 1};
+    const StrokeStore& s = l.strokes;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s.Count(i) < 2) continue;
+        if (s.boundsMax[i].x >= a.x && s.boundsMin[i].x <= b.x && s.boundsMax[i].y >= a.y && s.boundsMin[i].y <= b.y)
+            Renderer::DrawStroke(scratchList, s, i, ImVec2(0, 0));
+    }
+    Renderer::RenderTile(scratchList, origin, 0, scale);
+}
+
+// 下标 [first, last) 的可见图层按各自的混合模式叠到 target 上；base 不为 0 时先原样拷过来，否则先铺白纸
+static void StackLayers(GLuint target, GLuint base, int first, int last, int tx, int ty, int scale) {
+    ImVec2 origin = {(float)(tx * TILE), (float)(ty * TILE)};
+    // 双线性采样可能多碰到 1 像素
+    ImVec2 a = {origin.x - 1, origin.y - 1}, b = {origin.x + TILE + 1, origin.y + TILE + 1};
+    Attach(target);
+    if (!base) {
+        glDisable(GL_SCISSOR_TEST);
+        glClearColor(1, 1, 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    Renderer::BeginTile(list, origin);
+    if (base) {
+        list->AddCallback(SetCopy, nullptr);
+        AddTile(list, base, origin, IM_COL32_WHITE);
+    }
+    for (int k = first; k < last; k++) {
+        const Layer& l = Layers::At(k);
+        if (!l.visible) continue;
+        Layers::Bind(l);
+        GLuint src = TileCanvas::Texture(tx, ty, true);
+        bool live = HasLive(l, a, b);
+        if (live) {
+            // scratch 画好之前，已经攒下的先画进 target
+            Flush(origin, scale);
+            RenderLayer(l, src, origin, scale);
+            src = scratch;
+            Attach(target);
+        }
+        if (!src) continue;
+        Compositor::AddBlend(list, l.blend);
+        AddTile(list, src, origin, OpacityTint(l.opacity));
+        if (live) Flush(origin, scale); // 下一层可能还要用 scratch
+    }
+    Flush(origin, scale);
+}
+
+// 按 scale 的分辨率重新合成；分辨率变了两张纹理都换掉，从头叠
+static void Compose(CompositeTile& t, int tx, int ty, int scale) {
+    PROFILE_SCOPE("Compositor::Compose");
+    if (t.full && t.scale != scale) {
+        DropTile(t);
+        t.dirtyFrom = 0;
+    }
+    t.scale = scale;
+    int active = Layers::active;
+    bool fresh = t.full == 0;
+    if (fresh) t.full = NewTexture(scale);
+    if (!fresh && active > 0 && t.dirtyFrom >= active) {
+        // 当前层以下没变：从 below 开始，只叠当前层往上的
+        if (t.belowFor != active) {
+            if (!t.below) t.below = NewTexture(scale);
+            StackLayers(t.below, 0, 0, active, tx, ty, scale);
+            t.belowFor = active;
+        }
+        StackLayers(t.full, t.below, active, Layers::Count(), tx, ty, scale);
+    } else {
+        if (t.dirtyFrom < t.belowFor) t.belowFor = -1;
+        StackLayers(t.full, 0, 0, Layers::Count(), tx, ty, scale);
+    }
+    t.dirtyFrom = CLEAN;
+}
+
+// ---------------- 接口 ----------------
+void Compositor::Init() {
+    TileCanvas::onChange = TileChanged;
+}
+
+void Compositor::Clear() {
+    for (auto& kv : cache) DropTile(kv.second);
+    cache.clear();
+}
+
+static void MarkDirty(CompositeTile& t, int layer) {
+    t.dirtyFrom = std::min(t.dirtyFrom, layer);
+}
+
+void Compositor::Invalidate(int layer, ImVec2 bmin, ImVec2 bmax) {
+    if (cache.empty() || bmin.x > bmax.x || bmin.y > bmax.y) return;
+    int tx0 = std::max(0, (int)floorf((bmin.x - 1) / TILE)), ty0 = std::max(0, (int)floorf((bmin.y - 1) / TILE));
+    int tx1 = std::min(TileCanvas::TilesX() - 1, (int)floorf((bmax.x + 1) / TILE));
+    int ty1 = std::min(TileCanvas::TilesY() - 1, (int)floorf((bmax.y + 1) / TILE));
+    if (tx0 > tx1 || ty0 > ty1) return;
+    // 范围比缓存大时（比如大笔画的包围盒）直接扫一遍缓存
+    if ((size_t)(tx1 - tx0 + 1) * (ty1 - ty0 + 1) > cache.size()) {
+        for (auto& kv : cache) {
+            int tx = (int)(kv.first % TileCanvas::TilesX()), ty = (int)(kv.first / TileCanvas::TilesX());
+            if (tx >= tx0 && tx <= tx1 && ty >= ty0 && ty <= ty1) MarkDirty(kv.second, layer);
+        }
+        return;
+    }
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            auto it = cache.find(Key(tx, ty));
+            if (it != cache.end()) MarkDirty(it->second, layer);
+        }
+    }
+}
+
+void Compositor::InvalidateAll(int layer) {
+    for (auto& kv : cache) MarkDirty(kv.second, layer);
+}
+
+void Compositor::TileChanged(int surface, int tx, int ty) {
+    if (cache.empty()) return;
+    auto it = cache.find(Key(tx, ty));
+    if (it == cache.end()) return;
+    int k = Layers::IndexOf(surface);
+    if (k >= 0) MarkDirty(it->second, k);
+}
+
+void Compositor::Draw(ImDrawList* dl, ImVec2 origin, float zoom, ImVec2 viewMin, ImVec2 viewMax) {
+    PROFILE_SCOPE("Compositor::Draw");
+    tilesComposed = 0;
+    tilesDrawn = 0;
+    freshThisFrame = 0;
+    pending = false;
+
+    // 1. 可见图层的笔画缓存，顺便收集改动范围作废对应的瓦片
+    for (int k = 0; k < Layers::Count(); k++) {
+        Layer& l = Layers::At(k);
+        if (!l.visible) continue;
+        UpdateStrokeCaches(l.strokes, !Renderer::vertexPulling);
+        ImVec2 bmin, bmax;
+        if (l.strokes.TakeDamage(bmin, bmax)) Invalidate(k, bmin, bmax);
+    }
+
+    dl->AddRectFilled(origin, {origin.x + canvasW * zoom, origin.y + canvasH * zoom}, IM_COL32_WHITE);
+    if (!UseGL()) {
+        // 软件后端没有纹理可以合成，只把可见图层的笔画直接画上去
+        for (int k = 0; k < Layers::Count(); k++) {
+            const Layer& l = Layers::At(k);
+            if (!l.visible) continue;
+            for (size_t i = 0; i < l.strokes.size(); i++) Renderer::DrawStroke(dl, l.strokes, i, origin, zoom);
+        }
+        return;
+    }
+    int tx0 = std::max(0, (int)floorf(viewMin.x / TILE)), ty0 = std::max(0, (int)floorf(viewMin.y / TILE));
+    int tx1 = std::min(TileCanvas::TilesX() - 1, (int)floorf(viewMax.x / TILE));
+    int ty1 = std::min(TileCanvas::TilesY() - 1, (int)floorf(viewMax.y / TILE));
+    if (tx0 > tx1 || ty0 > ty1) return;
+    if (!list) {
+        list = new ImDrawList(ImGui::GetDrawListSharedData());
+        scratchList = new ImDrawList(ImGui::GetDrawListSharedData());
+    }
+    int zoomScale = ScaleFor(zoom);
+
+    // 2. 未烘焙笔画按包围盒标到视口的格子上，每个格子记有几个图层有笔画
+    int gw = tx1 - tx0 + 1, gh = ty1 - ty0 + 1;
+    static std::vector<int> liveLayers, liveMark;
+    liveLayers.assign((size_t)gw * gh, 0);
+    liveMark.assign((size_t)gw * gh, -1);
+    for (int k = 0; k < Layers::Count(); k++) {
+        const Layer& l = Layers::At(k);
+        if (!l.visible) continue;
+        const StrokeStore& s = l.strokes;
+        for (size_t i = 0; i < s.size(); i++) {
+            if (s.Count(i) < 2 || s.boundsMin[i].x > s.boundsMax[i].x) continue;
+            int cx0 = std::max(tx0, (int)floorf((s.boundsMin[i].x - 1) / TILE)), cy0 = std::max(ty0, (int)floorf((s.boundsMin[i].y - 1) / TILE));
+            int cx1 = std::min(tx1, (int)floorf((s.boundsMax[i].x + 1) / TILE)), cy1 = std::min(ty1, (int)floorf((s.boundsMax[i].y + 1) / TILE));
+            for (int cy = cy0; cy <= cy1; cy++) {
+                for (int cx = cx0; cx <= cx1; cx++) {
+                    size_t c = (size_t)(cy - ty0) * gw + (cx - tx0);
+                    if (liveMark[c] == k) continue;
+                    liveMark[c] = k;
+                    liveLayers[c]++;
+                }
+            }
+        }
+    }
+
+    // 3. 逐块显示：只有一层有底图、没有未烘焙笔画、正常混合的直接画那层的瓦片，其他的用（必要时重新）合成的缓存
+    AddBlend(dl, BlendMode::Normal);
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            int painted = 0, only = -1;
+            for (int k = 0; k < Layers::Count(); k++) {
+                const Layer& l = Layers::At(k);
+                if (!l.visible) continue;
+                Layers::Bind(l);
+                if (TileCanvas::Painted(tx, ty)) { painted++; only = k; }
+            }
+            int live = liveLayers[(size_t)(ty - ty0) * gw + (tx - tx0)];
+            if (painted == 0 && live == 0) continue;
+
+            // 右边和下边的瓦片可能超出画布，只画画布里的部分
+            int x = tx * TILE, y = ty * TILE;
+            float w = (float)std::min(TILE, canvasW - x), h = (float)std::min(TILE, canvasH - y);
+            ImVec2 a = {origin.x + x * zoom, origin.y + y * zoom}, b = {a.x + w * zoom, a.y + h * zoom};
+            ImVec2 uv0 = {0, 1}, uv1 = {w / TILE, 1 - h / TILE};
+            const Layer* single = painted == 1 && live == 0 ? &Layers::At(only) : nullptr;
+            if (single && single->blend == BlendMode::Normal) {
+                Layers::Bind(*single);
+                GLuint tex = TileCanvas::Texture(tx, ty);
+                if (tex) {
+                    dl->AddImage((ImTextureID)(intptr_t)tex, a, b, uv0, uv1, OpacityTint(single->opacity));
+                    tilesDrawn++;
+                }
+                continue;
+            }
+
+            CompositeTile& t = cache[Key(tx, ty)];
+            t.lastUsed = frame;
+            // 未烘焙的笔画是矢量的，放大时按屏幕分辨率合成才清楚；只有底图的瓦片本来就是每像素一个纹素，用不着
+            int scale = live ? zoomScale : 1;
+            if (!t.full || t.dirtyFrom != CLEAN || (live && t.scale != scale)) {
+                // 还没合成过的每帧有上限，这一帧先显示成白的；已经有的脏瓦片（正在画的地方）马上重叠
+                if (t.full || freshThisFrame++ < FRESH_PER_FRAME) {
+                    Compose(t, tx, ty, scale);
+                    tilesComposed++;
+                } else {
+                    pending = true;
+                }
+            }
+            if (!t.full) continue;
+            dl->AddImage((ImTextureID)(intptr_t)t.full, a, b, uv0, uv1);
+            tilesDrawn++;
+        }
+    }
+    dl->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    if (tilesComposed) glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    Layers::Bind(Layers::Active());
+    PROFILE_COUNTER("tiles composed", tilesComposed);
+    PROFILE_COUNTER("tiles drawn", tilesDrawn);
+}
+
+// 缓存超出预算时按最久没显示的顺序丢掉；这一帧用过的不动
+void Compositor::EndFrame() {
+    if (CachedBytes() > budget) {
+        std::vector<std::pair<uint64_t, uint32_t>> lru;
+        for (const auto& kv : cache)
+            if (kv.second.lastUsed < frame) lru.push_back({kv.second.lastUsed, kv.first});
+        std::sort(lru.begin(), lru.end());
+        for (const auto& p : lru) {
+            if (CachedBytes() <= budget) break;
+            auto it = cache.find(p.second);
+            DropTile(it->second);
+            cache.erase(it);
+        }
+    }
+    PROFILE_COUNTER("composite tiles", cache.size());
+    frame++;
+}
+
+void Compositor::AddBlend(ImDrawList* dl, BlendMode mode) {
+    dl->AddCallback(SetBlend, (void*)(intptr_t)mode);
+}
+
+int Compositor::CachedTiles() {
+    return (int)cache.size();
+}
+
+size_t Compositor::CachedBytes() {
+    return textureBytes;
+}
\ No newline at end of file
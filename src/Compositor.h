@@ -0,0 +1,32 @@
+#pragma once
+#include "Common.h"
+#include "Layers.h"
+
+// 图层合成（GL 后端）：画布按 TileCanvas::TILE 分块，每块缓存一张合成好的纹理——
+// 白纸上自下而上叠可见图层，每层是它的底图瓦片加上碰到这块的未烘焙笔画，按混合模式和不透明度叠上去。
+// 图层的笔画或底图变了只作废碰到的瓦片，并记下从哪一层开始变；改动在当前层或以上时，
+// 从缓存的“当前层以下”那张开始只重叠当前层往上的几层。
+// 只有一个图层有内容、正常混合、又没有未烘焙笔画的瓦片直接显示那层的瓦片，不占缓存。
+// 放大时有未烘焙笔画的瓦片按屏幕分辨率合成（每个画布像素最多 8x8 个纹素），笔画不会被放大成糊的。
+// 隐藏的图层不更新笔画缓存也不参与合成，每帧没有开销。
+class Compositor {
+public:
+    static size_t budget;     // 缓存纹理的总字节数，超出时丢掉最久没显示的
+    static int tilesComposed; // 上一帧重新合成了多少块
+    static int tilesDrawn;    // 上一帧画了多少块（直接显示的 + 缓存的）
+    static bool pending;      // 上一帧有瓦片因为每帧上限还没合成
+
+    static void Init(); // 挂上 TileCanvas::onChange
+    static void Clear(); // 换画布 / 打开文档时丢掉所有缓存
+    static void Invalidate(int layer, ImVec2 bmin, ImVec2 bmax); // 下标 layer 的图层在这个画布矩形里变了
+    static void InvalidateAll(int layer);
+    static void TileChanged(int surface, int tx, int ty);
+    // 收集可见图层的笔画改动，合成视口 [viewMin, viewMax]（画布坐标）里要用的瓦片并画进 dl：
+    // 画布 (0, 0) 在屏幕上的 origin 处，缩放 zoom
+    static void Draw(ImDrawList* dl, ImVec2 origin, float zoom, ImVec2 viewMin, ImVec2 viewMax);
+    static void EndFrame(); // 按预算丢缓存
+    // 往 dl 里插一个回调：之后画的预乘颜色按 mode 混合到不透明的目标上；用完要自己插 ResetRenderState
+    static void AddBlend(ImDrawList* dl, BlendMode mode);
+    static int CachedTiles();
+    static size_t CachedBytes();
+};
\ No newline at end of file
@@ -0,0 +1,717 @@
+#include "Document.h"
+#include "Compositor.h"
+#include "Layers.h"
+#include "Renderer.h"
+#include "TileCanvas.h"
+#include "BrushRegistry.h"
+#include "StrokeIndex.h"
+#include "History.h"
+#include "ThreadPool.h"
+#include <stb/stb_image.h>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace fs = std::filesystem;
+
+std::string Document::status;
+
+// 文件布局：Header | 笔刷名字表 | 每个图层的瓦片…… | 笔画块…… | 块表 | 图层表
+struct DocHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t canvasW, canvasH;
+    uint32_t tileSize;
+    uint32_t brushCount;
+    uint32_t strokeCount;
+    uint32_t chunkCount;
+    int32_t maxId;
+    uint32_t layerCount;    // 4 以前是 0，只有一层
+    uint64_t brushOffset;
+    uint64_t tileOffset;    // 4 以前唯一一层的瓦片
+    uint64_t chunkTableOffset;
+    uint64_t layerTableOffset; // 4 以前没有这个字段
+};
+// 3 以前的文件头到 chunkTableOffset 为止
+static const size_t LEGACY_HEADER = offsetof(DocHeader, layerTableOffset);
+struct ChunkEntry {
+    uint64_t offset;
+    uint32_t first, count;
+    uint32_t bytes, layer; // layer 是图层下标，4 以前是 0
+};
+// 2: 每笔多一个 flags（样条）；3: 橡皮擦切出的碎片带印章种子/序号/相位；
+// 4: 多图层，底图瓦片是透明底上预乘的颜色（以前是白底不透明的）；5: flags 里多了矩形 / 椭圆；
+// 6: 样条 / 椭圆碎片保留控制点，带一个 CurveRange
+static const uint32_t DOC_VERSION = 6;
+static const uint32_t MAX_LAYERS = 1024;
+// 每笔的 flags 位
+static const uint32_t STROKE_SPLINE = 1, STROKE_PIECE = 2, STROKE_RECT = 4, STROKE_ELLIPSE = 8, STROKE_RANGE = 16;
+static const int DOC_TILE = 64;
+static const float POINT_SCALE = 8.0f; // 点坐标量化到 1/8 像素
+static_assert(TileCanvas::TILE % DOC_TILE == 0, "文档瓦片要能整除底图瓦片");
+static_assert(History::TILE == DOC_TILE, "保存时直接用撤销历史里的瓦片");
+
+// ---------------- 编码工具 ----------------
+static void PutVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static void PutRaw(std::vector<uint8_t>& out, const void* p, size_t n) {
+    out.insert(out.end(), (const uint8_t*)p, (const uint8_t*)p + n);
+}
+
+static uint32_t ZigZag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t UnZigZag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+// 越界时 ok 置 false，之后读出的都是 0
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint32_t Varint() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p >= end) { ok = false; return 0; }
+            uint8_t b = *p++;
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    void Raw(void* dst, size_t n) {
+        if ((size_t)(end - p) < n) { ok = false; memset(dst, 0, n); return; }
+        memcpy(dst, p, n);
+        p += n;
+    }
+};
+
+// ---------------- 内存映射 ----------------
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+
+    bool Open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) return false;
+        size = (size_t)sz.QuadPart;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return false;
+        data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+        size = (size_t)st.st_size;
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        data = (const uint8_t*)p;
+        return true;
+#endif
+    }
+
+    // [offset, offset + bytes) 在文件里；文件里读来的偏移可能任意大，先比 offset 再用减法，不会溢出
+    bool Contains(uint64_t offset, uint64_t bytes = 0) const {
+        return offset <= size && bytes <= size - offset;
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap((void*)data, size);
+#endif
+    }
+};
+
+// ---------------- 笔画 ----------------
+// 后台线程不能碰 StrokeStore 和全局 id 计数器，先解到这里，主线程再接进 StrokeStore
+struct StrokeData {
+    int id;
+    ImU32 color;
+    float thickness;
+    int brush;
+    bool spline;
+    StrokeShape shape;
+    uint32_t seed, stampBase;
+    float phase;
+    CurveRange range;
+    std::vector<ImVec2> points;
+};
+
+static void EncodeStroke(const StrokeView& s, std::vector<uint8_t>& out) {
+    PutVarint(out, (uint32_t)s.id);
+    PutRaw(out, &s.color, 4);
+    PutRaw(out, &s.thickness, 4);
+    PutVarint(out, s.brush < 0 ? 0 : (uint32_t)s.brush + 1);
+    bool piece = s.seed != (uint32_t)s.id || s.stampBase != 0 || s.phase != 0.0f;
+    uint32_t shape = s.shape == StrokeShape::Rect ? STROKE_RECT : s.shape == StrokeShape::Ellipse ? STROKE_ELLIPSE : 0;
+    PutVarint(out, (s.spline ? STROKE_SPLINE : 0) | (piece ? STROKE_PIECE : 0) | shape | (s.range.Whole() ? 0 : STROKE_RANGE));
+    if (piece) {
+        PutVarint(out, s.seed);
+        PutVarint(out, s.stampBase);
+        PutRaw(out, &s.phase, 4);
+    }
+    if (!s.range.Whole()) {
+        PutVarint(out, (uint32_t)s.range.first);
+        PutVarint(out, (uint32_t)s.range.last);
+        PutRaw(out, &s.range.start, 4);
+        PutRaw(out, &s.range.end, 4);
+    }
+    PutVarint(out, (uint32_t)s.count);
+    int32_t px = 0, py = 0;
+    for (int k = 0; k < s.count; k++) {
+        const ImVec2& p = s.points[k];
+        int32_t qx = (int32_t)std::lround(p.x * POINT_SCALE), qy = (int32_t)std::lround(p.y * POINT_SCALE);
+        PutVarint(out, ZigZag(qx - px));
+        PutVarint(out, ZigZag(qy - py));
+        px = qx;
+        py = qy;
+    }
+}
+
+static bool DecodeStroke(Reader& in, uint32_t version, const std::vector<int>& brushMap, StrokeData& s) {
+    s.id = (int)in.Varint();
+    in.Raw(&s.color, 4);
+    in.Raw(&s.thickness, 4);
+    uint32_t ref = in.Varint();
+    s.brush = (ref == 0 || ref > brushMap.size()) ? 0 : brushMap[ref - 1];
+    uint32_t flags = version >= 2 ? in.Varint() : 0;
+    s.spline = flags & STROKE_SPLINE;
+    s.shape = (flags & STROKE_RECT) ? StrokeShape::Rect : (flags & STROKE_ELLIPSE) ? StrokeShape::Ellipse : StrokeShape::Path;
+    s.seed = (uint32_t)s.id;
+    s.stampBase = 0;
+    s.phase = 0.0f;
+    if (flags & STROKE_PIECE) {
+        s.seed = in.Varint();
+        s.stampBase = in.Varint();
+        in.Raw(&s.phase, 4);
+    }
+    s.range = CurveRange();
+    if (flags & STROKE_RANGE) {
+        s.range.first = (int)in.Varint();
+        s.range.last = (int)in.Varint();
+        in.Raw(&s.range.start, 4);
+        in.Raw(&s.range.end, 4);
+    }
+    uint32_t n = in.Varint();
+    if (!in.ok || n > (uint32_t)(in.end - in.p)) return false; // 每个点至少 2 字节
+    if (n < 3) s.shape = StrokeShape::Path; // 图形固定是 3 个控制点
+    s.points.resize(n);
+    int32_t qx = 0, qy = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        qx += UnZigZag(in.Varint());
+        qy += UnZigZag(in.Varint());
+        s.points[i] = {qx / POINT_SCALE, qy / POINT_SCALE};
+    }
+    // 只有样条和椭圆能是一截，段号要在曲线的段数以内
+    int segs = s.shape == StrokeShape::Ellipse ? 4 : s.spline && s.shape == StrokeShape::Path ? (int)n - 1 : 0;
+    if (s.range.first < 0 || s.range.first > s.range.last || s.range.last >= segs) s.range = CurveRange();
+    return in.ok;
+}
+
+// ---------------- 保存 ----------------
+static std::atomic<bool> saving{false};
+
+// 保存时拿的快照，写盘都在后台线程。底图瓦片：撤销历史里有的文档瓦片直接共享，其余的整块拿 TileCanvas 快照
+// （GL 常驻的在 GPU 上拷一份，Pump 里异步读回来）；笔画拿 StrokeStore 快照，点在 Pump 里分几帧拷
+struct SaveLayer {
+    int id;
+    std::string name;
+    float opacity;
+    uint8_t blend, visible;
+    std::unordered_map<int, History::Pixels> known;            // 文档瓦片号 -> 撤销历史里的内容
+    std::unordered_map<int, TileCanvas::Snapshot> snapshots;   // 底图瓦片号 -> 还没解开的快照
+    std::unordered_map<int, std::vector<unsigned char>> tiles; // 底图瓦片号 -> TILE x TILE RGBA（自上而下）
+    std::shared_ptr<StrokeSnapshot> strokes;
+};
+struct SaveJob {
+    std::string path;
+    int w, hgt;
+    std::vector<SaveLayer> layers;
+    std::vector<std::string> names;
+    int reading = 0; // 还在读的 GL 快照
+    bool failed = false, writing = false;
+};
+// 主线程拿着，写完后在 Pump 里放掉：共享的撤销历史瓦片要在主线程析构
+static std::shared_ptr<SaveJob> saveJob;
+
+static bool WriteDocument(SaveJob& job) {
+    const int TILE = TileCanvas::TILE;
+    int w = job.w, hgt = job.hgt, tilesX = (w + TILE - 1) / TILE, docTilesX = (w + DOC_TILE - 1) / DOC_TILE;
+    for (auto& l : job.layers) {
+        for (auto& kv : l.snapshots) {
+            std::vector<unsigned char>& px = l.tiles[kv.first];
+            px.resize(TileCanvas::TILE_BYTES);
+            if (!TileCanvas::UnpackSnapshot(kv.second, px.data())) return false;
+        }
+        l.snapshots.clear();
+    }
+
+    std::string tmp = job.path + ".tmp";
+    bool ok = false;
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        DocHeader h = {};
+        memcpy(h.magic, "PDOC", 4);
+        h.version = DOC_VERSION;
+        h.canvasW = w;
+        h.canvasH = hgt;
+        h.tileSize = DOC_TILE;
+        h.brushCount = (uint32_t)job.names.size();
+        h.layerCount = (uint32_t)job.layers.size();
+        h.maxId = -1;
+        for (const auto& l : job.layers) {
+            h.strokeCount += (uint32_t)l.strokes->strokes.size();
+            for (int id : l.strokes->strokes.id) h.maxId = std::max(h.maxId, (int32_t)id);
+        }
+        out.write((const char*)&h, sizeof(h)); // 占位，最后回填偏移
+
+        std::vector<uint8_t> buf;
+        h.brushOffset = (uint64_t)out.tellp();
+        for (const auto& n : job.names) {
+            uint16_t len = (uint16_t)std::min<size_t>(n.size(), 0xFFFF);
+            PutRaw(buf, &len, 2);
+            PutRaw(buf, n.data(), len);
+        }
+        out.write((const char*)buf.data(), buf.size());
+
+        static const std::vector<unsigned char> blank((size_t)DOC_TILE * DOC_TILE * 4, 0);
+        std::vector<uint64_t> tileOffsets;
+        for (const auto& l : job.layers) {
+            tileOffsets.push_back((uint64_t)out.tellp());
+            for (int y = 0; y < hgt; y += DOC_TILE) {
+                buf.clear();
+                for (int x = 0; x < w; x += DOC_TILE) {
+                    int tw = std::min(DOC_TILE, w - x), th = std::min(DOC_TILE, hgt - y);
+                    auto known = l.known.find(y / DOC_TILE * docTilesX + x / DOC_TILE);
+                    if (known != l.known.end()) {
+                        TileCanvas::Encode(known->second->data(), (size_t)tw * 4, tw, th, buf);
+                        continue;
+                    }
+                    auto it = l.tiles.find((y / TILE) * tilesX + x / TILE);
+                    if (it == l.tiles.end()) {
+                        TileCanvas::Encode(blank.data(), (size_t)DOC_TILE * 4, tw, th, buf);
+                        continue;
+                    }
+                    size_t offset = ((size_t)(y % TILE) * TILE + x % TILE) * 4;
+                    TileCanvas::Encode(&it->second[offset], (size_t)TILE * 4, tw, th, buf);
+                }
+                out.write((const char*)buf.data(), buf.size());
+            }
+        }
+        h.tileOffset = tileOffsets[0];
+
+        // 笔画按图层、按块编码，编一块写一块
+        std::vector<ChunkEntry> chunks;
+        for (uint32_t k = 0; k < h.layerCount; k++) {
+            const StrokeStore& strokes = job.layers[k].strokes->strokes;
+            for (size_t first = 0; first < strokes.size(); first += Document::CHUNK) {
+                size_t last = std::min(strokes.size(), first + Document::CHUNK);
+                buf.clear();
+                for (size_t i = first; i < last; i++) EncodeStroke(strokes.View(i), buf);
+                chunks.push_back({(uint64_t)out.tellp(), (uint32_t)first, (uint32_t)(last - first), (uint32_t)buf.size(), k});
+                out.write((const char*)buf.data(), buf.size());
+            }
+        }
+        h.chunkCount = (uint32_t)chunks.size();
+        h.chunkTableOffset = (uint64_t)out.tellp();
+        out.write((const char*)chunks.data(), chunks.size() * sizeof(ChunkEntry));
+
+        // 图层表：名字、不透明度、混合模式、是否可见、瓦片位置
+        h.layerTableOffset = (uint64_t)out.tellp();
+        buf.clear();
+        for (uint32_t k = 0; k < h.layerCount; k++) {
+            const auto& l = job.layers[k];
+            uint16_t len = (uint16_t)std::min<size_t>(l.name.size(), 0xFFFF);
+            PutRaw(buf, &len, 2);
+            PutRaw(buf, l.name.data(), len);
+            PutRaw(buf, &l.opacity, 4);
+            buf.push_back(l.blend);
+            buf.push_back(l.visible);
+            PutRaw(buf, &tileOffsets[k], 8);
+        }
+        out.write((const char*)buf.data(), buf.size());
+
+        out.seekp(0);
+        out.write((const char*)&h, sizeof(h));
+        ok = (bool)out;
+    }
+    std::error_code ec;
+    if (ok) fs::rename(tmp, job.path, ec);
+    return ok && !ec;
+}
+
+static void StartWrite(std::shared_ptr<SaveJob> job) {
+    job->writing = true;
+    ThreadPool::Submit([job]() mutable {
+        bool ok = !job->failed && WriteDocument(*job);
+        std::cout << (ok ? "Saved " : "Failed to save ") << job->path << std::endl;
+        job.reset(); // 主线程的 saveJob 最后放手
+        saving = false;
+    });
+}
+
+// 每帧拷这么多个笔画点（2MB），拷完之前改笔画的操作会自己先拷完
+static const size_t SAVE_POINTS_PER_FRAME = (size_t)1 << 18;
+
+// 每帧拷一批点、有几个回读槽就发几块 GL 快照，都齐了交给后台线程写盘；写完了在这里放掉快照
+static void PumpSave() {
+    if (!saveJob) return;
+    if (!saving) {
+        saveJob.reset();
+        return;
+    }
+    SaveJob& job = *saveJob;
+    if (job.writing) return;
+    size_t budget = SAVE_POINTS_PER_FRAME;
+    bool copied = true;
+    for (SaveLayer& d : job.layers) {
+        if (d.strokes->Done()) continue;
+        // 删图层时析构里已经拷完了；没拷完的快照只有这里拿着，说明笔画被整个换掉了，拷不下去
+        Layer* layer = Layers::Find(d.id);
+        if (!layer || d.strokes.use_count() == 1) {
+            job.failed = true;
+            continue;
+        }
+        size_t before = d.strokes->strokes.arena.size();
+        layer->strokes.CopySnapshot(budget);
+        budget -= std::min(budget, d.strokes->strokes.arena.size() - before);
+        copied &= d.strokes->Done();
+    }
+    for (size_t k = 0; k < job.layers.size(); k++) {
+        auto& snapshots = job.layers[k].snapshots;
+        for (auto it = snapshots.begin(); it != snapshots.end();) {
+            if (!it->second.texture) { ++it; continue; }
+            std::shared_ptr<SaveJob> keep = saveJob;
+            int tile = it->first;
+            bool sent = TileCanvas::ReadSnapshot(it->second, [keep, k, tile](const unsigned char* rgba) {
+                if (rgba) keep->layers[k].tiles[tile].assign(rgba, rgba + TileCanvas::TILE_BYTES);
+                else keep->failed = true;
+                keep->reading--;
+            });
+            if (!sent) break;
+            it = snapshots.erase(it);
+        }
+    }
+    if (copied && job.reading == 0) StartWrite(saveJob);
+}
+
+bool Document::Save(const std::string& path) {
+    if (saving.exchange(true)) return false;
+
+    // 主线程只拿快照，不回读也不拷点
+    auto job = std::make_shared<SaveJob>();
+    job->path = path;
+    job->w = canvasW;
+    job->hgt = canvasH;
+    const int TILE = TileCanvas::TILE;
+    int w = canvasW, hgt = canvasH, tilesX = TileCanvas::TilesX(), docTilesX = (w + DOC_TILE - 1) / DOC_TILE;
+    job->layers.resize(Layers::Count());
+    for (int k = 0; k < Layers::Count(); k++) {
+        Layer& l = Layers::At(k);
+        SaveLayer& d = job->layers[k];
+        d.id = l.id;
+        d.name = l.name;
+        d.opacity = l.opacity;
+        d.blend = (uint8_t)l.blend;
+        d.visible = l.visible;
+        Layers::Bind(l);
+        TileCanvas::ForEachPainted([&](int tx, int ty) {
+            // 整块底图瓦片的文档瓦片都在撤销历史里时直接共享，否则整块拿快照
+            std::vector<std::pair<int, History::Pixels>> found;
+            bool all = true;
+            for (int y = ty * TILE; all && y < std::min(hgt, (ty + 1) * TILE); y += DOC_TILE)
+                for (int x = tx * TILE; all && x < std::min(w, (tx + 1) * TILE); x += DOC_TILE) {
+                    int doc = y / DOC_TILE * docTilesX + x / DOC_TILE;
+                    found.push_back({doc, History::KnownTile(l.id, doc)});
+                    all = found.back().second != nullptr;
+                }
+            if (all) {
+                d.known.insert(found.begin(), found.end());
+                return;
+            }
+            TileCanvas::Snapshot snap = TileCanvas::TakeSnapshot(tx, ty);
+            if (snap.texture) job->reading++;
+            d.snapshots.emplace(ty * tilesX + tx, std::move(snap));
+        });
+        d.strokes = l.strokes.Snapshot();
+    }
+    Layers::Bind(Layers::Active());
+    for (const auto& p : BrushRegistry::profiles) job->names.push_back(p.name);
+    status = "Saving " + path + "...";
+
+    saveJob = job;
+    PumpSave();
+    return true;
+}
+
+bool Document::Saving() {
+    return saving;
+}
+
+// ---------------- 读取 ----------------
+static std::mutex loadMutex;
+static std::map<int, std::vector<StrokeData>> readyChunks; // 按块号排好，Pump 只接下一块
+static int loadGeneration = 0;
+static int nextChunk = 0, chunkCount = 0;
+static size_t loadedStrokes = 0, totalStrokes = 0;
+static int loadIdLimit = 0; // 文件里的 id 都小于它，用来找插入位置
+static std::vector<int> chunkLayers; // 每块笔画属于哪个图层（图层 id）
+
+// 一个图层的底图：先扫一遍拿到每个文档瓦片的位置，再按底图瓦片分组并行解压，写进选中的图层。
+// 空白的文档瓦片跳过（4 以前是纯白，之后是全透明），整块都空白的底图瓦片不分配
+static bool LoadTiles(const uint8_t* begin, const uint8_t* end, int w, int hgt, bool legacy) {
+    struct TileRef { int x, y; uint8_t type; const uint8_t* data; uint32_t size; };
+    const int TILE = TileCanvas::TILE;
+    static const uint8_t white[4] = {255, 255, 255, 255}, clear[4] = {0, 0, 0, 0};
+    const uint8_t* blank = legacy ? white : clear;
+    std::unordered_map<int, std::vector<TileRef>> groups;
+    Reader in{begin, end};
+    for (int y = 0; y < hgt && in.ok; y += DOC_TILE) {
+        for (int x = 0; x < w && in.ok; x += DOC_TILE) {
+            TileRef t = {x, y, 0, nullptr, 0};
+            in.Raw(&t.type, 1);
+            in.Raw(&t.size, 4);
+            if (!in.ok || t.size > (size_t)(in.end - in.p)) { in.ok = false; break; }
+            t.data = in.p;
+            in.p += t.size;
+            if (t.type == TileCanvas::SOLID && t.size == 4 && memcmp(t.data, blank, 4) == 0) continue;
+            groups[(y / TILE) * TileCanvas::TilesX() + x / TILE].push_back(t);
+        }
+    }
+    std::vector<int> keys;
+    for (const auto& g : groups) keys.push_back(g.first);
+    std::sort(keys.begin(), keys.end());
+    std::atomic<bool> tilesOk{in.ok};
+    // 分批解压、写入，每批之后按预算换出一次，大文档打开时峰值内存有上限
+    const int BATCH = 256;
+    std::vector<std::vector<unsigned char>> px(BATCH);
+    for (size_t first = 0; first < keys.size(); first += BATCH) {
+        int n = (int)std::min<size_t>(BATCH, keys.size() - first);
+        ThreadPool::ParallelFor(n, [&](int k) {
+            int key = keys[first + k];
+            int x0 = (key % TileCanvas::TilesX()) * TILE, y0 = (key / TileCanvas::TilesX()) * TILE;
+            int tw = std::min(TILE, w - x0), th = std::min(TILE, hgt - y0);
+            // 跳过的部分是透明的：老文件的白底和白纸上的透明看起来一样
+            px[k].assign((size_t)tw * th * 4, 0);
+            for (const TileRef& t : groups.at(key)) {
+                size_t offset = ((size_t)(t.y - y0) * tw + (t.x - x0)) * 4;
+                if (!TileCanvas::Decode(t.type, t.data, t.size, &px[k][offset], (size_t)tw * 4,
+                                        std::min(DOC_TILE, w - t.x), std::min(DOC_TILE, hgt - t.y)))
+                    tilesOk = false;
+            }
+        });
+        for (int k = 0; k < n; k++) {
+            int key = keys[first + k];
+            int x0 = (key % TileCanvas::TilesX()) * TILE, y0 = (key / TileCanvas::TilesX()) * TILE;
+            Renderer::WriteRegion(x0, y0, std::min(TILE, w - x0), std::min(TILE, hgt - y0), px[k].data());
+        }
+        TileCanvas::EndFrame();
+    }
+    return tilesOk;
+}
+
+bool Document::Load(const std::string& path) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(path) || file->size < LEGACY_HEADER) {
+        status = "Cannot open " + path;
+        return false;
+    }
+    DocHeader h = {};
+    memcpy(&h, file->data, std::min(sizeof(h), file->size));
+    if (h.version < 4) {
+        h.layerCount = 1;
+        h.layerTableOffset = 0;
+    }
+    if (memcmp(h.magic, "PDOC", 4) != 0 || (h.version < 1 || h.version > DOC_VERSION) || h.tileSize != DOC_TILE ||
+        h.canvasW <= 0 || h.canvasH <= 0 || h.canvasW > MAX_CANVAS || h.canvasH > MAX_CANVAS ||
+        h.layerCount == 0 || h.layerCount > MAX_LAYERS || !file->Contains(h.layerTableOffset) ||
+        !file->Contains(h.brushOffset) || !file->Contains(h.tileOffset) ||
+        !file->Contains(h.chunkTableOffset, (uint64_t)h.chunkCount * sizeof(ChunkEntry))) {
+        status = "Not a valid document: " + path;
+        return false;
+    }
+
+    // 名字表：文件里的笔刷序号 -> 本机注册表 id，找不到的用 0 号
+    std::vector<int> brushMap;
+    Reader in{file->data + h.brushOffset, file->data + file->size};
+    for (uint32_t i = 0; i < h.brushCount && in.ok; i++) {
+        uint16_t len = 0;
+        in.Raw(&len, 2);
+        std::string name(len, '\0');
+        in.Raw(name.data(), len);
+        brushMap.push_back(std::max(0, BrushRegistry::Find(name)));
+    }
+
+    // 图层表；4 以前只有一层，用默认设置
+    struct LayerInfo {
+        std::string name;
+        float opacity = 1.0f;
+        uint8_t blend = 0, visible = 1;
+        uint64_t tileOffset;
+    };
+    std::vector<LayerInfo> infos(h.layerCount);
+    infos[0].tileOffset = h.tileOffset;
+    if (h.version >= 4) {
+        in = Reader{file->data + h.layerTableOffset, file->data + file->size};
+        for (LayerInfo& info : infos) {
+            uint16_t len = 0;
+            in.Raw(&len, 2);
+            info.name.resize(len);
+            in.Raw(info.name.data(), len);
+            in.Raw(&info.opacity, 4);
+            in.Raw(&info.blend, 1);
+            in.Raw(&info.visible, 1);
+            in.Raw(&info.tileOffset, 8);
+            if (info.blend > (uint8_t)BlendMode::Add || !file->Contains(info.tileOffset)) in.ok = false;
+        }
+        if (!in.ok) {
+            status = "Not a valid document: " + path;
+            return false;
+        }
+    }
+
+    // 按文件里的尺寸换一张空白画布和对应数量的图层，逐层解出底图
+    TileCanvas::Init(h.canvasW, h.canvasH);
+    Layers::Reset((int)h.layerCount);
+    Compositor::Clear();
+    bool tilesOk = true;
+    for (uint32_t k = 0; k < h.layerCount; k++) {
+        Layer& l = Layers::At((int)k);
+        if (!infos[k].name.empty()) l.name = infos[k].name;
+        l.opacity = std::clamp(infos[k].opacity, 0.0f, 1.0f);
+        l.blend = (BlendMode)infos[k].blend;
+        l.visible = infos[k].visible != 0;
+        Layers::Bind(l);
+        if (!LoadTiles(file->data + infos[k].tileOffset, file->data + file->size, h.canvasW, h.canvasH, h.version < 4))
+            tilesOk = false;
+    }
+    Layers::Bind(Layers::Active());
+    if (!tilesOk) std::cout << "Document baked layer is corrupt: " << path << std::endl;
+
+    StrokeIndex::Clear();
+    History::Reset();
+    count = std::max(count, h.maxId + 1);
+
+    std::vector<ChunkEntry> chunks(h.chunkCount);
+    memcpy(chunks.data(), file->data + h.chunkTableOffset, chunks.size() * sizeof(ChunkEntry));
+    int gen;
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        gen = ++loadGeneration;
+        readyChunks.clear();
+        nextChunk = 0;
+        chunkCount = (int)chunks.size();
+        chunkLayers.clear();
+        for (const ChunkEntry& ce : chunks) chunkLayers.push_back(Layers::At(ce.layer < h.layerCount ? (int)ce.layer : 0).id);
+        loadedStrokes = 0;
+        totalStrokes = h.strokeCount;
+        loadIdLimit = count;
+    }
+
+    // 每块一个任务；任务持有 file，全部解完后映射自动释放
+    for (int c = 0; c < (int)chunks.size(); c++) {
+        ChunkEntry ce = chunks[c];
+        uint32_t version = h.version;
+        ThreadPool::Submit([file, brushMap, ce, c, gen, version] {
+            std::vector<StrokeData> out;
+            if (file->Contains(ce.offset, ce.bytes)) {
+                Reader r{file->data + ce.offset, file->data + ce.offset + ce.bytes};
+                out.resize(ce.count);
+                uint32_t n = 0;
+                while (n < ce.count && DecodeStroke(r, version, brushMap, out[n])) n++;
+                out.resize(n);
+            }
+            std::lock_guard<std::mutex> lock(loadMutex);
+            if (gen == loadGeneration) readyChunks[c] = std::move(out);
+        });
+    }
+    status = chunks.empty() ? "Loaded " + path : "Loading " + path + "...";
+    return true;
+}
+
+// 每帧最多接这么多块，避免一帧里建太多笔画的缓存
+static const int PUMP_CHUNKS_PER_FRAME = 2;
+
+void Document::Pump() {
+    PumpSave();
+    if (nextChunk >= chunkCount) return;
+    // 画到一半时先不接，否则这次编辑的撤销记录会把它们当成新加的笔画
+    if (History::Editing()) return;
+
+    for (int k = 0; k < PUMP_CHUNKS_PER_FRAME && nextChunk < chunkCount; k++) {
+        std::vector<StrokeData> chunk;
+        {
+            std::lock_guard<std::mutex> lock(loadMutex);
+            auto it = readyChunks.find(nextChunk);
+            if (it == readyChunks.end()) break;
+            chunk = std::move(it->second);
+            readyChunks.erase(it);
+        }
+        // 加载期间删掉的图层，它的笔画不用接了
+        Layer* layer = Layers::Find(chunkLayers[nextChunk++]);
+        if (!layer) continue;
+        StrokeStore& strokes = layer->strokes;
+        bool indexed = Layers::IsActive(*layer);
+
+        // 文件里的笔画接在已经加载的部分后面，加载期间新画的笔画保持在最上面
+        size_t pos = strokes.size();
+        while (pos > 0 && strokes.id[pos - 1] >= loadIdLimit) pos--;
+        // 直接接到 arena 和各列末尾，再整块挪到 pos
+        size_t first = strokes.size();
+        for (auto& d : chunk) {
+            size_t i = strokes.Add(d.points.data(), (int)d.points.size(), d.color, d.thickness, d.brush, d.id);
+            strokes.spline[i] = d.spline;
+            strokes.shape[i] = d.shape;
+            strokes.seed[i] = d.seed;
+            strokes.stampBase[i] = d.stampBase;
+            strokes.phase[i] = d.phase;
+            strokes.range[i] = d.range;
+            if (indexed) StrokeIndex::Insert(strokes.View(i));
+        }
+        strokes.MoveTail(first, pos);
+        loadedStrokes += chunk.size();
+    }
+    if (nextChunk >= chunkCount) status = "Loaded " + std::to_string(loadedStrokes) + " strokes";
+}
+
+bool Document::Loading() {
+    return nextChunk < chunkCount;
+}
+
+float Document::LoadProgress() {
+    return totalStrokes ? (float)loadedStrokes / totalStrokes : 1.0f;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+#include "Common.h"
+#include <string>
+
+// 二进制文档（.pdoc）：记录画布尺寸和图层表（名字、不透明度、混合模式、可见性），
+// 每层的底图按 64x64 瓦片压缩（没画过的地方存成全透明瓦片），
+// 笔画点量化到 1/8 像素后差分 + varint 编码，笔刷按名字存在文件自己的名字表里。
+// 只有一层、白底的老版本文件照样能打开，白色的空瓦片当成透明的。
+//
+// 读取：mmap 整个文件，按文件里的尺寸和图层数重建画布，底图当场解出来，笔画按块（CHUNK 笔一块）丢给线程池解码，
+// 主线程每帧 Pump 把解好的块按顺序接到所属图层上，所以打开大文件时画布立刻可用。
+// 保存：主线程只拿快照（撤销历史里有的底图瓦片直接共享，其余的在 GPU 上拷一份、Pump 里过几帧异步读回；
+// 笔画整块拷属性列和点），编码和写盘都在后台线程里流式进行。
+class Document {
+public:
+    static const int CHUNK = 4096;
+
+    static bool Save(const std::string& path); // 上一次还没存完时返回 false
+    static bool Load(const std::string& path);
+    static void Pump(); // 主线程每帧调用：接读好的笔画块，发保存快照的回读
+    static bool Saving();
+    static bool Loading();
+    static float LoadProgress();
+    static std::string status;
+};
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "Exporter.h"
+#include "Compositor.h"
+#include "FloodFill.h"
+#include "Layers.h"
+#include "Renderer.h"
+#include "TileCanvas.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <stb/stb_image_write.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+namespace fs = std::filesystem;
+
+std::string Exporter::status;
+
+static const int TILE = Exporter::TILE;
+
+// 导出开始时的图层快照：底图瓦片还是从 TileCanvas 里取（surface = id）
+struct ExportLayer {
+    int id;
+    float opacity;
+    BlendMode blend;
+    StrokeStore strokes;
+};
+
+// 拼好的整张图；每块的拼图任务完成时减 remaining，最后一块顺手编码
+struct ExportJob {
+    std::string path;
+    int w, h;
+    std::vector<unsigned char> px;
+    std::atomic<int> remaining{0};
+    std::atomic<bool> failed{false}; // 有一块没读回来
+};
+
+static std::vector<ExportLayer> layers;
+static std::shared_ptr<ExportJob> job;
+static float scale = 1.0f;
+static int tilesX = 0, tileCount = 0, nextTile = 0, collected = 0;
+static GLuint target = 0, layerTarget = 0; // 合成结果 / 单个图层
+static ImDrawList* list = nullptr;
+static std::atomic<bool> encoding{false};
+static std::atomic<bool> encodeOk{false};
+
+static void Attach(GLuint tex) {
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer::fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+}
+
+// .rgba / .raw 存成不带文件头的 RGBA 字节（自上而下，宽高见状态栏），其余存 PNG
+static bool RawPath(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    return ext == ".rgba" || ext == ".raw";
+}
+
+static void Encode(const std::shared_ptr<ExportJob>& j) {
+    PROFILE_SCOPE("Exporter::Encode");
+    std::string tmp = j->path + ".tmp";
+    bool ok = !j->failed;
+    if (ok && RawPath(j->path)) {
+        std::ofstream out(tmp, std::ios::binary);
+        ok = (bool)out.write((const char*)j->px.data(), (std::streamsize)j->px.size());
+    } else if (ok) {
+        ok = stbi_write_png(tmp.c_str(), j->w, j->h, 4, j->px.data(), j->w * 4) != 0;
+    }
+    std::error_code ec;
+    if (ok) fs::rename(tmp, j->path, ec);
+    ok = ok && !ec;
+    std::cout << (ok ? "Exported " : "Failed to export ") << j->path << std::endl;
+    encodeOk = ok;
+    encoding = false;
+}
+
+bool Exporter::Start(const std::string& path, float s) {
+    if (Busy()) return false;
+    if (Renderer::backend != BakeBackend::OpenGL) {
+        status = "Export needs the OpenGL backend";
+        return false;
+    }
+    // 填到一半的油漆桶填完会改底图
+    if (FloodFill::Busy()) {
+        status = "Wait for the fill to finish";
+        return false;
+    }
+    s = std::clamp(s, 0.125f, 16.0f);
+    int w = (int)ceilf(canvasW * s), h = (int)ceilf(canvasH * s);
+    if ((size_t)w * h > MAX_PIXELS) {
+        status = "Export too large: " + std::to_string(w) + " x " + std::to_string(h);
+        return false;
+    }
+
+    // 只拷属性列和点，渲染缓存导出时按需重建
+    layers.clear();
+    for (int k = 0; k < Layers::Count(); k++) {
+        Layer& l = Layers::At(k);
+        if (!l.visible) continue;
+        std::shared_ptr<StrokeSnapshot> snap = l.strokes.Snapshot();
+        l.strokes.CopySnapshot(SIZE_MAX);
+        layers.push_back({l.id, l.opacity, l.blend, std::move(snap->strokes)});
+    }
+    job = std::make_shared<ExportJob>();
+    job->path = path;
+    job->w = w;
+    job->h = h;
+    job->px.resize((size_t)w * h * 4);
+    scale = s;
+    tilesX = (w + TILE - 1) / TILE;
+    tileCount = tilesX * ((h + TILE - 1) / TILE);
+    job->remaining = tileCount;
+    nextTile = collected = 0;
+    encoding = true;
+
+    if (!list) {
+        list = new ImDrawList(ImGui::GetDrawListSharedData());
+        target = Renderer::CreateTexture(TILE, TILE, nullptr);
+        layerTarget = Renderer::CreateTexture(TILE, TILE, nullptr);
+    }
+    status = "Exporting " + std::to_string(w) + " x " + std::to_string(h) + "...";
+    return true;
+}
+
+// 放大时线性采样会越过瓦片边，直接画瓦片纹理的话边上按 CLAMP_TO_EDGE 只取到自己，每隔 256 * scale 个输出像素一条缝。
+// 所以先把瓦片连同四周邻居挨着的 1 像素拷进 apron 图集的一格，再从格子里画瓦片本身那块
+static const int APRON_SLOTS = 4; // 图集每边几格
+static GLuint apron = 0, readFbo = 0;
+
+// 一个方向上 3 段里第 d 段（-1 / 0 / 1，纹理坐标方向）在源纹理里的起点和长度、在格子里的起点；
+// own 表示画布外面没有邻居，取瓦片自己的边，和 CLAMP 一样
+static void ApronSpan(int d, bool own, int& src, int& len, int& dst) {
+    const int CT = TileCanvas::TILE;
+    len = d ? 1 : CT;
+    if (d < 0) src = own ? 0 : CT - 1, dst = 0;
+    else if (d > 0) src = own ? CT - 1 : 0, dst = CT + 1;
+    else src = 0, dst = 1;
+}
+
+// 把瓦片 (tx, ty) 拷进第 slot 格，返回瓦片本身在图集里的 UV（v 已翻过来）
+static void StageTile(int tx, int ty, GLuint tex, int slot, ImVec2& uv0, ImVec2& uv1) {
+    const int CT = TileCanvas::TILE, S = CT + 2;
+    const float A = (float)(APRON_SLOTS * S);
+    int ox = (slot % APRON_SLOTS) * S, oy = (slot / APRON_SLOTS) * S;
+    static std::vector<unsigned char> zeros((size_t)CT * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+    glBindTexture(GL_TEXTURE_2D, apron);
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int nx = tx + dx, ny = ty + dy;
+            bool ownX = nx < 0 || nx >= TileCanvas::TilesX(), ownY = ny < 0 || ny >= TileCanvas::TilesY();
+            if (ownX) nx = tx;
+            if (ownY) ny = ty;
+            // 纹理自下而上：画布上方的邻居在纹理坐标的 +v 方向
+            int sx, w, x, sy, h, y;
+            ApronSpan(dx, ownX, sx, w, x);
+            ApronSpan(-dy, ownY, sy, h, y);
+            GLuint src = nx == tx && ny == ty ? tex : TileCanvas::Texture(nx, ny, true);
+            if (!src) {
+                // 没画过的邻居是透明的
+                glTexSubImage2D(GL_TEXTURE_2D, 0, ox + x, oy + y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, zeros.data());
+                continue;
+            }
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src, 0);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, ox + x, oy + y, sx, sy, w, h);
+        }
+    }
+    uv0 = {(ox + 1) / A, (oy + 1 + CT) / A};
+    uv1 = {(ox + 1 + CT) / A, (oy + 1) / A};
+}
+
+// 一个图层在这块输出上的样子，画在透明的 layerTarget 上：放大的底图瓦片 + 按矢量重画的笔画
+static bool RenderLayer(const ExportLayer& l, ImVec2 origin) {
+    const int CT = TileCanvas::TILE;
+    ImVec2 cmin = {origin.x / scale, origin.y / scale}, cmax = {(origin.x + TILE) / scale, (origin.y + TILE) / scale};
+    if (!apron) {
+        apron = Renderer::CreateTexture(APRON_SLOTS * (CT + 2), APRON_SLOTS * (CT + 2), nullptr);
+        glGenFramebuffers(1, &readFbo);
+    }
+    Attach(layerTarget);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    Renderer::BeginTile(list, origin, TILE);
+    TileCanvas::Select(l.id);
+    int tx0 = std::max(0, (int)floorf(cmin.x / CT)), ty0 = std::max(0, (int)floorf(cmin.y / CT));
+    int tx1 = std::min(TileCanvas::TilesX() - 1, (int)floorf(cmax.x / CT)), ty1 = std::min(TileCanvas::TilesY() - 1, (int)floorf(cmax.y / CT));
+    bool any = false;
+    int slot = 0;
+    Compositor::AddBlend(list, BlendMode::Normal);
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            GLuint tex = TileCanvas::Texture(tx, ty, true);
+            if (!tex) continue;
+            // 图集用满了：先把已经排好的画掉，格子腾出来
+            if (slot == APRON_SLOTS * APRON_SLOTS) {
+                Attach(layerTarget);
+                Renderer::RenderTile(list, origin, TILE);
+                Renderer::BeginTile(list, origin, TILE);
+                Compositor::AddBlend(list, BlendMode::Normal);
+                slot = 0;
+            }
+            // 瓦片是预乘的，互不重叠
+            ImVec2 uv0, uv1;
+            StageTile(tx, ty, tex, slot++, uv0, uv1);
+            ImVec2 a = {tx * CT * scale, ty * CT * scale};
+            list->AddImage((ImTextureID)(intptr_t)apron, a, {a.x + CT * scale, a.y + CT * scale}, uv0, uv1);
+            any = true;
+        }
+    }
+    list->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    const StrokeStore& st = l.strokes;
+    for (size_t i = 0; i < st.size(); i++) {
+        if (st.Count(i) < 2) continue;
+        EnsureStrokeCache(st, i);
+        if (st.Cache(i).stamps.empty()) continue;
+        // 双线性采样可能多碰到 1 像素
+        if (st.boundsMax[i].x + 1 < cmin.x || st.boundsMin[i].x - 1 > cmax.x || st.boundsMax[i].y + 1 < cmin.y ||
+            st.boundsMin[i].y - 1 > cmax.y)
+            continue;
+        Renderer::DrawStroke(list, st, i, ImVec2(0, 0), scale);
+        any = true;
+    }
+    if (!any) return false;
+    Attach(layerTarget);
+    Renderer::RenderTile(list, origin, TILE);
+    return true;
+}
+
+// 拼进整张图：FBO 是自下而上的，回读的第 k 行是这块输出的第 h - 1 - k 行
+static void Place(const std::shared_ptr<ExportJob>& j, const std::vector<unsigned char>& raw, int x, int y, int w, int h) {
+    for (int r = 0; r < h; r++)
+        memcpy(&j->px[((size_t)(y + r) * j->w + x) * 4], &raw[(size_t)(h - 1 - r) * w * 4], (size_t)w * 4);
+}
+
+// 画第 t 块并发起异步回读；读回来的块拷出来交给线程池拼图，最后一块顺手编码
+static void RenderExportTile(int t) {
+    PROFILE_SCOPE("Exporter::RenderTile");
+    int x = (t % tilesX) * TILE, y = (t / tilesX) * TILE;
+    int w = std::min(TILE, job->w - x), h = std::min(TILE, job->h - y);
+    ImVec2 origin = {(float)x, (float)y};
+
+    Attach(target);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(1, 1, 1, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    for (const ExportLayer& l : layers) {
+        if (!RenderLayer(l, origin)) continue;
+        Attach(target);
+        Renderer::BeginTile(list, origin, TILE);
+        Compositor::AddBlend(list, l.blend);
+        int o = (int)(l.opacity * 255.0f + 0.5f);
+        list->AddImage((ImTextureID)(intptr_t)layerTarget, origin, {origin.x + TILE, origin.y + TILE}, {0, 1}, {1, 0},
+                       IM_COL32(o, o, o, o));
+        Renderer::RenderTile(list, origin, TILE);
+    }
+
+    // 这块输出的第 0 行在纹理的第 TILE - 1 行，只读有用的 w x h
+    Attach(target);
+    std::shared_ptr<ExportJob> j = job;
+    auto done = [j, x, y](const unsigned char* rgba, int w, int h) {
+        collected++;
+        auto raw = std::make_shared<std::vector<unsigned char>>((size_t)w * h * 4);
+        if (rgba) memcpy(raw->data(), rgba, raw->size());
+        else j->failed = true;
+        ThreadPool::Submit([j, raw, x, y, w, h] {
+            Place(j, *raw, x, y, w, h);
+            if (--j->remaining == 0) Encode(j);
+        });
+    };
+    if (!Renderer::ReadAsync(0, TILE - h, w, h, done)) done(nullptr, w, h);
+}
+
+void Exporter::Pump() {
+    if (!job) return;
+    if (nextTile < tileCount) {
+        PROFILE_SCOPE("Exporter::Pump");
+        // 回读槽满了（GPU 还没跟上）就下一帧再画，不在这里等
+        for (int k = 0; k < TILES_PER_FRAME && nextTile < tileCount; k++) {
+            if (Renderer::ReadbacksPending() >= Renderer::READBACK_SLOTS) break;
+            RenderExportTile(nextTile++);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        Layers::Bind(Layers::Active());
+        if (nextTile == tileCount) layers.clear();
+        return;
+    }
+    if (collected < tileCount || encoding) return; // 回读在 Renderer::EndFrame 里收
+    status = encodeOk ? "Exported " + job->path : "Failed to export " + job->path;
+    if (encodeOk && RawPath(job->path)) status += " (" + std::to_string(job->w) + " x " + std::to_string(job->h) + " RGBA)";
+    job.reset();
+}
+
+bool Exporter::Busy() {
+    return job != nullptr;
+}
+
+float Exporter::Progress() {
+    return tileCount ? (float)collected / tileCount : 1.0f;
+}
\ No newline at end of file
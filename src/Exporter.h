@@ -0,0 +1,22 @@
+#pragma once
+#include "Common.h"
+#include <string>
+
+// 高分辨率导出（GL 后端）：按 scale 倍把可见图层重新画一遍存成 PNG（路径是 .rgba / .raw 时存裸 RGBA）。未烘焙的笔画按矢量重画，
+// 底图瓦片按比例放大。输出切成 TILE x TILE 的块，在同一对离屏纹理上逐块渲染，显存占用和输出尺寸无关；
+// 每块画完后交给 Renderer::ReadAsync 异步回读，回读槽满了就等下一帧再画，拼图和编码都在线程池里做，界面不卡。
+// 每块都按输出像素的绝对坐标画完整的印章，跨块的印章在两边光栅化出来是一样的，没有接缝。
+// 开始时拷一份各图层的笔画（只拷属性列和点），导出期间接着画也不影响结果；底图瓦片不拷，所以导出期间
+// 会改底图的操作（烘焙、自动烘焙、清空、撤销 / 重做、油漆桶、打开、新画布）都停用，等导出完。
+class Exporter {
+public:
+    static const int TILE = 1024;
+    static const int TILES_PER_FRAME = 2;
+    static const size_t MAX_PIXELS = (size_t)1 << 28; // 整张图要在内存里拼好再编码
+
+    static bool Start(const std::string& path, float scale); // 正在导出或者太大时返回 false
+    static void Pump(); // 主线程每帧调用
+    static bool Busy();
+    static float Progress();
+    static std::string status;
+};
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "FloodFill.h"
+#include "History.h"
+#include "Layers.h"
+#include "TileCanvas.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FILL_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+int FloodFill::tolerance = 32;
+float FloodFill::latencyMs = 0.0f;
+float FloodFill::fillMs = 0.0f;
+std::string FloodFill::status;
+
+using Clock = std::chrono::steady_clock;
+
+static const int CT = TileCanvas::TILE;
+enum : uint8_t { OUT = 0, IN = 1, FILLED = 2, UNREAD = 3 };          // 每个像素
+enum : uint8_t { TILE_UNREAD = 0, TILE_READING = 1, TILE_READ = 2, TILE_BLANK = 3 }; // 每块瓦片
+
+struct Seed { int x, y; };
+
+// 填充碰到的一块瓦片
+struct TileBuf {
+    int w, h;
+    std::unique_ptr<unsigned char[]> px;  // w x h，自上而下；没画过的瓦片为空，当全透明
+    std::unique_ptr<uint8_t[]> mask;      // CT x CT，每个像素 OUT / IN / FILLED
+    std::unique_ptr<unsigned char[]> out; // 填完后叠好颜色的 w x h，写回用
+    bool filled = false;
+};
+
+// 一次填充。底图按 TileCanvas 的瓦片读，只读填充碰到的：线程池一轮填到碰上没读的瓦片为止，
+// 主线程把这些瓦片读来（History 知道的直接拷，其余异步回读）再接着下一轮
+struct FillJob {
+    int layer, w, h, seedX, seedY, tolerance;
+    ImU32 rgba;        // 原样记下，图层中途被改了照它重新开始
+    uint8_t color[4];  // 预乘
+    uint8_t seed[4];
+    uint64_t generation; // 开始时图层底图的版本
+    int tilesX, tilesY, tilesRead = 0;
+    std::vector<std::unique_ptr<TileBuf>> buf; // 按瓦片编号，只有读来的和填到的没画过的瓦片才分配，不按整张画布开
+    uint8_t blankRow[CT];          // 没画过、还没分配的瓦片每行的掩码，全是同一个值
+    std::vector<uint8_t> tiles;    // 每块瓦片 TILE_*
+    std::vector<int> fresh;        // 上一轮之后读来的瓦片，下一轮先标记
+    std::vector<int> wanted;       // 要读、还没发出去的瓦片
+    std::vector<Seed> blocked;     // 停在没读的瓦片上的种子，读来后接着填
+    int reading = 0;               // 在路上的回读
+    bool started = false, finished = false, failed = false;
+    int x0, y0, x1, y1; // 包围矩形（含两端）
+    size_t filled = 0;
+    float fillMs = 0.0f;
+    Clock::time_point start;
+    std::atomic<bool> running{false};
+};
+
+static std::shared_ptr<FillJob> job;
+
+// 和种子颜色每个通道都差不超过 tol 的像素记 1，其余记 0
+static void MarkRow(const unsigned char* row, int w, const uint8_t seed[4], int tol, uint8_t* out) {
+    int x = 0;
+#ifdef FILL_USE_SSE
+    int32_t s32;
+    memcpy(&s32, seed, 4);
+    __m128i s = _mm_set1_epi32(s32), t = _mm_set1_epi8((char)tol), zero = _mm_setzero_si128(), ones = _mm_set1_epi32(-1);
+    for (; x + 4 <= w; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(row + (size_t)x * 4));
+        // 两个方向各做一次饱和减法再取或就是 |p - s|，再减掉 tol 还剩下的通道超出了容差
+        __m128i d = _mm_or_si128(_mm_subs_epu8(p, s), _mm_subs_epu8(s, p));
+        __m128i in = _mm_cmpeq_epi8(_mm_subs_epu8(d, t), zero);
+        int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(in, ones)));
+        out[x] = m & 1;
+        out[x + 1] = (m >> 1) & 1;
+        out[x + 2] = (m >> 2) & 1;
+        out[x + 3] = (m >> 3) & 1;
+    }
+#endif
+    for (; x < w; x++) {
+        const unsigned char* p = row + (size_t)x * 4;
+        bool in = true;
+        for (int c = 0; c < 4; c++) in = in && abs(p[c] - seed[c]) <= tol;
+        out[x] = in;
+    }
+}
+
+static TileBuf& NewTileBuf(FillJob& j, int t, bool withPx) {
+    auto b = std::make_unique<TileBuf>();
+    b->w = std::min(CT, j.w - (t % j.tilesX) * CT);
+    b->h = std::min(CT, j.h - (t / j.tilesX) * CT);
+    if (withPx) b->px.reset(new unsigned char[(size_t)b->w * b->h * 4]);
+    b->mask.reset(new uint8_t[(size_t)CT * CT]);
+    j.buf[t] = std::move(b);
+    return *j.buf[t];
+}
+
+// 新读来的瓦片按种子颜色标 IN / OUT
+static void MarkTile(FillJob& j, int t) {
+    TileBuf& b = *j.buf[t];
+    for (int r = 0; r < b.h; r++) MarkRow(&b.px[(size_t)r * b.w * 4], b.w, j.seed, j.tolerance, &b.mask[(size_t)r * CT]);
+}
+
+// (x, y) 这一行在所在瓦片里的掩码，下标是 x % CT；没画过的瓦片没分配时是 blankRow，还没读来的为空
+static const uint8_t* MaskRow(const FillJob& j, int x, int y) {
+    int t = (y / CT) * j.tilesX + x / CT;
+    if (const TileBuf* b = j.buf[t].get()) return &b->mask[(size_t)(y % CT) * CT];
+    return j.tiles[t] == TILE_BLANK ? j.blankRow : nullptr;
+}
+
+static uint8_t MaskAt(const FillJob& j, int x, int y) {
+    const uint8_t* m = MaskRow(j, x, y);
+    return m ? m[x % CT] : (uint8_t)UNREAD;
+}
+
+// (x, y) 的值是 v，从它往右（dir = 1）或往左（dir = -1）到 limit 为止都是 v 的一段，返回另一头的 x。按瓦片一段段扫
+static int RunEnd(const FillJob& j, int x, int y, uint8_t v, int limit, int dir) {
+    for (;;) {
+        const uint8_t* m = MaskRow(j, x, y);
+        int edge = dir > 0 ? std::min(limit, (x / CT) * CT + CT - 1) : std::max(limit, (x / CT) * CT);
+        if (!m) x = edge; // 没读的瓦片整块都是 UNREAD
+        while (x != edge && m[(x + dir) % CT] == v) x += dir;
+        if (x != edge || x == limit || MaskAt(j, x + dir, y) != v) return x;
+        x += dir;
+    }
+}
+
+// 把 y 行的 [l, r] 标成 FILLED；没画过的瓦片这时才分配掩码
+static void FillRun(FillJob& j, int l, int r, int y) {
+    for (int x = l; x <= r;) {
+        int t = (y / CT) * j.tilesX + x / CT, e = std::min(r, (x / CT) * CT + CT - 1);
+        TileBuf* b = j.buf[t].get();
+        if (!b) {
+            b = &NewTileBuf(j, t, false);
+            memset(b->mask.get(), j.blankRow[0], (size_t)CT * CT);
+        }
+        memset(&b->mask[(size_t)(y % CT) * CT + x % CT], FILLED, (size_t)(e - x + 1));
+        b->filled = true;
+        x = e + 1;
+    }
+}
+
+static void Want(FillJob& j, int x, int y) {
+    int t = (y / CT) * j.tilesX + x / CT;
+    if (j.tiles[t] != TILE_UNREAD) return;
+    j.tiles[t] = TILE_READING;
+    j.wanted.push_back(t);
+}
+
+// 没画过的瓦片改之前的内容
+static const unsigned char* Transparent() {
+    static const std::vector<unsigned char> zero((size_t)CT * CT * 4, 0);
+    return zero.data();
+}
+
+// 填到的瓦片各拷一份，填到的像素按预乘 alpha 叠上颜色：底色乘 (1 - a) 查表，不透明时直接写颜色
+static void Composite(FillJob& j) {
+    int inv = 255 - j.color[3];
+    uint8_t keep[256];
+    for (int v = 0; v < 256; v++) keep[v] = (uint8_t)((v * inv + 127) / 255);
+    uint32_t solid;
+    memcpy(&solid, j.color, 4);
+    for (auto& p : j.buf) {
+        if (!p || !p->filled) continue;
+        TileBuf& b = *p;
+        int bw = b.w;
+        b.out.reset(new unsigned char[(size_t)b.w * b.h * 4]);
+        for (int y = 0; y < b.h; y++) {
+            const uint8_t* m = &b.mask[(size_t)y * CT];
+            const unsigned char* src = b.px ? &b.px[(size_t)y * bw * 4] : Transparent();
+            unsigned char* dst = &b.out[(size_t)y * bw * 4];
+            if (inv == 0) {
+                for (int x = 0; x < bw; x++) {
+                    uint32_t v;
+                    memcpy(&v, src + x * 4, 4);
+                    v = m[x] == FILLED ? solid : v;
+                    memcpy(dst + x * 4, &v, 4);
+                }
+                continue;
+            }
+            memcpy(dst, src, (size_t)bw * 4);
+            for (int x = 0; x < bw; x++) {
+                if (m[x] != FILLED) continue;
+                for (int c = 0; c < 4; c++) dst[x * 4 + c] = (unsigned char)(j.color[c] + keep[dst[x * 4 + c]]);
+            }
+        }
+    }
+}
+
+// 一轮扫描线填充：每次从栈里取一个点，向左右扩成一整段，再把上下两行在这段范围内的每个可填（或没读）区间各压一个点。
+// 碰到没读的瓦片就把点记进 blocked、瓦片记进 wanted，等主线程读来再下一轮
+static void Round(FillJob& j) {
+    PROFILE_SCOPE("FloodFill::Fill");
+    auto t0 = Clock::now();
+    int w = j.w, h = j.h;
+    std::vector<Seed> stack;
+    if (!j.started) {
+        const TileBuf* b = j.buf[(j.seedY / CT) * j.tilesX + j.seedX / CT].get();
+        if (b) memcpy(j.seed, &b->px[((size_t)(j.seedY % CT) * b->w + j.seedX % CT) * 4], 4);
+        else memset(j.seed, 0, 4); // 种子在没画过的瓦片里
+        bool blankIn = j.seed[0] <= j.tolerance && j.seed[1] <= j.tolerance && j.seed[2] <= j.tolerance && j.seed[3] <= j.tolerance;
+        memset(j.blankRow, blankIn ? IN : OUT, CT);
+        j.x0 = j.x1 = j.seedX;
+        j.y0 = j.y1 = j.seedY;
+        stack.push_back({j.seedX, j.seedY});
+        j.started = true;
+    }
+    for (int t : j.fresh) MarkTile(j, t);
+    j.fresh.clear();
+    stack.insert(stack.end(), j.blocked.begin(), j.blocked.end());
+    j.blocked.clear();
+
+    while (!stack.empty()) {
+        Seed s = stack.back();
+        stack.pop_back();
+        uint8_t at = MaskAt(j, s.x, s.y);
+        if (at == UNREAD) {
+            j.blocked.push_back(s);
+            Want(j, s.x, s.y);
+            continue;
+        }
+        if (at != IN) continue;
+        int l = RunEnd(j, s.x, s.y, IN, 0, -1), r = RunEnd(j, s.x, s.y, IN, w - 1, 1);
+        // 段的两头碰到没读的瓦片，那边可能还能接着填
+        if (l > 0 && MaskAt(j, l - 1, s.y) == UNREAD) stack.push_back({l - 1, s.y});
+        if (r + 1 < w && MaskAt(j, r + 1, s.y) == UNREAD) stack.push_back({r + 1, s.y});
+        FillRun(j, l, r, s.y);
+        j.filled += r - l + 1;
+        j.x0 = std::min(j.x0, l);
+        j.x1 = std::max(j.x1, r);
+        j.y0 = std::min(j.y0, s.y);
+        j.y1 = std::max(j.y1, s.y);
+        for (int ny : {s.y - 1, s.y + 1}) {
+            if (ny < 0 || ny >= h) continue;
+            for (int x = l; x <= r;) {
+                uint8_t v = MaskAt(j, x, ny);
+                if (v == IN || v == UNREAD) stack.push_back({x, ny});
+                x = RunEnd(j, x, ny, v, r, 1) + 1;
+            }
+        }
+    }
+
+    // 填完了。只写回填到的瓦片，所以包围矩形里其余没读的瓦片不用再读
+    if (j.blocked.empty()) {
+        Composite(j);
+        j.finished = true;
+    }
+    j.fillMs += std::chrono::duration<float, std::milli>(Clock::now() - t0).count();
+}
+
+// 没画过的瓦片是透明的，不用读，填到时才分配；种子所在的瓦片先要读来才知道种子颜色
+static std::shared_ptr<FillJob> NewJob(const Layer& layer, int x, int y, ImU32 color, int tol, Clock::time_point start) {
+    auto j = std::make_shared<FillJob>();
+    j->start = start;
+    j->layer = layer.id;
+    j->w = canvasW;
+    j->h = canvasH;
+    j->seedX = x;
+    j->seedY = y;
+    j->tolerance = tol;
+    j->rgba = color;
+    // ImU32 是 ABGR，底图是预乘的 RGBA
+    int a = (int)(color >> IM_COL32_A_SHIFT) & 0xFF;
+    for (int c = 0; c < 3; c++) j->color[c] = (uint8_t)((((color >> (8 * c)) & 0xFF) * a + 127) / 255);
+    j->color[3] = (uint8_t)a;
+    j->generation = TileCanvas::Generation(layer.id);
+    j->tilesX = TileCanvas::TilesX();
+    j->tilesY = TileCanvas::TilesY();
+    j->buf.resize((size_t)j->tilesX * j->tilesY);
+    j->tiles.assign((size_t)j->tilesX * j->tilesY, TILE_UNREAD);
+    Layers::Bind(layer);
+    for (int t = 0; t < (int)j->tiles.size(); t++)
+        if (!TileCanvas::Painted(t % j->tilesX, t / j->tilesX)) j->tiles[t] = TILE_BLANK;
+    Layers::Bind(Layers::Active());
+    Want(*j, x, y);
+    return j;
+}
+
+// 把 wanted 里的瓦片各读进自己的缓冲：History 知道内容的直接拷，其余异步回读，回读槽满了剩下的留到下一帧
+static void Request(const std::shared_ptr<FillJob>& j, const Layer& layer) {
+    PROFILE_SCOPE("FloodFill::Request");
+    Layers::Bind(layer);
+    size_t k = 0;
+    for (; k < j->wanted.size(); k++) {
+        int t = j->wanted[k];
+        int x = (t % j->tilesX) * CT, y = (t / j->tilesX) * CT, w = std::min(CT, j->w - x), h = std::min(CT, j->h - y);
+        auto arrived = [j, t] {
+            j->tiles[t] = TILE_READ;
+            j->fresh.push_back(t);
+            j->tilesRead++;
+        };
+        TileBuf& b = NewTileBuf(*j, t, true);
+        if (History::Known(j->layer, x, y, w, h, b.px.get(), (size_t)w * 4)) {
+            arrived();
+            continue;
+        }
+        j->reading++;
+        bool ok = TileCanvas::ReadAsync(t % j->tilesX, t / j->tilesX, [j, t, w, h, arrived](const unsigned char* rgba) {
+            j->reading--;
+            if (!rgba) {
+                j->failed = true;
+                return;
+            }
+            for (int r = 0; r < h; r++) memcpy(&j->buf[t]->px[(size_t)r * w * 4], rgba + (size_t)r * CT * 4, (size_t)w * 4);
+            arrived();
+        });
+        if (!ok) {
+            j->reading--;
+            break;
+        }
+    }
+    j->wanted.erase(j->wanted.begin(), j->wanted.begin() + k);
+    Layers::Bind(Layers::Active());
+}
+
+bool FloodFill::Start(const Layer& layer, ImVec2 pos, ImU32 color) {
+    int x = (int)floorf(pos.x), y = (int)floorf(pos.y);
+    if (job || x < 0 || y < 0 || x >= canvasW || y >= canvasH) return false;
+    PROFILE_SCOPE("FloodFill::Start");
+    job = NewJob(layer, x, y, color, std::clamp(tolerance, 0, 255), Clock::now());
+    Pump();
+    return true;
+}
+
+// 每帧推进一步：发还没发出去的回读；读齐了交给线程池填下一轮；填完了写回
+void FloodFill::Pump() {
+    if (!job || job->running) return;
+    std::shared_ptr<FillJob> j = job;
+    // 填的途中换了画布、删了这一层或者读失败就作废
+    Layer* layer = Layers::Find(j->layer);
+    if (!layer || j->w != canvasW || j->h != canvasH || j->failed) {
+        job.reset();
+        status = "Fill discarded";
+        return;
+    }
+    // 这一层的底图在途中被改过（撤销、重做、自动烘焙、清空……），手上读到的已经过时，从头再来
+    if (TileCanvas::Generation(j->layer) != j->generation) {
+        job = NewJob(*layer, j->seedX, j->seedY, j->rgba, j->tolerance, j->start);
+        Request(job, *layer);
+        status = "Layer changed, fill restarted";
+        return;
+    }
+    if (!j->wanted.empty()) Request(j, *layer);
+    if (j->reading > 0 || !j->wanted.empty()) return;
+    if (!j->finished) {
+        j->running = true;
+        ThreadPool::Submit([j] {
+            Round(*j);
+            j->running = false;
+        });
+        return;
+    }
+
+    job.reset();
+    PROFILE_SCOPE("FloodFill::Pump");
+    int bw = j->x1 - j->x0 + 1, bh = j->y1 - j->y0 + 1;
+    std::vector<History::Patch> patches;
+    for (int t = 0; t < (int)j->buf.size(); t++) {
+        const TileBuf* b = j->buf[t].get();
+        if (!b || !b->filled) continue;
+        patches.push_back({(t % j->tilesX) * CT, (t / j->tilesX) * CT, b->w, b->h, b->out.get(),
+                           b->px ? b->px.get() : Transparent()});
+    }
+    History::Paint(*layer, patches);
+    fillMs = j->fillMs;
+    latencyMs = std::chrono::duration<float, std::milli>(Clock::now() - j->start).count();
+    PROFILE_COUNTER("fill px", j->filled);
+    status = "Filled " + std::to_string(j->filled) + " px (" + std::to_string(bw) + " x " + std::to_string(bh) + "), read " +
+             std::to_string(j->tilesRead) + " tiles";
+}
+
+bool FloodFill::Busy() {
+    return job != nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+#include "Common.h"
+#include <string>
+
+struct Layer;
+
+// 油漆桶：只看当前图层的底图（未烘焙的笔画既不挡边界也不会被填）。
+// 底图按 TileCanvas 的瓦片读，只读填充碰得到的：没画过的瓦片是透明的不用读，History 知道内容的瓦片直接拷，
+// 其余用异步回读，主线程不等 GPU。扫描线填充丢给线程池：先用 SSE2 一次比 4 个像素，把和种子颜色每个通道都差不超过
+// tolerance 的像素标出来，再按区间（span）逐行扩展；碰到还没读的瓦片就停下，读来以后下一轮接着填。
+// 填完后主线程 Pump 只把填到的包围矩形写回底图（TileCanvas::Write -> glTexSubImage2D），记成一条撤销记录。
+// 途中这一层的底图被改过（TileCanvas::Generation 变了）就从头重填，不会把过时的内容写回去。
+// 颜色按预乘 alpha 叠在原来的像素上，不透明的颜色就是直接替换
+class FloodFill {
+public:
+    static int tolerance;    // 0..255
+    static float latencyMs;  // 上一次从点击到写回的总耗时
+    static float fillMs;     // 其中线程池里标记 + 填充的耗时
+    static std::string status;
+
+    static bool Start(const Layer& layer, ImVec2 pos, ImU32 color); // 点在画布外或上一次还没填完时返回 false
+    static void Pump(); // 主线程每帧调用
+    static bool Busy();
+};
\ No newline at end of file
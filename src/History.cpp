@@ -0,0 +1,490 @@
+#include "History.h"
+#include "Layers.h"
+#include "Renderer.h"
+#include "StrokeIndex.h"
+#include "CanvasLogic.h"
+#include "TileCanvas.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cfloat>
+
+size_t History::memoryCap = (size_t)256 << 20;
+std::deque<History::Entry> History::undoStack;
+std::vector<History::Entry> History::redoStack;
+std::unordered_map<int64_t, History::TilePtr> History::known;
+size_t History::tileBytes = 0;
+size_t History::strokeBytes = 0;
+
+// 画布大小可变，瓦片行列数每次现算
+static int TilesX() { return (canvasW + History::TILE - 1) / History::TILE; }
+static int TilesY() { return (canvasH + History::TILE - 1) / History::TILE; }
+
+// 正在进行的编辑：开始时的笔画 id 顺序，以及期间删掉的笔画副本
+static bool editing = false;
+static int editLayer = -1;
+static std::vector<int> editIds;
+static std::unordered_map<int, Stroke> editRemoved;
+
+History::Tile::Tile(int w, int h) : w(w), h(h), rgba((size_t)w * h * 4) { tileBytes += rgba.size(); }
+History::Tile::~Tile() { tileBytes -= rgba.size(); }
+
+// known 按 (图层, 瓦片) 区分；瓦片读写都作用在 TileCanvas 选中的图层上
+static int64_t KnownKey(int surface, int tile) {
+    return ((int64_t)surface << 32) | (uint32_t)tile;
+}
+
+static int64_t KnownKey(int tile) {
+    return KnownKey(TileCanvas::Selected(), tile);
+}
+
+// 撤销/重做途中临时切到记录所在的图层，结束时切回当前层
+struct BindLayer {
+    explicit BindLayer(const Layer& l) { Layers::Bind(l); }
+    ~BindLayer() { Layers::Bind(Layers::Active()); }
+};
+
+static size_t StrokeBytes(const Stroke& s) {
+    return sizeof(Stroke) + s.points.capacity() * sizeof(ImVec2);
+}
+
+void History::TileRect(int tile, int& x, int& y, int& w, int& h) {
+    x = (tile % TilesX()) * TILE;
+    y = (tile / TilesX()) * TILE;
+    w = std::min(TILE, canvasW - x);
+    h = std::min(TILE, canvasH - y);
+}
+
+// 取 [tx0, tx1] x [ty0, ty1] 范围内瓦片的当前内容，按行优先放进 out；给了 mask（同样按行优先）时只取 mask 里的，其余为空。
+// useKnown 时已知的瓦片直接共享，只有未知的才回读（每行瓦片把要读的那一段一次读回）
+void History::CaptureTiles(int tx0, int ty0, int tx1, int ty1, bool useKnown, std::vector<TilePtr>& out,
+                           const std::vector<char>* mask) {
+    out.clear();
+    std::vector<unsigned char> strip;
+    size_t k = 0;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        size_t rowStart = out.size();
+        int need0 = INT_MAX, need1 = -1;
+        for (int tx = tx0; tx <= tx1; tx++, k++) {
+            int t = ty * TilesX() + tx;
+            out.push_back(nullptr);
+            if (mask && !(*mask)[k]) continue;
+            auto it = useKnown ? known.find(KnownKey(t)) : known.end();
+            if (it != known.end()) out.back() = it->second;
+            else need0 = std::min(need0, tx), need1 = std::max(need1, tx);
+        }
+        if (need1 < 0) continue;
+
+        int x0 = need0 * TILE, y0 = ty * TILE;
+        int rw = std::min((need1 + 1) * TILE, canvasW) - x0, rh = std::min(TILE, canvasH - y0);
+        strip.resize((size_t)rw * rh * 4);
+        Renderer::ReadRegion(x0, y0, rw, rh, strip.data());
+        for (int tx = need0; tx <= need1; tx++) {
+            TilePtr& slot = out[rowStart + (tx - tx0)];
+            if (slot || (mask && !(*mask)[rowStart + (tx - tx0)])) continue;
+            int t = ty * TilesX() + tx, x, y, w, h;
+            TileRect(t, x, y, w, h);
+            auto tile = std::make_shared<Tile>(w, h);
+            for (int r = 0; r < h; r++)
+                memcpy(&tile->rgba[(size_t)r * w * 4], &strip[((size_t)r * rw + (x - x0)) * 4], (size_t)w * 4);
+            known[KnownKey(t)] = tile;
+            slot = std::move(tile);
+        }
+    }
+}
+
+void History::ApplyTiles(const Entry& e, bool after) {
+    for (const auto& te : e.tiles) {
+        const TilePtr& p = after ? te.after : te.before;
+        int x, y, w, h;
+        TileRect(te.tile, x, y, w, h);
+        Renderer::WriteRegion(x, y, w, h, p->rgba.data());
+        known[KnownKey(te.tile)] = p;
+    }
+}
+
+// 先按下标删掉 remove，再按下标插入 insert；StrokeStore 只挪属性列，不挪点。
+// 橡皮擦的网格索引只收当前层的笔画，别的层不用动
+void History::ApplyStrokes(Layer& layer, const std::vector<std::pair<int, Stroke>>& remove,
+                           const std::vector<std::pair<int, Stroke>>& insert) {
+    static std::vector<uint32_t> indices;
+    StrokeStore& strokes = layer.strokes;
+    bool indexed = Layers::IsActive(layer);
+    indices.clear();
+    for (const auto& p : remove) {
+        if (indexed) StrokeIndex::Remove(strokes.View(p.first));
+        indices.push_back((uint32_t)p.first);
+    }
+    strokes.Remove(indices);
+    strokes.Insert(insert);
+    if (indexed)
+        for (const auto& p : insert) StrokeIndex::Insert(strokes.View(p.first));
+}
+
+void History::Push(Entry&& e) {
+    if (e.removed.empty() && e.added.empty() && e.tiles.empty() && !e.detached) return;
+    for (const auto& r : redoStack) strokeBytes -= r.strokeBytes;
+    redoStack.clear();
+    for (const auto& p : e.removed) e.strokeBytes += StrokeBytes(p.second);
+    for (const auto& p : e.added) e.strokeBytes += StrokeBytes(p.second);
+    strokeBytes += e.strokeBytes;
+    undoStack.push_back(std::move(e));
+    Trim();
+}
+
+// 超出上限时从最老的记录丢起；最新一条即使自己就超过上限也保留
+void History::Trim() {
+    while (MemoryUsed() > memoryCap && undoStack.size() > 1) {
+        Entry e = std::move(undoStack.front());
+        undoStack.pop_front();
+        strokeBytes -= e.strokeBytes;
+        // 删掉的图层再也撤销不回来了，这时才丢它的瓦片
+        if (e.detached) {
+            TileCanvas::DropSurface(e.layer);
+            ForgetLayer(e.layer);
+        }
+    }
+    if (!undoStack.empty()) undoStack.front().folded = false; // 前一条丢了，自己单算一步
+}
+
+void History::BeginEdit(const Layer& layer) {
+    editing = true;
+    editLayer = layer.id;
+    editIds.assign(layer.strokes.id.begin(), layer.strokes.id.end());
+    editRemoved.clear();
+    CanvasLogic::onRemove = Removing;
+}
+
+void History::Removing(const StrokeStore& strokes, size_t i) {
+    if (!editing) return;
+    if (editRemoved.find(strokes.id[i]) == editRemoved.end()) editRemoved.emplace(strokes.id[i], strokes.Get(i));
+}
+
+// 和开始时的 id 顺序对比：新出现的记为新增，消失的记为删除（副本在 Removing 里存好了）
+void History::EndEdit(const Layer& layer) {
+    if (!editing) return;
+    const StrokeStore& strokes = layer.strokes;
+    editing = false;
+    CanvasLogic::onRemove = nullptr;
+
+    std::unordered_map<int, int> pre;
+    pre.reserve(editIds.size());
+    for (int i = 0; i < (int)editIds.size(); i++) pre[editIds[i]] = i;
+    std::vector<char> kept(editIds.size(), 0);
+
+    Entry e;
+    e.layer = editLayer;
+    for (int j = 0; j < (int)strokes.size(); j++) {
+        auto it = pre.find(strokes.id[j]);
+        if (it == pre.end()) e.added.push_back({j, strokes.Get(j)});
+        else kept[it->second] = 1;
+    }
+    for (int i = 0; i < (int)editIds.size(); i++) {
+        if (kept[i]) continue;
+        auto it = editRemoved.find(editIds[i]);
+        if (it != editRemoved.end()) e.removed.push_back({i, std::move(it->second)});
+    }
+    editIds.clear();
+    editRemoved.clear();
+    Push(std::move(e));
+}
+
+bool History::Editing() {
+    return editing;
+}
+
+void History::Bake(Layer& layer, size_t first, size_t last, bool automatic) {
+    if (first >= last) return;
+    StrokeStore& strokes = layer.strokes;
+    BindLayer bind(layer);
+    ImVec2 bmin = {FLT_MAX, FLT_MAX}, bmax = {-FLT_MAX, -FLT_MAX};
+    for (size_t i = first; i < last; i++) {
+        if (strokes.Count(i) < 2) continue;
+        EnsureStrokeCache(strokes, i);
+        if (strokes.Cache(i).stamps.empty()) continue;
+        bmin.x = std::min(bmin.x, strokes.boundsMin[i].x); bmin.y = std::min(bmin.y, strokes.boundsMin[i].y);
+        bmax.x = std::max(bmax.x, strokes.boundsMax[i].x); bmax.y = std::max(bmax.y, strokes.boundsMax[i].y);
+    }
+
+    Entry e;
+    e.layer = layer.id;
+    // 双线性采样可能多碰到 1 像素，包围盒外扩一点再对齐到瓦片
+    bool touches = bmin.x <= bmax.x && bmax.x >= 0 && bmax.y >= 0 && bmin.x < canvasW && bmin.y < canvasH;
+    int tx0 = 0, ty0 = 0, tx1 = -1, ty1 = -1;
+    if (touches) {
+        tx0 = (int)std::max(0.0f, bmin.x - 1) / TILE; ty0 = (int)std::max(0.0f, bmin.y - 1) / TILE;
+        tx1 = std::min(TilesX() - 1, (int)(bmax.x + 1) / TILE); ty1 = std::min(TilesY() - 1, (int)(bmax.y + 1) / TILE);
+    }
+    // 只取印章真正盖到的瓦片：稀疏的长笔画包围盒很大，但碰到的瓦片不多
+    int spanX = tx1 - tx0 + 1;
+    std::vector<char> hit(touches ? (size_t)spanX * (ty1 - ty0 + 1) : 0, 0);
+    for (size_t i = first; i < last && touches; i++) {
+        if (strokes.Count(i) < 2) continue;
+        for (const StampInstance& s : strokes.Cache(i).stamps) {
+            float r = fabsf(s.a) + fabsf(s.b) + 1;
+            if (s.x + r < 0 || s.y + r < 0 || s.x - r >= canvasW || s.y - r >= canvasH) continue;
+            int x0 = std::max(tx0, (int)std::max(0.0f, s.x - r) / TILE), x1 = std::min(tx1, (int)(s.x + r) / TILE);
+            int y0 = std::max(ty0, (int)std::max(0.0f, s.y - r) / TILE), y1 = std::min(ty1, (int)(s.y + r) / TILE);
+            for (int ty = y0; ty <= y1; ty++)
+                memset(&hit[(size_t)(ty - ty0) * spanX + (x0 - tx0)], 1, std::max(0, x1 - x0 + 1));
+        }
+    }
+    std::vector<TilePtr> before, after;
+    if (touches) CaptureTiles(tx0, ty0, tx1, ty1, true, before, &hit);
+    Renderer::BakeStrokes(strokes, first, last);
+    if (touches) {
+        CaptureTiles(tx0, ty0, tx1, ty1, false, after, &hit);
+        size_t k = 0;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++, k++) {
+                if (!hit[k]) continue;
+                // 内容没变（比如全透明的印章、被压在下面的像素）就不进记录，已知表里换回原来那份共享
+                if (memcmp(before[k]->rgba.data(), after[k]->rgba.data(), before[k]->rgba.size()) == 0)
+                    known[KnownKey(ty * TilesX() + tx)] = before[k];
+                else
+                    e.tiles.push_back({ty * TilesX() + tx, before[k], after[k]});
+            }
+        }
+    }
+
+    bool indexed = Layers::IsActive(layer);
+    for (size_t i = first; i < last; i++) {
+        if (indexed) StrokeIndex::Remove(strokes.View(i));
+        e.removed.push_back({(int)i, strokes.Get(i)});
+    }
+    strokes.Erase(first, last);
+    // 编辑途中被烘焙掉的笔画不算这次编辑删的
+    if (editing && editLayer == layer.id) {
+        std::unordered_set<int> baked;
+        for (const auto& p : e.removed) baked.insert(p.second.id);
+        editIds.erase(std::remove_if(editIds.begin(), editIds.end(), [&](int id) { return baked.count(id) > 0; }), editIds.end());
+    }
+    e.folded = automatic && !undoStack.empty();
+    Push(std::move(e));
+}
+
+void History::ClearAll(Layer& layer) {
+    StrokeStore& strokes = layer.strokes;
+    BindLayer bind(layer);
+    Entry e;
+    e.layer = layer.id;
+    // 没画过的底图瓦片本来就是透明的，只记画过的那些
+    const int PER = TileCanvas::TILE / TILE;
+    std::vector<std::pair<int, TilePtr>> before;
+    std::vector<TilePtr> block;
+    TileCanvas::ForEachPainted([&](int cx, int cy) {
+        int tx0 = cx * PER, ty0 = cy * PER;
+        int tx1 = std::min(TilesX() - 1, tx0 + PER - 1), ty1 = std::min(TilesY() - 1, ty0 + PER - 1);
+        CaptureTiles(tx0, ty0, tx1, ty1, true, block);
+        size_t k = 0;
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++) before.push_back({ty * TilesX() + tx, block[k++]});
+    });
+    Renderer::ClearTexture();
+
+    // 清空后都是透明的，同样大小的瓦片共用一份
+    std::map<std::pair<int, int>, TilePtr> blank;
+    for (auto& [t, p] : before) {
+        int x, y, w, h;
+        TileRect(t, x, y, w, h);
+        TilePtr& bp = blank[{w, h}];
+        if (!bp) bp = std::make_shared<Tile>(w, h);
+        known[KnownKey(t)] = bp;
+        e.tiles.push_back({t, std::move(p), bp});
+    }
+
+    for (size_t i = 0; i < strokes.size(); i++) e.removed.push_back({(int)i, strokes.Get(i)});
+    strokes.Clear();
+    if (Layers::IsActive(layer)) StrokeIndex::Clear();
+    if (editing && editLayer == layer.id) editIds.clear();
+    Push(std::move(e));
+}
+
+void History::Paint(Layer& layer, int x, int y, int w, int h, const unsigned char* rgba) {
+    if (w <= 0 || h <= 0) return;
+    BindLayer bind(layer);
+    Entry e;
+    e.layer = layer.id;
+    int tx0 = x / TILE, ty0 = y / TILE, tx1 = (x + w - 1) / TILE, ty1 = (y + h - 1) / TILE;
+    std::vector<TilePtr> old;
+    CaptureTiles(tx0, ty0, tx1, ty1, true, old);
+    size_t k = 0;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++, k++) {
+            int t = ty * TilesX() + tx, bx, by, bw, bh;
+            TileRect(t, bx, by, bw, bh);
+            auto after = std::make_shared<Tile>(bw, bh);
+            after->rgba = old[k]->rgba;
+            // 瓦片和矩形的交集
+            int x0 = std::max(x, bx), y0 = std::max(y, by), x1 = std::min(x + w, bx + bw), y1 = std::min(y + h, by + bh);
+            for (int r = y0; r < y1; r++)
+                memcpy(&after->rgba[((size_t)(r - by) * bw + (x0 - bx)) * 4], &rgba[((size_t)(r - y) * w + (x0 - x)) * 4],
+                       (size_t)(x1 - x0) * 4);
+            known[KnownKey(t)] = after;
+            e.tiles.push_back({t, old[k], std::move(after)});
+        }
+    }
+    Renderer::WriteRegion(x, y, w, h, rgba);
+    Push(std::move(e));
+}
+
+void History::Paint(Layer& layer, const std::vector<Patch>& patches) {
+    BindLayer bind(layer);
+    Entry e;
+    e.layer = layer.id;
+    for (const Patch& p : patches) {
+        if (p.w <= 0 || p.h <= 0) continue;
+        for (int ty = p.y / TILE; ty <= (p.y + p.h - 1) / TILE; ty++) {
+            for (int tx = p.x / TILE; tx <= (p.x + p.w - 1) / TILE; tx++) {
+                int t = ty * TilesX() + tx, bx, by, bw, bh;
+                TileRect(t, bx, by, bw, bh);
+                auto before = std::make_shared<Tile>(bw, bh), after = std::make_shared<Tile>(bw, bh);
+                for (int r = 0; r < bh; r++) {
+                    size_t src = ((size_t)(by - p.y + r) * p.w + (bx - p.x)) * 4;
+                    memcpy(&before->rgba[(size_t)r * bw * 4], p.before + src, (size_t)bw * 4);
+                    memcpy(&after->rgba[(size_t)r * bw * 4], p.rgba + src, (size_t)bw * 4);
+                }
+                if (before->rgba == after->rgba) continue;
+                // 已知的那份和 before 内容一样，共享它省一份内存
+                auto it = known.find(KnownKey(t));
+                TilePtr old = it != known.end() ? it->second : TilePtr(std::move(before));
+                known[KnownKey(t)] = after;
+                e.tiles.push_back({t, std::move(old), std::move(after)});
+            }
+        }
+        Renderer::WriteRegion(p.x, p.y, p.w, p.h, p.rgba);
+    }
+    Push(std::move(e));
+}
+
+void History::RemoveLayer(int index) {
+    Entry e;
+    e.layer = Layers::At(index).id;
+    e.stackIndex = index;
+    if (editing && editLayer == e.layer) {
+        editing = false;
+        CanvasLogic::onRemove = nullptr;
+    }
+    e.detached = Layers::Detach(index);
+    e.strokeBytes = e.detached->strokes.MemoryBytes();
+    Push(std::move(e));
+}
+
+bool History::Known(int surface, int x, int y, int w, int h, unsigned char* out, size_t stride) {
+    if (w <= 0 || h <= 0) return true;
+    int tx0 = x / TILE, ty0 = y / TILE, tx1 = (x + w - 1) / TILE, ty1 = (y + h - 1) / TILE;
+    std::vector<const Tile*> found;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            auto it = known.find(KnownKey(surface, ty * TilesX() + tx));
+            if (it == known.end()) return false;
+            found.push_back(it->second.get());
+        }
+    }
+    size_t k = 0;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            const Tile& t = *found[k++];
+            int bx, by, bw, bh;
+            TileRect(ty * TilesX() + tx, bx, by, bw, bh);
+            int x0 = std::max(x, bx), y0 = std::max(y, by), x1 = std::min(x + w, bx + bw), y1 = std::min(y + h, by + bh);
+            for (int r = y0; r < y1; r++)
+                memcpy(out + (size_t)(r - y) * stride + (size_t)(x0 - x) * 4, &t.rgba[((size_t)(r - by) * bw + (x0 - bx)) * 4],
+                       (size_t)(x1 - x0) * 4);
+        }
+    }
+    return true;
+}
+
+History::Pixels History::KnownTile(int surface, int tile) {
+    auto it = known.find(KnownKey(surface, tile));
+    if (it == known.end()) return nullptr;
+    return Pixels(it->second, &it->second->rgba);
+}
+
+bool History::CanUndo() {
+    return !undoStack.empty() && !editing;
+}
+
+bool History::CanRedo() {
+    return !redoStack.empty() && !editing;
+}
+
+// 自动烘焙的记录并在前一条里：撤销时连同前一条一起撤，重做时跟着前一条一起重做
+void History::Undo() {
+    if (!CanUndo()) return;
+    bool folded;
+    do {
+        Entry e = std::move(undoStack.back());
+        undoStack.pop_back();
+        folded = e.folded;
+        if (e.stackIndex >= 0) {
+            Layers::Attach(std::move(e.detached), e.stackIndex);
+        } else {
+            Layer& layer = *Layers::Find(e.layer);
+            BindLayer bind(layer);
+            ApplyTiles(e, false);
+            ApplyStrokes(layer, e.added, e.removed);
+        }
+        redoStack.push_back(std::move(e));
+    } while (folded && !undoStack.empty());
+}
+
+void History::Redo() {
+    if (!CanRedo()) return;
+    do {
+        Entry e = std::move(redoStack.back());
+        redoStack.pop_back();
+        if (e.stackIndex >= 0) {
+            // 撤销以后图层可能被挪过位置
+            e.stackIndex = Layers::IndexOf(e.layer);
+            e.detached = Layers::Detach(e.stackIndex);
+        } else {
+            Layer& layer = *Layers::Find(e.layer);
+            BindLayer bind(layer);
+            ApplyTiles(e, true);
+            ApplyStrokes(layer, e.removed, e.added);
+        }
+        undoStack.push_back(std::move(e));
+    } while (!redoStack.empty() && redoStack.back().folded);
+}
+
+void History::Reset() {
+    for (const auto& e : undoStack)
+        if (e.detached) TileCanvas::DropSurface(e.layer);
+    undoStack.clear();
+    redoStack.clear();
+    known.clear();
+    strokeBytes = 0;
+}
+
+// 每条记录只动一个图层，别的图层的记录不受影响，直接从两个栈里摘掉
+void History::ForgetLayer(int id) {
+    auto gone = [&](const Entry& e) { return e.layer == id; };
+    for (const auto& e : undoStack)
+        if (gone(e)) strokeBytes -= e.strokeBytes;
+    for (const auto& e : redoStack)
+        if (gone(e)) strokeBytes -= e.strokeBytes;
+    undoStack.erase(std::remove_if(undoStack.begin(), undoStack.end(), gone), undoStack.end());
+    redoStack.erase(std::remove_if(redoStack.begin(), redoStack.end(), gone), redoStack.end());
+    for (auto it = known.begin(); it != known.end();) {
+        if ((int)(it->first >> 32) == id) it = known.erase(it);
+        else ++it;
+    }
+    if (editing && editLayer == id) {
+        editing = false;
+        CanvasLogic::onRemove = nullptr;
+    }
+}
+
+size_t History::MemoryUsed() {
+    return tileBytes + strokeBytes;
+}
+
+int History::UndoCount() {
+    return (int)std::count_if(undoStack.begin(), undoStack.end(), [](const Entry& e) { return !e.folded; });
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+#include "Common.h"
+#include "StrokeStore.h"
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+struct Layer;
+
+// 撤销/重做。每条记录由两部分组成：
+//   - 矢量部分：删掉的笔画（原下标 + 副本）和新增的笔画（新下标 + 副本），不存整份 strokes
+//   - 底图部分：被烘焙/清空改动过的 64x64 瓦片的前后内容，瓦片用 shared_ptr 共享，
+//     相邻两条记录之间没再改过的瓦片只存一份（写时复制）
+// 每条记录属于一个图层（记下图层 id），撤销/重做时作用在那一层上，不管当前层是哪个。
+// 删图层也是一条记录：摘下来的图层（连同笔画）放在记录里，它的瓦片留在 TileCanvas 里，
+// 这条记录从撤销栈里丢掉时才真正删掉瓦片和这一层剩下的记录。
+// 撤销/重做只处理记录里的笔画和瓦片，和画布大小、笔画总数无关。
+// 总内存超过 memoryCap 时从最老的记录开始丢。
+class History {
+public:
+    static constexpr int TILE = 64;
+    static size_t memoryCap;
+
+    // 一次鼠标操作（画一笔、拖着擦除……）从按下到松开算一条记录
+    static void BeginEdit(const Layer& layer);
+    static void Removing(const StrokeStore& strokes, size_t i); // 编辑过程中删掉/改动第 i 笔之前调用，保存副本
+    static void EndEdit(const Layer& layer);
+    static bool Editing();
+
+    // 把图层的 [first, last) 烘焙进它的底图并从笔画里移除；清空图层。都可撤销。
+    // automatic 的烘焙（超预算自动退休）不单算一步，和前一步一起撤销/重做
+    static void Bake(Layer& layer, size_t first, size_t last, bool automatic = false);
+    static void ClearAll(Layer& layer);
+    // 把 rgba（w x h，画布自上而下的行序）写进图层底图的这块矩形，可撤销；改后的瓦片由 rgba 拼出来，不再回读
+    static void Paint(Layer& layer, int x, int y, int w, int h, const unsigned char* rgba);
+    // 一次改底图上的若干块，记成一条撤销记录。rgba 和 before（这块改之前的内容）都是 w x h、自上而下；
+    // 块的边要对齐到 64 像素的撤销瓦片或画布边（TileCanvas 的瓦片天然对齐），改前改后都从这两份拷，不回读。内容没变的瓦片不记
+    struct Patch {
+        int x, y, w, h;
+        const unsigned char* rgba;
+        const unsigned char* before;
+    };
+    static void Paint(Layer& layer, const std::vector<Patch>& patches);
+    // 把下标 index 的图层从栈里摘下，可撤销
+    static void RemoveLayer(int index);
+
+    // surface 上这块矩形里的 64x64 瓦片都在 known 里时直接从它们拷出来（画布自上而下，out 每行 stride 字节）返回 true，不回读
+    static bool Known(int surface, int x, int y, int w, int h, unsigned char* out, size_t stride);
+    // surface 上第 tile 块瓦片（按画布宽度逐行编号，画布边上的是裁过的 w x h）的当前内容，不知道时为空。
+    // 和 known 共享，不拷贝；瓦片析构时要记账，后台线程拿着的要交回主线程释放
+    using Pixels = std::shared_ptr<const std::vector<unsigned char>>;
+    static Pixels KnownTile(int surface, int tile);
+
+    static bool CanUndo();
+    static bool CanRedo();
+    static void Undo();
+    static void Redo();
+    static void Reset(); // 底图被别的途径改动时调用，丢掉全部历史
+    static size_t MemoryUsed();
+    static int UndoCount();
+
+private:
+    struct Tile {
+        int w, h;
+        std::vector<unsigned char> rgba;
+        Tile(int w, int h);
+        ~Tile();
+    };
+    using TilePtr = std::shared_ptr<const Tile>;
+    struct TileEdit {
+        int tile;
+        TilePtr before, after;
+    };
+    struct Entry {
+        int layer = -1; // 图层 id
+        std::vector<std::pair<int, Stroke>> removed; // 按下标升序，下标相对改动前
+        std::vector<std::pair<int, Stroke>> added;   // 按下标升序，下标相对改动后
+        std::vector<TileEdit> tiles;
+        size_t strokeBytes = 0;
+        bool folded = false; // 自动烘焙，并在前一条里
+        int stackIndex = -1;             // 删图层的记录：删之前它在栈里的下标；其余记录是 -1
+        std::unique_ptr<Layer> detached; // 删图层的记录在撤销栈里时是摘下来的那一层，撤销后放回栈里，这里为空
+    };
+
+    static void TileRect(int tile, int& x, int& y, int& w, int& h);
+    static void CaptureTiles(int tx0, int ty0, int tx1, int ty1, bool useKnown, std::vector<TilePtr>& out,
+                             const std::vector<char>* mask = nullptr);
+    static void ApplyTiles(const Entry& e, bool after);
+    static void ApplyStrokes(Layer& layer, const std::vector<std::pair<int, Stroke>>& remove,
+                             const std::vector<std::pair<int, Stroke>>& insert);
+    static void Push(Entry&& e);
+    static void Trim();
+    static void ForgetLayer(int id); // 删图层的记录丢掉时调用：丢掉这一层剩下的记录和 known 里的瓦片
+
+    static std::deque<Entry> undoStack;
+    static std::vector<Entry> redoStack;
+    static std::unordered_map<int64_t, TilePtr> known; // (图层 id, 瓦片) -> 当前内容（已知时），新记录直接共享它
+    static size_t tileBytes;
+    static size_t strokeBytes;
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "InputQueue.h"
+#include <GLFW/glfw3.h>
+
+std::atomic<size_t> InputQueue::dropped{0};
+int InputQueue::lastCount = 0;
+float InputQueue::lastLatencyMs = 0.0f;
+
+static SpscQueue<InputSample, InputQueue::CAPACITY> queue;
+static bool leftDown = false; // 只在回调线程里读写
+
+static void Push(double x, double y) {
+    if (!queue.Push({(float)x, (float)y, leftDown, glfwGetTime()})) InputQueue::dropped++;
+}
+
+static void OnCursor(GLFWwindow*, double x, double y) {
+    Push(x, y);
+}
+
+// 按下 / 松开也记一个采样，笔画从按下的那个点开始
+static void OnButton(GLFWwindow* window, int button, int action, int) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT) return;
+    leftDown = action == GLFW_PRESS;
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    Push(x, y);
+}
+
+void InputQueue::Install(GLFWwindow* window) {
+    glfwSetCursorPosCallback(window, OnCursor);
+    glfwSetMouseButtonCallback(window, OnButton);
+}
+
+void InputQueue::Drain(std::vector<InputSample>& out) {
+    out.clear();
+    InputSample s;
+    while (queue.Pop(s)) out.push_back(s);
+    lastCount = (int)out.size();
+    lastLatencyMs = out.empty() ? 0.0f : (float)((glfwGetTime() - out.front().time) * 1000.0);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include "Common.h"
+#include <atomic>
+#include <cstddef>
+
+struct GLFWwindow;
+
+// 一个光标采样：窗口坐标、左键是否按着、GLFW 时间（秒）
+struct InputSample {
+    float x, y;
+    bool down;
+    double time;
+};
+
+// 单生产者单消费者的无锁环形队列：生产者只写 tail，消费者只写 head；满了丢掉新来的
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "N 要是 2 的幂");
+
+public:
+    bool Push(const T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        items[t & (N - 1)] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool Pop(T& v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        v = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[N];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// 高频光标输入：GLFW 的光标 / 左键回调每来一个事件就带上时间戳放进队列，不受帧率限制；
+// 画布每帧把攒下的采样全部取出来，帧率掉下来时快速划过的笔画也不会变成几段长直线。
+// 回调在处理事件的线程里跑（现在是主线程的 glfwPollEvents / glfwWaitEventsTimeout），取采样在帧逻辑里，
+// 两边只通过 SPSC 队列交换。
+class InputQueue {
+public:
+    static const size_t CAPACITY = 4096;
+    static std::atomic<size_t> dropped; // 队列满时丢掉的采样数
+    static int lastCount;               // 上一次 Drain 取出了多少
+    static float lastLatencyMs;         // 上一次 Drain 时最老那个采样等了多久
+
+    static void Install(GLFWwindow* window); // 在 ImGui_ImplGlfw_InitForOpenGL 之前调用，ImGui 会接着调这里的回调
+    static void Drain(std::vector<InputSample>& out); // 清空 out 后按时间顺序放入所有待处理的采样
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "InputRecorder.h"
+#include "BrushRegistry.h"
+#include <fstream>
+#include <sstream>
+
+bool InputRecorder::recording = false;
+std::vector<InputFrame> InputRecorder::frames;
+
+static const char* TOOL_NAMES[] = {"brush", "stroke_eraser", "precise_eraser", "rectangle", "circle", "eyedropper", "fill"};
+static const int TOOL_COUNT = sizeof(TOOL_NAMES) / sizeof(TOOL_NAMES[0]);
+
+void InputRecorder::Start() {
+    frames.clear();
+    recording = true;
+}
+
+void InputRecorder::Capture(const InputFrame& f) {
+    if (recording) frames.push_back(f);
+}
+
+bool InputRecorder::Stop(const std::string& path) {
+    recording = false;
+    return Save(path, frames);
+}
+
+bool InputRecorder::Save(const std::string& path, const std::vector<InputFrame>& frames) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "PAINTREC 1\n";
+    for (const auto& f : frames) {
+        const std::string& brush = BrushRegistry::Get(f.brush).name;
+        out << TOOL_NAMES[(int)f.tool] << ' ' << (brush.empty() ? "-" : brush) << ' ' << f.size << ' '
+            << std::hex << f.color << std::dec << ' ' << f.pos.x << ' ' << f.pos.y << ' '
+            << (int)f.down << ' ' << (int)f.hovered << '\n';
+    }
+    return (bool)out;
+}
+
+// 录制时的笔刷本机没有就用 0 号
+bool InputRecorder::Load(const std::string& path, std::vector<InputFrame>& frames) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != "PAINTREC 1") return false;
+    frames.clear();
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string tool, brush;
+        InputFrame f;
+        int down, hovered;
+        if (!(ss >> tool >> brush >> f.size >> std::hex >> f.color >> std::dec >> f.pos.x >> f.pos.y >> down >> hovered)) continue;
+        int t = 0;
+        while (t < TOOL_COUNT && tool != TOOL_NAMES[t]) t++;
+        if (t == TOOL_COUNT) continue;
+        f.tool = (Tool)t;
+        f.brush = std::max(0, BrushRegistry::Find(brush));
+        f.down = down != 0;
+        f.hovered = hovered != 0;
+        frames.push_back(f);
+    }
+    return true;
+}
\ No newline at end of file
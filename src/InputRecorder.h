@@ -0,0 +1,30 @@
+#pragma once
+#include "Common.h"
+#include <string>
+
+// 画布上一帧的输入：鼠标位置（画布坐标）、左键状态和当时的工具参数
+struct InputFrame {
+    ImVec2 pos;
+    bool down;
+    bool hovered;
+    Tool tool;
+    int brush;
+    float size;
+    ImU32 color;
+};
+
+// 录制画布输入，存成文本文件（笔刷按名字记录），ReplayBench 可以无窗口回放。
+// 文件格式：第一行 "PAINTREC 1"，之后每帧一行
+//   tool brush size color x y down hovered
+class InputRecorder {
+public:
+    static bool recording;
+    static std::vector<InputFrame> frames;
+
+    static void Start();
+    static void Capture(const InputFrame& f); // 录制中时每帧调用
+    static bool Stop(const std::string& path); // 停止并保存
+
+    static bool Save(const std::string& path, const std::vector<InputFrame>& frames);
+    static bool Load(const std::string& path, std::vector<InputFrame>& frames);
+};
\ No newline at end of file
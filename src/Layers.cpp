@@ -0,0 +1,102 @@
+#include "Layers.h"
+#include "Compositor.h"
+#include "History.h"
+#include "StrokeIndex.h"
+#include "TileCanvas.h"
+#include <algorithm>
+
+const char* Layers::BLEND_NAMES[4] = {"Normal", "Multiply", "Screen", "Add"};
+std::vector<std::unique_ptr<Layer>> Layers::stack;
+int Layers::active = 0;
+int Layers::nextId = 0;
+int Layers::nextName = 1;
+
+int Layers::IndexOf(int id) {
+    for (int i = 0; i < Count(); i++)
+        if (stack[i]->id == id) return i;
+    return -1;
+}
+
+Layer* Layers::Find(int id) {
+    int i = IndexOf(id);
+    return i < 0 ? nullptr : stack[i].get();
+}
+
+void Layers::Bind(const Layer& l) {
+    TileCanvas::Select(l.id);
+}
+
+static std::unique_ptr<Layer> NewLayer(int id, int name) {
+    auto l = std::make_unique<Layer>();
+    l->id = id;
+    l->name = "Layer " + std::to_string(name);
+    return l;
+}
+
+void Layers::Reset(int n) {
+    stack.clear();
+    nextName = 1;
+    for (int i = 0; i < std::max(1, n); i++) stack.push_back(NewLayer(nextId++, nextName++));
+    active = 0;
+    Bind(Active());
+}
+
+Layer& Layers::Add() {
+    stack.insert(stack.begin() + active + 1, NewLayer(nextId++, nextName++));
+    Select(active + 1);
+    Compositor::InvalidateAll(active);
+    return Active();
+}
+
+void Layers::Remove(int index) {
+    if (Count() <= 1 || index < 0 || index >= Count()) return;
+    History::RemoveLayer(index);
+}
+
+std::unique_ptr<Layer> Layers::Detach(int index) {
+    auto l = std::move(stack[index]);
+    stack.erase(stack.begin() + index);
+    Compositor::InvalidateAll(std::min(index, Count() - 1));
+    Select(std::min(active > index ? active - 1 : active, Count() - 1));
+    return l;
+}
+
+// 放回后选中它
+void Layers::Attach(std::unique_ptr<Layer> layer, int index) {
+    index = std::clamp(index, 0, Count());
+    stack.insert(stack.begin() + index, std::move(layer));
+    Compositor::InvalidateAll(index);
+    Select(index);
+}
+
+void Layers::Move(int from, int to) {
+    if (from == to || from < 0 || to < 0 || from >= Count() || to >= Count()) return;
+    int activeId = Active().id;
+    auto l = std::move(stack[from]);
+    stack.erase(stack.begin() + from);
+    stack.insert(stack.begin() + to, std::move(l));
+    active = IndexOf(activeId);
+    Compositor::InvalidateAll(std::min(from, to));
+}
+
+void Layers::Select(int index) {
+    active = std::clamp(index, 0, Count() - 1);
+    Bind(Active());
+    StrokeIndex::Rebuild(Active().strokes);
+}
+
+void Layers::SetVisible(int index, bool visible) {
+    if (stack[index]->visible == visible) return;
+    stack[index]->visible = visible;
+    Compositor::InvalidateAll(index);
+}
+
+void Layers::SetOpacity(int index, float opacity) {
+    stack[index]->opacity = std::clamp(opacity, 0.0f, 1.0f);
+    Compositor::InvalidateAll(index);
+}
+
+void Layers::SetBlend(int index, BlendMode blend) {
+    stack[index]->blend = blend;
+    Compositor::InvalidateAll(index);
+}
\ No newline at end of file
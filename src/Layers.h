@@ -0,0 +1,51 @@
+#pragma once
+#include "Common.h"
+#include "StrokeStore.h"
+#include <memory>
+#include <string>
+
+// 图层混合模式；图层内容是预乘 alpha 的，叠在不透明的白纸上
+enum class BlendMode { Normal, Multiply, Screen, Add };
+
+// 一个图层：自己的底图（TileCanvas 里 surface = id 的那组瓦片）和自己还没烘焙的笔画
+struct Layer {
+    int id;
+    std::string name;
+    float opacity = 1.0f;
+    BlendMode blend = BlendMode::Normal;
+    bool visible = true;
+    StrokeStore strokes;
+};
+
+// 图层栈，下标 0 在最下面。画笔、橡皮擦、烘焙都作用在当前层；橡皮擦的网格索引（StrokeIndex）只收当前层的笔画。
+// 可见性、不透明度、混合模式、顺序都通过这里改，合成缓存跟着作废
+class Layers {
+public:
+    static const char* BLEND_NAMES[4];
+    static std::vector<std::unique_ptr<Layer>> stack;
+    static int active;
+
+    static Layer& Active() { return *stack[active]; }
+    static Layer& At(int index) { return *stack[index]; }
+    static int Count() { return (int)stack.size(); }
+    static int IndexOf(int id); // 没有时返回 -1
+    static Layer* Find(int id);
+    static bool IsActive(const Layer& l) { return stack[active].get() == &l; }
+    static void Bind(const Layer& l); // TileCanvas 选中这一层的瓦片
+
+    static void Reset(int n = 1);  // 换成 n 个空图层，当前层是最下面一层；底图瓦片由调用方先清掉（TileCanvas::Init）
+    static Layer& Add();           // 在当前层上面加一层并设为当前层
+    static void Remove(int index); // 至少留一层；可撤销，这一层的瓦片留到撤销记录丢掉时
+    // 从栈里摘下 / 放回一层（删除图层和它的撤销、重做用），合成缓存跟着作废
+    static std::unique_ptr<Layer> Detach(int index);
+    static void Attach(std::unique_ptr<Layer> layer, int index);
+    static void Move(int from, int to);
+    static void Select(int index);
+    static void SetVisible(int index, bool visible);
+    static void SetOpacity(int index, float opacity);
+    static void SetBlend(int index, BlendMode blend);
+
+private:
+    static int nextId;
+    static int nextName;
+};
\ No newline at end of file
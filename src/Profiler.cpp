@@ -0,0 +1,222 @@
+#include "Profiler.h"
+#ifdef PAINT_PROFILE
+#include <glad/glad.h>
+#include <imgui.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+enum class EventKind : uint8_t { Scope, Counter, Gpu };
+
+// 每个槽位带序号：写之前清零，写完再写 idx + 1；读的时候前后两次序号一致才算有效。
+// 读写可能同时发生在同一个槽位上，所以字段也都是原子的（relaxed，顺序由 seq 和栅栏保证）
+struct Event {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> start{0};
+    std::atomic<int64_t> value{0};    // Scope/Gpu 是时长（纳秒），Counter 是数值
+    std::atomic<int64_t> children{0}; // Scope 里嵌套的计时加起来的时长
+    std::atomic<uint32_t> tid{0};
+    std::atomic<EventKind> kind{EventKind::Scope};
+};
+
+static Event ring[Profiler::CAPACITY];
+static std::atomic<uint64_t> head{0};
+static std::atomic<uint32_t> nextTid{1};
+static const uint32_t GPU_TID = 0xFFFF;
+thread_local ProfileScope* ProfileScope::current = nullptr;
+
+static uint32_t ThreadTag() {
+    static thread_local uint32_t tid = nextTid++;
+    return tid;
+}
+
+static void Push(EventKind kind, const char* name, int64_t start, int64_t value, uint32_t tid, int64_t children = 0) {
+    uint64_t idx = head.fetch_add(1, std::memory_order_relaxed);
+    Event& e = ring[idx & (Profiler::CAPACITY - 1)];
+    e.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(name, std::memory_order_relaxed);
+    e.start.store(start, std::memory_order_relaxed);
+    e.value.store(value, std::memory_order_relaxed);
+    e.children.store(children, std::memory_order_relaxed);
+    e.tid.store(tid, std::memory_order_relaxed);
+    e.kind.store(kind, std::memory_order_relaxed);
+    e.seq.store(idx + 1, std::memory_order_release);
+}
+
+struct EventCopy {
+    const char* name;
+    int64_t start, value, children;
+    uint32_t tid;
+    EventKind kind;
+};
+
+static bool Read(uint64_t idx, EventCopy& out) {
+    const Event& e = ring[idx & (Profiler::CAPACITY - 1)];
+    if (e.seq.load(std::memory_order_acquire) != idx + 1) return false;
+    out = {e.name.load(std::memory_order_relaxed), e.start.load(std::memory_order_relaxed), e.value.load(std::memory_order_relaxed),
+           e.children.load(std::memory_order_relaxed), e.tid.load(std::memory_order_relaxed), e.kind.load(std::memory_order_relaxed)};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return e.seq.load(std::memory_order_relaxed) == idx + 1;
+}
+
+int64_t Profiler::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Record(const char* name, int64_t start, int64_t end, int64_t children) {
+    Push(EventKind::Scope, name, start, end - start, ThreadTag(), children);
+}
+
+void Profiler::Counter(const char* name, int64_t value) {
+    Push(EventKind::Counter, name, Now(), value, ThreadTag());
+}
+
+// ---------------- 主线程汇总 ----------------
+struct Series {
+    std::vector<float> ms = std::vector<float>(Profiler::HISTORY, 0.0f);
+    int next = 0, filled = 0;
+    void Add(float v) {
+        ms[next] = v;
+        next = (next + 1) % Profiler::HISTORY;
+        filled = std::min(filled + 1, Profiler::HISTORY);
+    }
+};
+static std::map<std::string, Series> series;
+static std::map<std::string, int64_t> counters;
+static uint64_t readPos = 0;
+static int64_t lastFrame = 0;
+
+void Profiler::FrameMark() {
+    int64_t now = Now();
+    if (lastFrame) Record("Frame", lastFrame, now);
+    lastFrame = now;
+
+    // 把上一帧以来的事件按名字累加成一帧的耗时；嵌套的计时只算在最里层，外层减掉 children 不重复计
+    std::map<std::string, int64_t> frame;
+    uint64_t end = head.load(std::memory_order_acquire);
+    readPos = std::max(readPos, end > (uint64_t)CAPACITY ? end - CAPACITY : 0);
+    for (; readPos < end; readPos++) {
+        EventCopy e;
+        if (!Read(readPos, e)) continue;
+        if (e.kind == EventKind::Counter) counters[e.name] = e.value;
+        else frame[e.name] += e.value - e.children;
+    }
+    for (const auto& [name, ns] : frame) series[name].Add(ns / 1e6f);
+}
+
+// ---------------- GPU 计时 ----------------
+// 查询结果要几帧后才有，用一圈查询对象轮流用，不等待
+static const int GPU_QUERIES = 4;
+static GLuint gpuQueries[GPU_QUERIES];
+static int64_t gpuSubmit[GPU_QUERIES];
+static bool gpuPending[GPU_QUERIES];
+static int gpuSlot = 0;
+static bool gpuActive = false;
+
+void Profiler::GpuBegin() {
+    if (!GLAD_GL_VERSION_3_3) return;
+    if (!gpuQueries[0]) glGenQueries(GPU_QUERIES, gpuQueries);
+    for (int i = 0; i < GPU_QUERIES; i++) {
+        if (!gpuPending[i]) continue;
+        GLint ready = 0;
+        glGetQueryObjectiv(gpuQueries[i], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(gpuQueries[i], GL_QUERY_RESULT, &ns);
+        Push(EventKind::Gpu, "GPU RenderDrawData", gpuSubmit[i], (int64_t)ns, GPU_TID);
+        gpuPending[i] = false;
+    }
+    gpuActive = !gpuPending[gpuSlot]; // 这一圈都还没回来就跳过这一帧
+    if (!gpuActive) return;
+    gpuSubmit[gpuSlot] = Now();
+    glBeginQuery(GL_TIME_ELAPSED, gpuQueries[gpuSlot]);
+}
+
+void Profiler::GpuEnd() {
+    if (!gpuActive) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuPending[gpuSlot] = true;
+    gpuSlot = (gpuSlot + 1) % GPU_QUERIES;
+    gpuActive = false;
+}
+
+// ---------------- 浮层和导出 ----------------
+static float Percentile(std::vector<float> v, float p) {
+    if (v.empty()) return 0.0f;
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+void Profiler::DrawOverlay() {
+    static float traceSeconds = 5.0f;
+    ImGui::SetNextWindowPos({980, 10}, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize({290, 360}, ImGuiCond_FirstUseEver);
+    ImGui::Begin("Profiler");
+
+    struct Row { const std::string* name; float p50, p95, p99, max; };
+    std::vector<Row> rows;
+    for (const auto& [name, s] : series) {
+        std::vector<float> v(s.ms.begin(), s.ms.begin() + s.filled);
+        if (v.empty()) continue;
+        rows.push_back({&name, Percentile(v, 0.5f), Percentile(v, 0.95f), Percentile(v, 0.99f), *std::max_element(v.begin(), v.end())});
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.p95 > b.p95; });
+
+    ImGui::Text("self ms over last %d frames", HISTORY);
+    if (ImGui::BeginTable("stages", 5)) {
+        ImGui::TableSetupColumn("stage");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("max");
+        ImGui::TableHeadersRow();
+        for (const auto& r : rows) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(r.name->c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", r.p50);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", r.p95);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", r.p99);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", r.max);
+        }
+        ImGui::EndTable();
+    }
+    for (const auto& [name, v] : counters) ImGui::Text("%s: %lld", name.c_str(), (long long)v);
+
+    ImGui::SliderFloat("Seconds", &traceSeconds, 1.0f, 20.0f);
+    if (ImGui::Button("Dump Chrome trace")) DumpTrace("trace.json", traceSeconds);
+    ImGui::End();
+}
+
+// 环形缓冲区里还在的、最近 seconds 秒的事件写成 Chrome trace 的 JSON
+bool Profiler::DumpTrace(const char* path, float seconds) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    int64_t since = Now() - (int64_t)(seconds * 1e9);
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > (uint64_t)CAPACITY ? end - CAPACITY : 0;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", GPU_TID);
+    for (uint64_t i = begin; i < end; i++) {
+        EventCopy e;
+        if (!Read(i, e) || e.start < since) continue;
+        double ts = e.start / 1e3;
+        if (e.kind == EventKind::Counter)
+            fprintf(f, ",\n{\"ph\":\"C\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}", e.name, e.tid, ts, (long long)e.value);
+        else
+            fprintf(f, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", e.name, e.tid, ts, e.value / 1e3);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    printf("Trace written to %s\n", path);
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+// 分阶段计时。只在定义了 PAINT_PROFILE 时编译（xmake 的 debug 模式），
+// release 下 PROFILE_SCOPE / PROFILE_COUNTER 展开为空，Profiler 本身也不参与编译。
+//
+// 事件写进一个无锁环形缓冲区（任意线程可写），主线程每帧 FrameMark 时汇总成滚动分位数，
+// DumpTrace 把最近 N 秒导出成 Chrome trace（chrome://tracing / Perfetto 打开）。
+#ifdef PAINT_PROFILE
+
+class Profiler {
+public:
+    static constexpr int CAPACITY = 1 << 16; // 环形缓冲区能放的事件数
+    static constexpr int HISTORY = 240;      // 分位数统计最近多少帧
+
+    static int64_t Now(); // 纳秒
+    static void Record(const char* name, int64_t start, int64_t end, int64_t children = 0); // children：嵌套在里面的计时
+    static void Counter(const char* name, int64_t value);
+    static void FrameMark(); // 主循环每帧开头调用
+    static void GpuBegin();  // 包住 ImGui_ImplOpenGL3_RenderDrawData 的 GL 计时查询
+    static void GpuEnd();
+    static void DrawOverlay();
+    static bool DumpTrace(const char* path, float seconds);
+};
+
+// 同一线程上的计时按栈嵌套，结束时把自己的时长记到外层的 children 上，汇总时外层只算自己的部分
+struct ProfileScope {
+    static thread_local ProfileScope* current;
+    const char* name;
+    int64_t start;
+    int64_t children = 0;
+    ProfileScope* parent;
+    explicit ProfileScope(const char* n) : name(n), start(Profiler::Now()), parent(current) { current = this; }
+    ~ProfileScope() {
+        int64_t end = Profiler::Now();
+        current = parent;
+        if (parent) parent->children += end - start;
+        Profiler::Record(name, start, end, children);
+    }
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::Counter(name, (int64_t)(value))
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+
+#endif
\ No newline at end of file
@@ -1,10 +1,19 @@
 #include "Renderer.h"
+#include "SoftRenderer.h"
+#include "TileCanvas.h"
+#include "BrushRegistry.h"
+#include "Profiler.h"
 #include <backends/imgui_impl_opengl3.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 #include <iostream>
+BakeBackend Renderer::backend = BakeBackend::OpenGL;
 GLuint Renderer::fbo = 0;
-GLuint Renderer::bakedTexture = 0;
+bool Renderer::vertexPulling = false;
+bool Renderer::stampsAvailable = false;
+bool Renderer::brushMipmaps = false;
+size_t Renderer::stampUploadBytes = 0;
+int Renderer::stampsDrawn = 0;
 
 
 GLuint Renderer::texCrayon = 0;
@@ -12,13 +21,37 @@ GLuint Renderer::texPencil = 0;
 GLuint Renderer::texWatercolor = 0;
 
 #include <filesystem> // C++17 标准库
+#include <atomic>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "AssetCache.h"
+#include "ThreadPool.h"
 namespace fs = std::filesystem;
 
-std::map<std::string, GLuint> Renderer::brushTextures;
-std::vector<std::string> Renderer::brushNames;
+
+// ---------------- 笔刷加载 ----------------
+// ScanAssets 先用占位纹理注册所有笔刷，PNG 解码（或读缓存）放到线程池里；
+// 主线程每帧 PumpAssets 把解码完的图片上传成纹理。GL 调用只在主线程。
+struct DecodedBrush {
+    int brush;
+    bool fromCache;
+    DecodedImage image;
+};
+static std::mutex decodedMutex;
+static std::vector<DecodedBrush> decodedBrushes;
+static std::atomic<int> pendingDecodes{0};
+static int loadedFromCache = 0, loadedTotal = 0;
+static std::chrono::steady_clock::time_point scanStart;
+static std::vector<DecodedImage> brushImages; // 按笔刷 id 暂存，全部到齐后打成图集
 
 void Renderer::ScanAssets() {
+    PROFILE_SCOPE("Renderer::ScanAssets");
     std::string path = "assets";
+    scanStart = std::chrono::steady_clock::now();
+    loadedFromCache = loadedTotal = 0;
     
     // 确保目录存在
     if (!fs::exists(path)) {
@@ -26,27 +59,155 @@ void Renderer::ScanAssets() {
         return;
     }
 
+    // 按文件名排序，保证每次启动分配到的笔刷 id 一样
+    std::vector<fs::path> files;
     for (const auto& entry : fs::directory_iterator(path)) {
-        if (entry.path().extension() == ".png" || entry.path().extension() == ".jpg") {
-            std::string filePath = entry.path().string();
-            // 获取不带路径和后缀的文件名作为笔刷名 (例如 brush_crayon)
-            std::string fileName = entry.path().stem().string(); 
-            
-            GLuint texID = LoadTexture(filePath.c_str());
-            if (texID != 0) {
-                brushTextures[fileName] = texID;
-                brushNames.push_back(fileName);
-                std::cout << "Loaded brush: " << fileName << " (ID: " << texID << ")" << std::endl;
+        if (entry.path().extension() == ".png" || entry.path().extension() == ".jpg")
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    // 1x1 白色占位纹理，解码完成前笔刷先画成实心方块
+    static const unsigned char white[4] = {255, 255, 255, 255};
+    GLuint placeholder = CreateTexture(1, 1, white);
+
+    for (const auto& file : files) {
+        std::string filePath = file.string();
+        // 获取不带路径和后缀的文件名作为笔刷名 (例如 brush_crayon)
+        std::string fileName = file.stem().string(); 
+        // 同名的 .brush 文件里是这个笔刷的参数
+        std::string sidecar = fs::path(file).replace_extension(".brush").string();
+        int id = BrushRegistry::Register(fileName, placeholder, sidecar);
+
+        pendingDecodes++;
+        ThreadPool::Submit([id, filePath] {
+            DecodedBrush d;
+            d.brush = id;
+            if (!AssetCache::Decode(filePath, d.image, d.fromCache)) {
+                std::cout << "Failed to decode " << filePath << std::endl;
+                d.image.w = 0;
+            }
+            std::lock_guard<std::mutex> lock(decodedMutex);
+            decodedBrushes.push_back(std::move(d));
+        });
+    }
+}
+
+void Renderer::PumpAssets() {
+    PROFILE_SCOPE("Renderer::PumpAssets");
+    std::vector<DecodedBrush> ready;
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        if (decodedBrushes.empty()) return;
+        ready.swap(decodedBrushes);
+    }
+    for (auto& d : ready) {
+        pendingDecodes--;
+        if (d.image.w == 0) continue;
+        GLuint tex = CreateTexture(d.image);
+        BrushRegistry::SetTexture(d.brush, tex);
+        if ((int)brushImages.size() <= d.brush) brushImages.resize(d.brush + 1);
+        brushImages[d.brush] = std::move(d.image);
+        loadedTotal++;
+        if (d.fromCache) loadedFromCache++;
+        std::cout << "Loaded brush: " << BrushRegistry::profiles[d.brush].name << " (ID: " << d.brush << ", tex: " << tex
+                  << (d.fromCache ? ", cached" : "") << ")" << std::endl;
+    }
+    if (pendingDecodes == 0) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scanStart).count();
+        std::cout << "Brush startup: " << loadedTotal << " brushes in " << ms << " ms (" << loadedFromCache << " from cache)" << std::endl;
+        BuildAtlas();
+    }
+}
+
+// 每个笔刷四周留 2^levels 个纹素的边，边里复制边缘像素；方格的位置和边长都是 2^levels 的倍数，
+// 方格按高度从大到小逐行（shelf）摆进一张宽 ATLAS_W 的图集。这样第 k 级 mip 里方格正好是原来的 1/2^k，
+// 边还剩 2^(levels-k) ≥ 1 个纹素，每一级双线性采样都碰不到邻居，UV 也就不用往里收。
+// 级数最多 ATLAS_LEVELS：边随级数翻倍，再深图集就太大了，更小的印章由最后一级继续缩小
+void Renderer::BuildAtlas() {
+    PROFILE_SCOPE("Renderer::BuildAtlas");
+    const int ATLAS_W = 2048;
+    const int ATLAS_LEVELS = 4;
+    std::vector<int> order;
+    int minSide = ATLAS_W;
+    for (int i = 0; i < (int)brushImages.size(); i++) {
+        if (brushImages[i].w <= 0) continue;
+        order.push_back(i);
+        minSide = std::min({minSide, brushImages[i].w, brushImages[i].h});
+    }
+    if (order.empty()) return;
+    int levels = 0;
+    while (levels < ATLAS_LEVELS && (2 << levels) <= minSide) levels++;
+    const int pad = 1 << levels;
+    auto boxOf = [&](int size) { return (size + 2 * pad + pad - 1) & ~(pad - 1); };
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return brushImages[a].h > brushImages[b].h; });
+
+    struct Slot { int x, y, w, h; };
+    std::vector<Slot> slots(brushImages.size());
+    int x = 0, y = 0, shelfH = 0;
+    for (int id : order) {
+        int w = boxOf(brushImages[id].w), h = boxOf(brushImages[id].h);
+        if (w > ATLAS_W) return;
+        if (x + w > ATLAS_W) { x = 0; y += shelfH; shelfH = 0; }
+        slots[id] = {x, y, w, h};
+        x += w;
+        shelfH = std::max(shelfH, h);
+    }
+    int atlasH = 1;
+    while (atlasH < y + shelfH) atlasH *= 2;
+    if (backend == BakeBackend::OpenGL) {
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        if (atlasH > maxSize) return; // 放不下就继续用单独的纹理
+    }
+
+    DecodedImage atlas;
+    atlas.w = ATLAS_W;
+    atlas.h = atlasH;
+    atlas.rgba.assign((size_t)ATLAS_W * atlasH * 4, 0);
+    for (int k = 1; k <= levels; k++) atlas.mips.emplace_back((size_t)MipSize(ATLAS_W, k) * MipSize(atlasH, k) * 4, 0);
+    for (int id : order) {
+        const DecodedImage& img = brushImages[id];
+        Slot s = slots[id];
+        for (int k = 0; k <= levels; k++) {
+            int sk = std::min(k, (int)img.mips.size());
+            const unsigned char* src = sk == 0 ? img.rgba.data() : img.mips[sk - 1].data();
+            unsigned char* dst = k == 0 ? atlas.rgba.data() : atlas.mips[k - 1].data();
+            int sw = MipSize(img.w, sk), sh = MipSize(img.h, sk), aw = MipSize(ATLAS_W, k), edge = pad >> k;
+            for (int ty = 0; ty < s.h >> k; ty++) {
+                int sy = std::clamp(ty - edge, 0, sh - 1);
+                for (int tx = 0; tx < s.w >> k; tx++) {
+                    int sx = std::clamp(tx - edge, 0, sw - 1);
+                    memcpy(&dst[((size_t)((s.y >> k) + ty) * aw + ((s.x >> k) + tx)) * 4], &src[((size_t)sy * sw + sx) * 4], 4);
+                }
             }
         }
+        BrushProfile& p = BrushRegistry::profiles[id];
+        p.atlasUvMin = {(float)(s.x + pad) / ATLAS_W, (float)(s.y + pad) / atlasH};
+        p.atlasUvMax = {(float)(s.x + pad + img.w) / ATLAS_W, (float)(s.y + pad + img.h) / atlasH};
     }
+
+    GLuint tex = CreateTexture(atlas);
+    BrushRegistry::SetAtlas(tex);
+    brushImages.clear();
+    std::cout << "Brush atlas: " << order.size() << " brushes in " << ATLAS_W << "x" << atlasH << ", " << levels << " mip levels"
+              << std::endl;
 }
 
-GLuint Renderer::LoadTexture(const char* path) {
-    int w, h, channels;
-    stbi_set_flip_vertically_on_load(false); // 保持和ImGui一致
-    unsigned char* data = stbi_load(path, &w, &h, &channels, 4);
-    if (!data) return 0;
+bool Renderer::AssetsPending() {
+    return pendingDecodes > 0;
+}
+
+void Renderer::WaitForAssets() {
+    while (AssetsPending()) {
+        PumpAssets();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+GLuint Renderer::CreateTexture(int w, int h, const unsigned char* rgba) {
+    PROFILE_SCOPE("Renderer::CreateTexture");
+    if (backend == BakeBackend::Software) return SoftRenderer::CreateTexture(w, h, rgba);
 
     GLuint tex;
     glGenTextures(1, &tex);
@@ -57,26 +218,472 @@ GLuint Renderer::LoadTexture(const char* path) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    return tex;
+}
+
+GLuint Renderer::CreateTexture(const DecodedImage& img, int levels) {
+    PROFILE_SCOPE("Renderer::CreateTexture");
+    if (levels < 0 || levels > (int)img.mips.size()) levels = (int)img.mips.size();
+    if (backend == BakeBackend::Software) return SoftRenderer::CreateTexture(img, levels);
+
+    GLuint tex = CreateTexture(img.w, img.h, img.rgba.data());
+    for (int k = 1; k <= levels; k++)
+        glTexImage2D(GL_TEXTURE_2D, k, GL_RGBA, MipSize(img.w, k), MipSize(img.h, k), 0, GL_RGBA, GL_UNSIGNED_BYTE, img.mips[k - 1].data());
+    // 图集只有前几级，超出的级别不存在，纹理要按 MAX_LEVEL 才算完整
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels);
+    if (brushMipmaps && levels > 0) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    return tex;
+}
+
+void Renderer::SetBrushMipmaps(bool enabled) {
+    brushMipmaps = enabled;
+    SoftRenderer::mipmaps = enabled;
+    if (backend == BakeBackend::Software) return;
+    std::vector<GLuint> textures = {BrushRegistry::atlasTexture};
+    for (const BrushProfile& p : BrushRegistry::profiles) textures.push_back(p.ownTexture);
+    for (GLuint tex : textures) {
+        if (tex == 0) continue;
+        GLint levels = 0;
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &levels);
+        if (levels > 0) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, enabled ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLuint Renderer::LoadTexture(const char* path) {
+    int w, h, channels;
+    stbi_set_flip_vertically_on_load(false); // 保持和ImGui一致
+    unsigned char* data = stbi_load(path, &w, &h, &channels, 4);
+    if (!data) return 0;
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    GLuint tex = CreateTexture(w, h, data);
     stbi_image_free(data);
     return tex;
 }
 
+// ---------------- 顶点拉取印章 ----------------
+// 一帧里所有要画的印章记录按提交顺序放在 stampRecords 里，每个 StampBatch 是其中连续的一段，
+// 由 ImDrawList 回调在 ImGui 画到那里时用一次 glDrawArrays 画出来：记录放在缓冲纹理里，
+// 顶点着色器按 gl_VertexID / 6 取记录展开成两个三角形（软件光栅逐实例处理实例化绘制，这样快得多）。
+// 上传时跳过和 GPU 上那份相同的前缀：没变的笔画每帧记录都一样，正在画的那笔在最后，
+// 所以平时每帧只上传新长出来的印章。
+struct StampRecord {
+    float x, y, a, b; // StampInstance
+    ImU32 color;
+    int32_t brush;    // brushUvTexture 的列；无效的笔刷指向最后一列（默认 UV）
+};
+
+struct StampBatch {
+    const ImDrawList* list;
+    int cmd; // 回调在 list->CmdBuffer 里的下标
+    int first, count;
+    GLuint texture;
+    ImVec2 origin;
+    float zoom;
+    ImVec2 clipMin, clipMax;
+};
+
+struct StampRange {
+    int first, count;
+    ImU32 color;
+    int brush;
+};
+
+struct StampMarkPos {
+    size_t records, batches;
+};
+
+static std::vector<StampRecord> stampRecords, gpuRecords; // gpuRecords：stampVbo 里现在的内容
+static size_t syncedRecords = 0;                          // stampRecords 前这么多条已经在 GPU 上
+static std::vector<StampBatch> stampBatches;
+static std::unordered_map<int, StampRange> stampRanges;   // 笔画 id -> 这一帧已经放进 stampRecords 的那段
+static ImDrawData* currentDrawData = nullptr;
+static size_t frameUploadBytes = 0;
+static int frameStamps = 0;
+
+static GLuint stampProgram = 0, stampVao = 0, stampVbo = 0, brushUvTexture = 0;
+static size_t stampVboBytes = 0;
+static GLint locOrigin, locZoom, locDisplayPos, locDisplaySize, locFirst;
+static GLuint recordTexture = 0;
+static size_t maxStampRecords = 0; // GL_MAX_TEXTURE_BUFFER_SIZE / 3：缓冲纹理能寻址的记录数
+static int uvGeneration = -1, uvCount = -1;
+
+static const char* STAMP_VS = R"(#version 330 core
+uniform usamplerBuffer Records;      // 每条记录 3 个 RG32UI：xy, ab, (颜色, 笔刷)
+uniform int First;
+uniform sampler2D BrushUV;           // 第 i 列是笔刷 i 的 (uvMin, uvMax)
+uniform vec2 Origin;
+uniform float Zoom;
+uniform vec2 DisplayPos;
+uniform vec2 DisplaySize;
+uniform float MinStampPx;            // 屏幕上边长小于它的印章整个丢到裁剪区外
+out vec2 Frag_UV;
+out vec4 Frag_Color;
+const vec2 CORNERS[6] = vec2[6](vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, -1), vec2(1, 1), vec2(-1, 1));
+void main() {
+    int k = (First + gl_VertexID / 6) * 3;
+    vec4 stamp = uintBitsToFloat(uvec4(texelFetch(Records, k).xy, texelFetch(Records, k + 1).xy));
+    uvec2 cb = texelFetch(Records, k + 2).xy;
+    vec2 o = CORNERS[gl_VertexID % 6];
+    vec2 p = stamp.xy + o.x * stamp.zw + o.y * vec2(-stamp.w, stamp.z);
+    vec2 ndc = (Origin + p * Zoom - DisplayPos) / DisplaySize * 2.0 - 1.0;
+    gl_Position = 2.0 * length(stamp.zw) * Zoom < MinStampPx ? vec4(2.0, 2.0, 2.0, 1.0) : vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    vec4 uv = texelFetch(BrushUV, ivec2(int(cb.y), 0), 0);
+    Frag_UV = mix(uv.xy, uv.zw, o * 0.5 + 0.5);
+    Frag_Color = vec4((cb.xxxx >> uvec4(0u, 8u, 16u, 24u)) & 0xFFu) / 255.0;
+}
+)";
+
+// 和 ImGui 的片元着色器一样：顶点色乘纹理
+static const char* STAMP_FS = R"(#version 330 core
+in vec2 Frag_UV;
+in vec4 Frag_Color;
+uniform sampler2D Texture;
+layout (location = 0) out vec4 Out_Color;
+void main() {
+    Out_Color = Frag_Color * texture(Texture, Frag_UV);
+}
+)";
+
+static GLuint CompileShader(GLenum type, const char* src) {
+    GLuint sh = glCreateShader(type);
+    glShaderSource(sh, 1, &src, nullptr);
+    glCompileShader(sh);
+    GLint ok = 0;
+    glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(sh, sizeof(log), nullptr, log);
+        std::cout << "Stamp shader: " << log << std::endl;
+        glDeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+static bool InitStampShader() {
+    GLuint vs = CompileShader(GL_VERTEX_SHADER, STAMP_VS), fs = CompileShader(GL_FRAGMENT_SHADER, STAMP_FS);
+    if (!vs || !fs) return false;
+    stampProgram = glCreateProgram();
+    glAttachShader(stampProgram, vs);
+    glAttachShader(stampProgram, fs);
+    glLinkProgram(stampProgram);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint ok = 0;
+    glGetProgramiv(stampProgram, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        std::cout << "Stamp shader link failed, using CPU stamp vertices" << std::endl;
+        glDeleteProgram(stampProgram);
+        stampProgram = 0;
+        return false;
+    }
+    locOrigin = glGetUniformLocation(stampProgram, "Origin");
+    locZoom = glGetUniformLocation(stampProgram, "Zoom");
+    locDisplayPos = glGetUniformLocation(stampProgram, "DisplayPos");
+    locDisplaySize = glGetUniformLocation(stampProgram, "DisplaySize");
+    glUseProgram(stampProgram);
+    glUniform1i(glGetUniformLocation(stampProgram, "Texture"), 0);
+    glUniform1i(glGetUniformLocation(stampProgram, "BrushUV"), 1);
+    glUniform1i(glGetUniformLocation(stampProgram, "Records"), 2);
+    locFirst = glGetUniformLocation(stampProgram, "First");
+    glUniform1f(glGetUniformLocation(stampProgram, "MinStampPx"), MIN_STAMP_PX);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &stampVao);
+    glGenBuffers(1, &stampVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, stampVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenTextures(1, &recordTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, stampVbo); // 重新分配缓冲后仍然指向它
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels); // GL 3.3 只保证 65536 个纹素
+    maxStampRecords = (size_t)std::max(maxTexels, 0) / 3;
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &brushUvTexture);
+    glBindTexture(GL_TEXTURE_2D, brushUvTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    std::cout << "Vertex-pulling stamp renderer ready" << std::endl;
+    return true;
+}
+
+// 笔刷 UV 随图集开关变化，和笔画缓存一样按 generation 重建
+static void UpdateBrushUVs() {
+    int n = (int)BrushRegistry::profiles.size();
+    if (uvGeneration == BrushRegistry::generation && uvCount == n) return;
+    std::vector<float> uv((size_t)(n + 1) * 4);
+    for (int i = 0; i <= n; i++) {
+        const BrushProfile& p = BrushRegistry::Get(i < n ? i : -1);
+        uv[i * 4 + 0] = p.uvMin.x; uv[i * 4 + 1] = p.uvMin.y;
+        uv[i * 4 + 2] = p.uvMax.x; uv[i * 4 + 3] = p.uvMax.y;
+    }
+    glBindTexture(GL_TEXTURE_2D, brushUvTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, n + 1, 1, 0, GL_RGBA, GL_FLOAT, uv.data());
+    uvGeneration = BrushRegistry::generation;
+    uvCount = n;
+}
+
+static void SyncStampBuffer() {
+    size_t n = stampRecords.size();
+    if (syncedRecords >= n) return;
+    size_t same = syncedRecords, m = std::min(n, gpuRecords.size());
+    while (same < m && memcmp(&stampRecords[same], &gpuRecords[same], sizeof(StampRecord)) == 0) same++;
+    syncedRecords = n;
+    if (same == n) return;
+
+    PROFILE_SCOPE("Renderer::SyncStampBuffer");
+    size_t bytes = n * sizeof(StampRecord);
+    glBindBuffer(GL_ARRAY_BUFFER, stampVbo);
+    if (bytes > stampVboBytes) {
+        stampVboBytes = std::max(bytes, stampVboBytes * 2);
+        glBufferData(GL_ARRAY_BUFFER, stampVboBytes, nullptr, GL_DYNAMIC_DRAW);
+        same = 0;
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, same * sizeof(StampRecord), (n - same) * sizeof(StampRecord), &stampRecords[same]);
+    gpuRecords.resize(n);
+    memcpy(&gpuRecords[same], &stampRecords[same], (n - same) * sizeof(StampRecord));
+    frameUploadBytes += (n - same) * sizeof(StampRecord);
+}
+
+static void DrawStampBatch(const ImDrawList*, const ImDrawCmd* cmd) {
+    const StampBatch& b = stampBatches[(size_t)(intptr_t)cmd->UserCallbackData];
+    ImDrawData* dd = currentDrawData;
+    if (!dd || b.count == 0) return;
+    SyncStampBuffer();
+    UpdateBrushUVs();
+
+    // 和 ImGui 后端一样把裁剪矩形换算到帧缓冲（左下角为原点）
+    ImVec2 scale = dd->FramebufferScale;
+    float fbH = dd->DisplaySize.y * scale.y;
+    ImVec2 clipMin = {(b.clipMin.x - dd->DisplayPos.x) * scale.x, (b.clipMin.y - dd->DisplayPos.y) * scale.y};
+    ImVec2 clipMax = {(b.clipMax.x - dd->DisplayPos.x) * scale.x, (b.clipMax.y - dd->DisplayPos.y) * scale.y};
+    if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) return;
+    glScissor((int)clipMin.x, (int)(fbH - clipMax.y), (int)(clipMax.x - clipMin.x), (int)(clipMax.y - clipMin.y));
+
+    glUseProgram(stampProgram);
+    glUniform2f(locOrigin, b.origin.x, b.origin.y);
+    glUniform1f(locZoom, b.zoom);
+    glUniform2f(locDisplayPos, dd->DisplayPos.x, dd->DisplayPos.y);
+    glUniform2f(locDisplaySize, dd->DisplaySize.x, dd->DisplaySize.y);
+    glUniform1i(locFirst, b.first);
+    glBindVertexArray(stampVao); // 没有顶点属性，core profile 也要绑一个 VAO
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, brushUvTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, b.texture);
+    glDrawArrays(GL_TRIANGLES, 0, b.count * 6);
+    frameStamps += b.count;
+}
+
+static StampMarkPos StampMark() {
+    return {stampRecords.size(), stampBatches.size()};
+}
+
+// 丢掉 mark 之后放进来的记录和批次（烘焙用完的）
+static void TrimStamps(StampMarkPos mark) {
+    stampRecords.resize(mark.records);
+    stampBatches.resize(mark.batches);
+    syncedRecords = std::min(syncedRecords, mark.records);
+    for (auto it = stampRanges.begin(); it != stampRanges.end();) {
+        if ((size_t)it->second.first >= mark.records) it = stampRanges.erase(it);
+        else ++it;
+    }
+}
+
+void Renderer::DrawStroke(ImDrawList* dl, const StrokeStore& strokes, size_t i, ImVec2 canvasP0, float zoom) {
+    if (vertexPulling) DrawStamps(dl, strokes, i, canvasP0, zoom);
+    else RenderStroke(dl, strokes, i, canvasP0, zoom);
+}
+
+void Renderer::DrawStamps(ImDrawList* dl, const StrokeStore& strokes, size_t i, ImVec2 canvasP0, float zoom) {
+    if (strokes.length[i] < 2) return;
+    EnsureStrokeCache(strokes, i);
+    const std::vector<StampInstance>& stamps = strokes.Cache(i).stamps;
+    if (stamps.empty()) return;
+
+    // 包围盒完全在裁剪区外就不画
+    ImVec2 clipMin = dl->GetClipRectMin(), clipMax = dl->GetClipRectMax();
+    const ImVec2& bmin = strokes.boundsMin[i];
+    const ImVec2& bmax = strokes.boundsMax[i];
+    if (bmax.x * zoom + canvasP0.x < clipMin.x || bmin.x * zoom + canvasP0.x > clipMax.x ||
+        bmax.y * zoom + canvasP0.y < clipMin.y || bmin.y * zoom + canvasP0.y > clipMax.y) return;
+    // 整笔的印章都小于 MIN_STAMP_PX 就不放记录；只有一部分小的由顶点着色器逐个丢掉
+    int brush = strokes.brush[i];
+    if (2.0f * strokes.thickness[i] * (1.0f + BrushRegistry::Get(brush).jitterSize) * zoom < MIN_STAMP_PX) return;
+
+    // 同一帧里同一笔只放一次记录（烘焙时每块瓦片都会画它）；正在画的笔画印章变多了就重新放
+    ImU32 color = strokes.color[i];
+    int column = brush >= 0 && brush < (int)BrushRegistry::profiles.size() ? brush : (int)BrushRegistry::profiles.size();
+    auto found = stampRanges.find(strokes.id[i]);
+    StampRange r;
+    if (found != stampRanges.end() && found->second.count == (int)stamps.size() && found->second.color == color &&
+        found->second.brush == column) {
+        r = found->second;
+    } else {
+        // 这一帧的记录超出缓冲纹理能寻址的范围时，这一笔退回 CPU 顶点
+        if (stampRecords.size() + stamps.size() > maxStampRecords) {
+            RenderStroke(dl, strokes, i, canvasP0, zoom);
+            return;
+        }
+        r = {(int)stampRecords.size(), (int)stamps.size(), color, column};
+        stampRecords.reserve(stampRecords.size() + stamps.size());
+        for (const StampInstance& s : stamps) stampRecords.push_back({s.x, s.y, s.a, s.b, color, column});
+        stampRanges[strokes.id[i]] = r;
+    }
+
+    // 紧接着上一批（同一个 draw list，中间没有别的命令，纹理、变换、裁剪都一样）就并进去
+    GLuint texture = BrushRegistry::Get(brush).texture;
+    if (!stampBatches.empty()) {
+        StampBatch& b = stampBatches.back();
+        const ImDrawCmd& cb = dl->CmdBuffer[std::min(b.cmd, dl->CmdBuffer.Size - 1)];
+        if (b.list == dl && dl->CmdBuffer.Size == b.cmd + 3 && dl->CmdBuffer.back().ElemCount == 0 &&
+            cb.UserCallback == DrawStampBatch && cb.UserCallbackData == (void*)(intptr_t)(stampBatches.size() - 1) &&
+            b.first + b.count == r.first && b.texture == texture && b.origin.x == canvasP0.x && b.origin.y == canvasP0.y &&
+            b.zoom == zoom && b.clipMin.x == clipMin.x && b.clipMin.y == clipMin.y && b.clipMax.x == clipMax.x &&
+            b.clipMax.y == clipMax.y) {
+            b.count += r.count;
+            return;
+        }
+    }
+    stampBatches.push_back({dl, 0, r.first, r.count, texture, canvasP0, zoom, clipMin, clipMax});
+    dl->AddCallback(DrawStampBatch, (void*)(intptr_t)(stampBatches.size() - 1));
+    // 画完让 ImGui 后端把自己的 shader、VAO、纹理绑回去
+    dl->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    stampBatches.back().cmd = dl->CmdBuffer.Size - 3;
+}
+
+void Renderer::RenderDrawData(ImDrawData* data) {
+    currentDrawData = data;
+    ImGui_ImplOpenGL3_RenderDrawData(data);
+    currentDrawData = nullptr;
+}
+
+// ---------------- 异步回读 ----------------
+// busy 从发出一直到回调返回、解除映射为止，回调里再发回读也不会落到正映射着的 PBO 上
+struct Readback {
+    GLuint pbo = 0;
+    size_t capacity = 0;
+    GLsync fence = nullptr;
+    bool busy = false;
+    int w = 0, h = 0;
+    Renderer::ReadbackFn done;
+};
+static Readback readbacks[Renderer::READBACK_SLOTS];
+static int readbacksPending = 0;
+
+struct PixelSample {
+    ImVec2 pos;
+    std::function<void(ImU32)> done;
+};
+static std::vector<PixelSample> pixelSamples; // 这一帧插进 draw list 的取色，EndFrame 清空
+
+bool Renderer::ReadAsync(int x, int y, int w, int h, ReadbackFn done) {
+    if (!GLAD_GL_VERSION_3_2 || w <= 0 || h <= 0) return false;
+    Readback* r = std::find_if(std::begin(readbacks), std::end(readbacks), [](const Readback& s) { return !s.busy; });
+    if (r == std::end(readbacks)) return false;
+    size_t bytes = (size_t)w * h * 4;
+    if (!r->pbo) glGenBuffers(1, &r->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, r->pbo);
+    if (bytes > r->capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STREAM_READ);
+        r->capacity = bytes;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    r->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->busy = true;
+    r->w = w;
+    r->h = h;
+    r->done = std::move(done);
+    readbacksPending++;
+    return true;
+}
+
+int Renderer::ReadbacksPending() {
+    return readbacksPending;
+}
+
+// 只收 fence 已经到了的，没到的留到下一帧，主线程从不等 GPU
+static void PumpReadbacks() {
+    if (readbacksPending == 0) return;
+    PROFILE_SCOPE("Renderer::PumpReadbacks");
+    for (Readback& r : readbacks) {
+        if (!r.busy || glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) continue;
+        glDeleteSync(r.fence);
+        r.fence = nullptr;
+        Renderer::ReadbackFn done = std::move(r.done);
+        r.done = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+        const void* p = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)r.w * r.h * 4, GL_MAP_READ_BIT);
+        done((const unsigned char*)p, r.w, r.h);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+        if (p) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        r.busy = false;
+        readbacksPending--;
+    }
+}
+
+// 画到这里时帧缓冲里已经有了前面画的东西；和裁剪矩形一样按 draw data 换算到帧缓冲（左下角为原点）
+static void ReadPixelSample(const ImDrawList*, const ImDrawCmd* cmd) {
+    PixelSample& s = pixelSamples[(size_t)(intptr_t)cmd->UserCallbackData];
+    ImDrawData* dd = currentDrawData;
+    if (!dd || !s.done) return;
+    ImVec2 scale = dd->FramebufferScale;
+    int x = (int)((s.pos.x - dd->DisplayPos.x) * scale.x), y = (int)((s.pos.y - dd->DisplayPos.y) * scale.y);
+    int fbW = (int)(dd->DisplaySize.x * scale.x), fbH = (int)(dd->DisplaySize.y * scale.y);
+    if (x < 0 || y < 0 || x >= fbW || y >= fbH) return;
+    std::function<void(ImU32)> done = std::move(s.done);
+    Renderer::ReadAsync(x, fbH - 1 - y, 1, 1, [done](const unsigned char* px, int, int) {
+        if (px) done(IM_COL32(px[0], px[1], px[2], px[3]));
+    });
+}
+
+void Renderer::SamplePixel(ImDrawList* dl, ImVec2 pos, std::function<void(ImU32 color)> done) {
+    pixelSamples.push_back({pos, std::move(done)});
+    dl->AddCallback(ReadPixelSample, (void*)(intptr_t)(pixelSamples.size() - 1));
+}
+
+void Renderer::EndFrame() {
+    PumpReadbacks();
+    pixelSamples.clear();
+    stampUploadBytes = frameUploadBytes;
+    stampsDrawn = frameStamps;
+    PROFILE_COUNTER("stamp upload KB", frameUploadBytes >> 10);
+    PROFILE_COUNTER("stamps drawn", frameStamps);
+    frameUploadBytes = 0;
+    frameStamps = 0;
+    TrimStamps({0, 0});
+}
+
 #include<iostream>
-void Renderer::Init() {
-    glGenTextures(1, &bakedTexture);
-    glBindTexture(GL_TEXTURE_2D, bakedTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, CANVAS_W, CANVAS_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void Renderer::Init(BakeBackend want) {
+    // 没有 GL 上下文（gladLoadGLLoader 没成功）时改用软件后端，方便在无显卡的机器上烘焙/比对画布。
+    // 已经有 GL 上下文时也可以再切到软件后端（BackendBench），笔刷按名字重新注册成软件纹理
+    if (want == BakeBackend::Software || !GLAD_GL_VERSION_3_0) {
+        backend = BakeBackend::Software;
+        std::cout << (GLAD_GL_VERSION_3_0 ? "Using" : "No GL context, using") << " software bake backend" << std::endl;
+        SoftRenderer::Init();
+        TileCanvas::Init(canvasW, canvasH);
+        ScanAssets();
+        return;
+    }
+    backend = BakeBackend::OpenGL;
 
+    // 底图是 TileCanvas 的一块块瓦片纹理，烘焙时把这个 FBO 轮流绑到要画的瓦片上
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bakedTexture, 0);
-    
-    ClearTexture();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    TileCanvas::Init(canvasW, canvasH);
+    stampsAvailable = GLAD_GL_VERSION_3_3 && InitStampShader();
+    vertexPulling = false; // 见 Renderer.h，侧栏里可以打开
 
     // texCrayon = LoadTexture("assets/brush_crayon.png");
     // texPencil = LoadTexture("assets/brush_pencil.png");
@@ -85,15 +692,80 @@ void Renderer::Init() {
 }
 
 void Renderer::ClearTexture() {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, CANVAS_W, CANVAS_H);
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    TileCanvas::Clear();
+}
+
+void Renderer::ReadRegion(int x, int y, int w, int h, unsigned char* out) {
+    PROFILE_SCOPE("Renderer::ReadRegion");
+    TileCanvas::Read(x, y, w, h, out);
 }
 
-void Renderer::PerformBake(std::vector<Stroke>& strokes) {
+void Renderer::WriteRegion(int x, int y, int w, int h, const unsigned char* rgba) {
+    PROFILE_SCOPE("Renderer::WriteRegion");
+    TileCanvas::Write(x, y, w, h, rgba);
+}
+
+void Renderer::PerformBake(StrokeStore& strokes) {
+    PROFILE_SCOPE("Renderer::PerformBake");
     if (strokes.empty()) return;
+    BakeStrokes(strokes, 0, strokes.size());
+    strokes.Clear();
+}
+
+void Renderer::BeginTile(ImDrawList* dl, ImVec2 origin, int size) {
+    float s = (float)(size > 0 ? size : TileCanvas::TILE);
+    dl->_ResetForNewFrame();
+    // 重置后的 Flags 来自 NewFrame 里按后端能力设的 InitialFlags，离屏的 list 不一定经过那里；
+    // RenderStroke 分批写 16 位索引，超过 65536 个顶点要靠 VtxOffset 换批，这里总是打开（我们要求 GL 3.3，后端会用 BaseVertex 画）
+    dl->Flags |= ImDrawListFlags_AllowVtxOffset;
+    dl->PushTextureID(ImGui::GetIO().Fonts->TexID);
+    dl->PushClipRect(origin, {origin.x + s, origin.y + s});
+}
+
+void Renderer::RenderTile(ImDrawList* dl, ImVec2 origin, int size, int scale) {
+    float s = (float)(size > 0 ? size : TileCanvas::TILE);
+    dl->PopClipRect();
+    dl->PopTextureID();
+    ImDrawData drawData;
+    drawData.Valid = true;
+    drawData.CmdListsCount = 1;
+    drawData.CmdLists.push_back(dl);
+    drawData.TotalVtxCount = dl->VtxBuffer.Size;
+    drawData.TotalIdxCount = dl->IdxBuffer.Size;
+    drawData.DisplayPos = origin;
+    drawData.DisplaySize = ImVec2(s, s);
+    drawData.FramebufferScale = ImVec2((float)scale, (float)scale);
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    RenderDrawData(&drawData);
+}
+
+// 只把 [first, last) 这几笔叠加到底图上，不清空也不改动 strokes
+void Renderer::BakeStrokes(const StrokeStore& strokes, size_t first, size_t last) {
+    PROFILE_SCOPE("Renderer::BakeStrokes");
+    if (first >= last) return;
+    if (backend == BakeBackend::Software) {
+        SoftRenderer::Bake(strokes, first, last);
+        return;
+    }
+    // 只画包围盒碰到的瓦片（没画过的瓦片这时才分配）
+    const int TILE = TileCanvas::TILE;
+    std::vector<uint32_t> touched;
+    for (size_t i = first; i < last; i++) {
+        if (strokes.Count(i) < 2) continue;
+        EnsureStrokeCache(strokes, i);
+        if (strokes.Cache(i).stamps.empty()) continue;
+        // 双线性采样可能多碰到 1 像素
+        ImVec2 bmin = strokes.boundsMin[i], bmax = strokes.boundsMax[i];
+        int tx0 = std::max(0, (int)floorf((bmin.x - 1) / TILE)), ty0 = std::max(0, (int)floorf((bmin.y - 1) / TILE));
+        int tx1 = std::min(TileCanvas::TilesX() - 1, (int)floorf((bmax.x + 1) / TILE));
+        int ty1 = std::min(TileCanvas::TilesY() - 1, (int)floorf((bmax.y + 1) / TILE));
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++) touched.push_back((uint32_t)ty << 16 | (uint32_t)tx);
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
     // 开启混合
     glEnable(GL_BLEND);
 
@@ -103,39 +775,26 @@ void Renderer::PerformBake(std::vector<Stroke>& strokes) {
 
     // 如果你想让透明度叠加得更自然（防止透明度丢失），可以使用：
     glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, CANVAS_W, CANVAS_H);
 
+    // 每块瓦片单独一个 draw list，按裁剪区跳过碰不到这块的笔画；
+    // 顶点拉取时每笔的印章记录只放一次，各块瓦片的回调共用，烘完再把这些记录丢掉
+    StampMarkPos stampMark = StampMark();
     ImDrawList* drawList = new ImDrawList(ImGui::GetDrawListSharedData());
-    drawList->_ResetForNewFrame();
-    drawList->PushTextureID(ImGui::GetIO().Fonts->TexID);
-    drawList->PushClipRect(ImVec2(0, 0), ImVec2((float)CANVAS_W, (float)CANVAS_H));
-
-    for (const auto& s : strokes) {
-        if (s.points.size() < 2) continue;
-        
-        // DrawStroke(drawList, s, ImVec2(0, 0));
-        RenderStroke(drawList, s, ImVec2(0, 0));
-        // drawList->AddPolyline(s.points.data(), (int)s.points.size(), s.color, 0, s.thickness);
+    for (uint32_t key : touched) {
+        int tx = (int)(key & 0xFFFF), ty = (int)(key >> 16);
+        ImVec2 origin = {(float)(tx * TILE), (float)(ty * TILE)};
+        BeginTile(drawList, origin);
+        for (size_t i = first; i < last; i++) {
+            if (strokes.Count(i) < 2) continue;
+            DrawStroke(drawList, strokes, i, ImVec2(0, 0));
+        }
+        if (drawList->VtxBuffer.Size == 0 && drawList->CmdBuffer.Size <= 1) continue;
+        TileCanvas::BindTarget(tx, ty);
+        RenderTile(drawList, origin);
     }
-    drawList->PopClipRect();
-    drawList->PopTextureID();
-
-    ImDrawData drawData;
-    drawData.Valid = true;
-    drawData.CmdListsCount = 1;
-    drawData.CmdLists.push_back(drawList);
-    drawData.TotalVtxCount = drawList->VtxBuffer.Size;
-    drawData.TotalIdxCount = drawList->IdxBuffer.Size;
-    drawData.DisplayPos = ImVec2(0, 0);
-    drawData.DisplaySize = ImVec2((float)CANVAS_W, (float)CANVAS_H);
-    drawData.FramebufferScale = ImVec2(1, 1);
-
-    glEnable(GL_BLEND);
-    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    ImGui_ImplOpenGL3_RenderDrawData(&drawData);
+    PROFILE_COUNTER("bake tiles", touched.size());
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    strokes.clear();
     delete drawList;
+    TrimStamps(stampMark);
 }
\ No newline at end of file
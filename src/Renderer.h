@@ -1,23 +1,70 @@
 #pragma once
 #include <glad/glad.h>
 #include "Common.h"
+#include "StrokeStore.h"
 #include <algorithm>
+#include <functional>
 #include <map>
 
+// 烘焙后端：有 GL 上下文时走 FBO，否则走 SoftRenderer 的 CPU 合成
+enum class BakeBackend { OpenGL, Software };
+
+struct DecodedImage;
+
 class Renderer {
 public:
-    static GLuint fbo;
-    static GLuint bakedTexture;
+    static BakeBackend backend;
+    static GLuint fbo; // 烘焙时绑到 TileCanvas 的瓦片纹理上
 
-    static std::map<std::string, GLuint> brushTextures;
-    static std::vector<std::string> brushNames;
     static GLuint texCrayon;
     static GLuint texPencil;
     static GLuint texWatercolor;
 
-    static void Init();
+    static void Init(BakeBackend want = BakeBackend::OpenGL); // 要 Software 或者没有 GL 上下文时用软件后端
     static GLuint LoadTexture(const char* path); // 加载函数
-    static void PerformBake(std::vector<Stroke>& strokes);
+    static GLuint CreateTexture(int w, int h, const unsigned char* rgba);
+    // 连同 img 的 mip 链一起上传，只用前 levels 级（-1 为整条链）
+    static GLuint CreateTexture(const DecodedImage& img, int levels = -1);
+    static void PerformBake(StrokeStore& strokes);
+    static void BakeStrokes(const StrokeStore& strokes, size_t first, size_t last);
+    // 往 size x size（默认 TILE）的目标上画一块：BeginTile 清空 dl 并按这块裁剪，之后按画布坐标往 dl 里加东西，
+    // RenderTile 画进 fbo 当前绑定的纹理（origin 是这块左上角的画布坐标）；scale 是每个画布像素占几个纹素，纹理要有 size * scale 大
+    static void BeginTile(ImDrawList* dl, ImVec2 origin, int size = 0);
+    static void RenderTile(ImDrawList* dl, ImVec2 origin, int size = 0, int scale = 1);
     static void ClearTexture();
+    // 读/写底图的一块矩形，坐标和数据都按画布自上而下的行序（TileCanvas 内部负责翻转）
+    static void ReadRegion(int x, int y, int w, int h, unsigned char* out);
+    static void WriteRegion(int x, int y, int w, int h, const unsigned char* rgba);
+
+    // 异步回读：ReadAsync 把当前读帧缓冲的 (x, y, w, h)（GL 坐标，左下角为原点）读进一个 PBO、插一个 fence 就返回，
+    // 不等 GPU；EndFrame 里轮询 fence，到了才映射出来交给 done（主线程，行自下而上，映射失败时 rgba 为空）。
+    // PBO 按大小复用，最多 READBACK_SLOTS 个同时在路上，发出的这一帧画完、下一帧收，满了返回 false，调用方下一帧再试
+    static const int READBACK_SLOTS = 4;
+    using ReadbackFn = std::function<void(const unsigned char* rgba, int w, int h)>;
+    static bool ReadAsync(int x, int y, int w, int h, ReadbackFn done);
+    static int ReadbacksPending();
+    // 取色：在 dl 当前位置插一个回调，画到这里时异步读回屏幕坐标 pos 下的一个像素，过一两帧交给 done
+    static void SamplePixel(ImDrawList* dl, ImVec2 pos, std::function<void(ImU32 color)> done);
     static void ScanAssets();
+    static void PumpAssets();     // 主线程每帧调用，上传后台解码完的笔刷
+    static bool AssetsPending();
+    static void WaitForAssets();  // 无窗口时用：阻塞到所有笔刷加载完
+    static void BuildAtlas();
+    // 笔刷纹理按印章大小取最接近的一级 mip 再双线性采样（GL_LINEAR_MIPMAP_NEAREST，软件光栅上比三线性少一半采样）；
+    // 关掉时和以前一样只在原图上双线性采样，方便对比
+    // 默认关：StampBench 的细笔画对比里打开后烘焙慢约 6%，帧时间在噪声范围内，没量到收益；缩小时印章闪烁可以在侧栏打开
+    static bool brushMipmaps;
+    static void SetBrushMipmaps(bool enabled);
+
+    // 顶点拉取印章（GL 3.3，glDrawArrays，不是实例化绘制）：每个印章只上传一条 (x, y, a, b, 颜色, 笔刷) 记录，顶点着色器按 gl_VertexID 取记录展开成四边形。
+    // 画布和烘焙都通过 ImDrawList 回调插进 ImGui 的绘制顺序里；没打开时走 RenderStroke 的 CPU 顶点。
+    // 默认关：StampBench 在 llvmpipe 上量到帧时间和 CPU 顶点差不多（画画时还慢一点），细笔画烘焙慢约 35%，只省了上传量
+    static bool vertexPulling;
+    static bool stampsAvailable;
+    static size_t stampUploadBytes; // 上一帧上传了多少印章数据
+    static int stampsDrawn;         // 上一帧画了多少个印章
+    static void DrawStroke(ImDrawList* dl, const StrokeStore& strokes, size_t i, ImVec2 canvasP0, float zoom = 1.0f);
+    static void DrawStamps(ImDrawList* dl, const StrokeStore& strokes, size_t i, ImVec2 canvasP0, float zoom = 1.0f);
+    static void RenderDrawData(ImDrawData* data); // 代替 ImGui_ImplOpenGL3_RenderDrawData，印章回调要用 data 的投影
+    static void EndFrame();                       // 画完一帧后调用，丢掉这一帧的印章记录，收完成的回读
 };
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "SoftRenderer.h"
+#include "BrushRegistry.h"
+#include "TileCanvas.h"
+#include <algorithm>
+#include <cstring>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFT_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+std::vector<SoftRenderer::Texture> SoftRenderer::textures;
+bool SoftRenderer::mipmaps = false; // 跟 Renderer::brushMipmaps 的默认一致
+
+void SoftRenderer::Init() {
+    textures.clear();
+}
+
+GLuint SoftRenderer::CreateTexture(int w, int h, const unsigned char* rgba) {
+    Texture t;
+    t.w = w;
+    t.h = h;
+    t.rgba.assign(rgba, rgba + (size_t)w * h * 4);
+    textures.push_back(std::move(t));
+    return (GLuint)textures.size();
+}
+
+GLuint SoftRenderer::CreateTexture(const DecodedImage& img, int levels) {
+    Texture t;
+    t.w = img.w;
+    t.h = img.h;
+    t.rgba = img.rgba;
+    t.mips.assign(img.mips.begin(), img.mips.begin() + std::min(levels, (int)img.mips.size()));
+    textures.push_back(std::move(t));
+    return (GLuint)textures.size();
+}
+
+// 第 level 级的像素和尺寸
+static inline const unsigned char* LevelPixels(const SoftRenderer::Texture& t, int level, int& w, int& h) {
+    w = MipSize(t.w, level);
+    h = MipSize(t.h, level);
+    return level == 0 ? t.rgba.data() : t.mips[level - 1].data();
+}
+
+#ifdef SOFT_USE_SSE
+static inline __m128i LoadTexel16(const unsigned char* p) {
+    int v;
+    memcpy(&v, p, 4);
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+}
+
+// a + ((b - a) * f + 128) >> 8，a、b 是 16 位的 4 个通道，结果是 32 位；
+// (b - a, 1) 和 (f, 128) 交错后 madd 正好得到 (b - a) * f + 128
+static inline __m128i Lerp8x4(__m128i a, __m128i b, int f) {
+    __m128i d = _mm_unpacklo_epi16(_mm_sub_epi16(b, a), _mm_set1_epi16(1));
+    __m128i t = _mm_srai_epi32(_mm_madd_epi16(d, _mm_set1_epi32((128 << 16) | f)), 8);
+    return _mm_add_epi32(_mm_unpacklo_epi16(a, _mm_setzero_si128()), t);
+}
+
+// 在第 level 级上双线性采样（GL_LINEAR + CLAMP_TO_EDGE），返回 0..255 的 RGBA。
+// 和 llvmpipe 一样按 8 位定点算：坐标取 1/256 纹素，权重 0..255，每次插值后舍入回整数
+static inline __m128 SampleBilinear(const SoftRenderer::Texture& t, int level, float u, float v) {
+    int w, h;
+    const unsigned char* base = LevelPixels(t, level, w, h);
+    int ix = (int)floorf(u * w * 256.0f) - 128, iy = (int)floorf(v * h * 256.0f) - 128;
+    int x0 = ix >> 8, y0 = iy >> 8;
+    int fx = ix & 255, fy = iy & 255;
+    int x1 = std::min(std::max(x0 + 1, 0), w - 1), y1 = std::min(std::max(y0 + 1, 0), h - 1);
+    x0 = std::min(std::max(x0, 0), w - 1);
+    y0 = std::min(std::max(y0, 0), h - 1);
+    __m128i top = Lerp8x4(LoadTexel16(base + ((size_t)y0 * w + x0) * 4), LoadTexel16(base + ((size_t)y0 * w + x1) * 4), fx);
+    __m128i bot = Lerp8x4(LoadTexel16(base + ((size_t)y1 * w + x0) * 4), LoadTexel16(base + ((size_t)y1 * w + x1) * 4), fx);
+    top = _mm_packs_epi32(top, top);
+    bot = _mm_packs_epi32(bot, bot);
+    return _mm_cvtepi32_ps(Lerp8x4(top, bot, fy));
+}
+
+// a * b / 255 四舍五入，a、b 是 0..255 的 16 位通道
+static inline __m128i MulUnorm8(__m128i a, __m128i b) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// glBlendFuncSeparate(SRC_ALPHA, ONE_MINUS_SRC_ALPHA, ONE, ONE_MINUS_SRC_ALPHA)
+// src 是 0..1 的 RGBA（纹理 * 顶点色），dst 是画布上的 8 位像素。
+// 和 GL 写 RGBA8 目标时一样：src 先舍入成 8 位，再按 8 位定点乘加，每步舍入、饱和
+static inline void BlendPixel(unsigned char* dst, __m128 src) {
+    __m128i s = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(src, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    s = _mm_packs_epi32(s, s);
+    s = _mm_min_epi16(_mm_max_epi16(s, _mm_setzero_si128()), _mm_set1_epi16(255));
+    int v;
+    memcpy(&v, dst, 4);
+    __m128i d = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+    __m128i sa = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i srcFactor = _mm_insert_epi16(sa, 255, 3);
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), sa);
+    __m128i out = _mm_adds_epu16(MulUnorm8(s, srcFactor), MulUnorm8(d, inv));
+    out = _mm_packus_epi16(out, out);
+    v = _mm_cvtsi128_si32(out);
+    memcpy(dst, &v, 4);
+}
+#else
+static inline int Lerp8(int d, int f) { return (d * f + 128) >> 8; }
+
+static inline void SampleBilinear(const SoftRenderer::Texture& t, int level, float u, float v, float out[4]) {
+    int w, h;
+    const unsigned char* base = LevelPixels(t, level, w, h);
+    int ix = (int)floorf(u * w * 256.0f) - 128, iy = (int)floorf(v * h * 256.0f) - 128;
+    int x0 = ix >> 8, y0 = iy >> 8;
+    int fx = ix & 255, fy = iy & 255;
+    int x1 = std::min(std::max(x0 + 1, 0), w - 1), y1 = std::min(std::max(y0 + 1, 0), h - 1);
+    x0 = std::min(std::max(x0, 0), w - 1);
+    y0 = std::min(std::max(y0, 0), h - 1);
+    const unsigned char* c00 = base + ((size_t)y0 * w + x0) * 4;
+    const unsigned char* c10 = base + ((size_t)y0 * w + x1) * 4;
+    const unsigned char* c01 = base + ((size_t)y1 * w + x0) * 4;
+    const unsigned char* c11 = base + ((size_t)y1 * w + x1) * 4;
+    for (int k = 0; k < 4; k++) {
+        int top = c00[k] + Lerp8(c10[k] - c00[k], fx);
+        int bot = c01[k] + Lerp8(c11[k] - c01[k], fx);
+        out[k] = (float)(top + Lerp8(bot - top, fy));
+    }
+}
+
+static inline int MulUnorm8(int a, int b) {
+    int t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline void BlendPixel(unsigned char* dst, const float src[4]) {
+    int s[4];
+    for (int k = 0; k < 4; k++) s[k] = (int)std::min(std::max(src[k] * 255.0f + 0.5f, 0.0f), 255.0f);
+    int inv = 255 - s[3];
+    for (int k = 0; k < 4; k++) dst[k] = (unsigned char)std::min(255, MulUnorm8(s[k], k < 3 ? s[3] : 255) + MulUnorm8(dst[k], inv));
+}
+#endif
+
+void SoftRenderer::DrawQuad(const ImDrawVert* q, GLuint texId) {
+    // 印章是（可能翻转的）矩形：用 q0 出发的两条边 e1、e3 反算参数坐标 (a, b)
+    ImVec2 e1 = {q[1].pos.x - q[0].pos.x, q[1].pos.y - q[0].pos.y};
+    ImVec2 e3 = {q[3].pos.x - q[0].pos.x, q[3].pos.y - q[0].pos.y};
+    float l1 = e1.x * e1.x + e1.y * e1.y;
+    float l3 = e3.x * e3.x + e3.y * e3.y;
+    if (l1 < MIN_STAMP_PX * MIN_STAMP_PX || l3 < MIN_STAMP_PX * MIN_STAMP_PX) return;
+
+    float minX = q[0].pos.x, maxX = q[0].pos.x, minY = q[0].pos.y, maxY = q[0].pos.y;
+    for (int n = 1; n < 4; n++) {
+        minX = std::min(minX, q[n].pos.x); maxX = std::max(maxX, q[n].pos.x);
+        minY = std::min(minY, q[n].pos.y); maxY = std::max(maxY, q[n].pos.y);
+    }
+    int qx0 = std::max(0, (int)floorf(minX)), qx1 = std::min(canvasW - 1, (int)ceilf(maxX));
+    int qy0 = std::max(0, (int)floorf(minY)), qy1 = std::min(canvasH - 1, (int)ceilf(maxY));
+    if (qx0 > qx1 || qy0 > qy1) return;
+
+    const Texture* tex = (texId >= 1 && texId <= textures.size()) ? &textures[texId - 1] : nullptr;
+    ImVec2 du = {q[1].uv.x - q[0].uv.x, q[1].uv.y - q[0].uv.y};
+    ImVec2 dv = {q[3].uv.x - q[0].uv.x, q[3].uv.y - q[0].uv.y};
+    // 印章是相似变换，整个四边形的 LOD 一样：log2(每像素跨过的纹素数)，和 GL 一样取两条边里大的那个，
+    // 按 GL_LINEAR_MIPMAP_NEAREST 取最近的一级
+    int level = 0;
+    if (tex && mipmaps && !tex->mips.empty()) {
+        float r1 = sqrtf(((du.x * tex->w) * (du.x * tex->w) + (du.y * tex->h) * (du.y * tex->h)) / l1);
+        float r3 = sqrtf(((dv.x * tex->w) * (dv.x * tex->w) + (dv.y * tex->h) * (dv.y * tex->h)) / l3);
+        float lod = log2f(std::max(r1, r3));
+        if (lod > 0.5f) level = std::min((int)(lod + 0.5f), (int)tex->mips.size());
+    }
+    float ax = e1.x / l1, ay = e1.y / l1;
+    float bx = e3.x / l3, by = e3.y / l3;
+    float cr = ((q[0].col >> IM_COL32_R_SHIFT) & 0xFF) / 255.0f;
+    float cg = ((q[0].col >> IM_COL32_G_SHIFT) & 0xFF) / 255.0f;
+    float cb = ((q[0].col >> IM_COL32_B_SHIFT) & 0xFF) / 255.0f;
+    float ca = ((q[0].col >> IM_COL32_A_SHIFT) & 0xFF) / 255.0f;
+
+#ifdef SOFT_USE_SSE
+    // 纹理是 0..255，顶点色再除以 255 一起乘进去
+    __m128 color = _mm_setr_ps(cr / 255.0f, cg / 255.0f, cb / 255.0f, ca / 255.0f);
+    __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+    __m128 vax = _mm_set1_ps(ax), vbx = _mm_set1_ps(bx);
+#endif
+
+    // 按瓦片逐块光栅化，每块里 row 指向这一行 x = ox 处的像素
+    const int TILE = TileCanvas::TILE;
+    for (int ty = qy0 / TILE; ty <= qy1 / TILE; ty++) {
+        for (int tx = qx0 / TILE; tx <= qx1 / TILE; tx++) {
+            int ox = tx * TILE, oy = ty * TILE;
+            int x0 = std::max(qx0, ox), x1 = std::min(qx1, ox + TILE - 1);
+            int y0 = std::max(qy0, oy), y1 = std::min(qy1, oy + TILE - 1);
+            unsigned char* tile = TileCanvas::Pixels(tx, ty);
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f - q[0].pos.y;
+                unsigned char* row = tile + (size_t)(y - oy) * TILE * 4;
+                // a(x) = (x - q0.x) * ax + py * ay，对 x 是线性的
+                float aRow = py * ay, bRow = py * by;
+#ifdef SOFT_USE_SSE
+                for (int x = x0; x <= x1; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f - q[0].pos.x), lane);
+                    __m128 a = _mm_add_ps(_mm_mul_ps(px, vax), _mm_set1_ps(aRow));
+                    __m128 b = _mm_add_ps(_mm_mul_ps(px, vbx), _mm_set1_ps(bRow));
+                    __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(a, zero), _mm_cmplt_ps(a, one)),
+                                           _mm_and_ps(_mm_cmpge_ps(b, zero), _mm_cmplt_ps(b, one)));
+                    int mask = _mm_movemask_ps(in);
+                    if (!mask) continue;
+                    alignas(16) float as[4], bs[4];
+                    _mm_store_ps(as, a);
+                    _mm_store_ps(bs, b);
+                    for (int k = 0; k < 4 && x + k <= x1; k++) {
+                        if (!(mask & (1 << k))) continue;
+                        float u = q[0].uv.x + du.x * as[k] + dv.x * bs[k];
+                        float v = q[0].uv.y + du.y * as[k] + dv.y * bs[k];
+                        // 没有纹理时和 GL 一样采到 (0,0,0,1)
+                        __m128 texel = tex ? SampleBilinear(*tex, level, u, v) : _mm_setr_ps(0, 0, 0, 255.0f);
+                        BlendPixel(row + (x + k - ox) * 4, _mm_mul_ps(texel, color));
+                    }
+                }
+#else
+                for (int x = x0; x <= x1; x++) {
+                    float px = x + 0.5f - q[0].pos.x;
+                    float a = px * ax + aRow, b = px * bx + bRow;
+                    if (a < 0 || a >= 1 || b < 0 || b >= 1) continue;
+                    float u = q[0].uv.x + du.x * a + dv.x * b;
+                    float v = q[0].uv.y + du.y * a + dv.y * b;
+                    float texel[4] = {0, 0, 0, 255.0f};
+                    if (tex) SampleBilinear(*tex, level, u, v, texel);
+                    float src[4] = {texel[0] / 255.0f * cr, texel[1] / 255.0f * cg, texel[2] / 255.0f * cb, texel[3] / 255.0f * ca};
+                    BlendPixel(row + (x - ox) * 4, src);
+                }
+#endif
+            }
+        }
+    }
+}
+
+void SoftRenderer::Bake(const StrokeStore& strokes, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        if (strokes.Count(i) < 2) continue;
+        EnsureStampVertices(strokes, i);
+        GLuint tex = BrushRegistry::Get(strokes.brush[i]).texture;
+        const std::vector<ImDrawVert>& vtx = strokes.Cache(i).vtx;
+        for (size_t v = 0; v + 4 <= vtx.size(); v += 4) DrawQuad(&vtx[v], tex);
+    }
+}
+
+// 整张画布拼出来（只适合小画布，做比对用）
+static std::vector<unsigned char> Gather() {
+    std::vector<unsigned char> px((size_t)canvasW * canvasH * 4);
+    TileCanvas::Read(0, 0, canvasW, canvasH, px.data());
+    return px;
+}
+
+bool SoftRenderer::SavePNG(const char* path) {
+    std::vector<unsigned char> px = Gather();
+    return stbi_write_png(path, canvasW, canvasH, 4, px.data(), canvasW * 4) != 0;
+}
+
+int SoftRenderer::Compare(const unsigned char* other, bool bottomUp, int tolerance) {
+    std::vector<unsigned char> px = Gather();
+    int bad = 0;
+    for (int y = 0; y < canvasH; y++) {
+        const unsigned char* a = &px[(size_t)y * canvasW * 4];
+        const unsigned char* b = other + (size_t)(bottomUp ? canvasH - 1 - y : y) * canvasW * 4;
+        for (int i = 0; i < canvasW * 4; i += 4) {
+            for (int k = 0; k < 4; k++) {
+                if (abs(a[i + k] - b[i + k]) > tolerance) { bad++; break; }
+            }
+        }
+    }
+    return bad;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include "Common.h"
+#include "StrokeStore.h"
+#include "AssetCache.h"
+
+// 软件烘焙后端：没有 GL 上下文时（无显卡的构建/渲染机），把印章缓存展开成的
+// 四边形（EnsureStampVertices，和 ImDrawList 路径同一份顶点）直接合成到 TileCanvas 的 RGBA8 瓦片里。
+// 瓦片行序自上而下（第 0 行 = 画布顶部），GL 的 FBO 是自下而上，比较前要翻转。
+//
+// 与 GL 路径的误差：采样和混合都照 llvmpipe 写 RGBA8 的做法按 8 位定点算（坐标 1/256 纹素、
+// 插值和乘法每步舍入），叠得再深舍入也和 GL 一致，每通道差不超过 TOLERANCE (2/255)。
+// 例外是像素中心恰好落在四边形边上、或者 LOD 恰好在两级中间的像素：光栅化规则和 mip 选择的细微差别
+// 会多画/少画一个印章，这些像素可以差得多，但最多占 MAX_OUTLIERS（BackendBench 上约 0.01%）。
+class SoftRenderer {
+public:
+    using Texture = DecodedImage;
+
+    static const int TOLERANCE = 2;
+    static constexpr double MAX_OUTLIERS = 0.001; // 超出 TOLERANCE 的像素最多占这么多
+
+    static std::vector<Texture> textures;
+    static bool mipmaps; // 和 GL 的 GL_LINEAR_MIPMAP_NEAREST 一样按印章大小取一级 mip
+
+    static void Init();
+    static GLuint CreateTexture(int w, int h, const unsigned char* rgba); // 返回的 id 从 1 开始，0 表示无纹理
+    static GLuint CreateTexture(const DecodedImage& img, int levels);     // 带前 levels 级 mip
+    static void DrawQuad(const ImDrawVert* q, GLuint tex); // q 是一个印章的 4 个顶点
+    static void Bake(const StrokeStore& strokes, size_t first, size_t last);
+    static bool SavePNG(const char* path);
+    static int Compare(const unsigned char* other, bool bottomUp, int tolerance = TOLERANCE); // other 是整张画布，返回超出容差的像素数
+};
@@ -0,0 +1,117 @@
+#include "StrokeIndex.h"
+#include "CanvasLogic.h"
+#include "StrokeStore.h"
+#include <algorithm>
+
+std::vector<std::unique_ptr<StrokeIndex::Page>> StrokeIndex::pages;
+int StrokeIndex::pagesX = 0, StrokeIndex::pagesY = 0;
+float StrokeIndex::maxThickness = 0.0f;
+
+static int GridW() { return (canvasW + StrokeIndex::CELL - 1) / StrokeIndex::CELL; }
+static int GridH() { return (canvasH + StrokeIndex::CELL - 1) / StrokeIndex::CELL; }
+
+std::vector<StrokeIndex::Entry>* StrokeIndex::Cell(int cx, int cy, bool create) {
+    std::unique_ptr<Page>& p = pages[(cy / PAGE) * pagesX + cx / PAGE];
+    if (!p) {
+        if (!create) return nullptr;
+        p = std::make_unique<Page>();
+    }
+    return &p->cells[(cy % PAGE) * PAGE + cx % PAGE];
+}
+
+void StrokeIndex::CellRange(ImVec2 a, ImVec2 b, float pad, int& cx0, int& cy0, int& cx1, int& cy1) {
+    // 画布外的点夹到边缘格子里
+    cx0 = std::clamp((int)floorf((std::min(a.x, b.x) - pad) / CELL), 0, GridW() - 1);
+    cy0 = std::clamp((int)floorf((std::min(a.y, b.y) - pad) / CELL), 0, GridH() - 1);
+    cx1 = std::clamp((int)floorf((std::max(a.x, b.x) + pad) / CELL), 0, GridW() - 1);
+    cy1 = std::clamp((int)floorf((std::max(a.y, b.y) + pad) / CELL), 0, GridH() - 1);
+}
+
+// 画布尺寸变了（新建 / 打开文档）之后先 Clear，页表按新尺寸重建
+void StrokeIndex::Clear() {
+    pagesX = (GridW() + PAGE - 1) / PAGE;
+    pagesY = (GridH() + PAGE - 1) / PAGE;
+    pages.clear();
+    pages.resize((size_t)pagesX * pagesY);
+    maxThickness = 0.0f;
+}
+
+void StrokeIndex::AddEntry(const Entry& e) {
+    if (pages.empty()) Clear();
+    int cx0, cy0, cx1, cy1;
+    CellRange(e.a, e.b, 0.0f, cx0, cy0, cx1, cy1);
+    for (int cy = cy0; cy <= cy1; cy++)
+        for (int cx = cx0; cx <= cx1; cx++)
+            Cell(cx, cy, true)->push_back(e);
+    maxThickness = std::max(maxThickness, e.thickness);
+}
+
+void StrokeIndex::AddSegment(const StrokeView& s, int seg) {
+    ImVec2 a = s.points[seg];
+    ImVec2 b = (seg + 1 < s.count) ? s.points[seg + 1] : a;
+    AddEntry({s.id, seg, a, b, s.thickness});
+}
+
+void StrokeIndex::Insert(const StrokeView& s) {
+    if (s.count == 0) return;
+    if (s.count == 1) {
+        AddSegment(s, 0);
+        return;
+    }
+    if (!s.Flat()) {
+        std::vector<ImVec2> flat;
+        FlattenStroke(s, flat);
+        for (int i = 0; i + 1 < (int)flat.size(); i++) AddEntry({s.id, i, flat[i], flat[i + 1], s.thickness});
+        return;
+    }
+    for (int i = 0; i + 1 < s.count; i++) AddSegment(s, i);
+}
+
+void StrokeIndex::Remove(const StrokeView& s) {
+    if (s.count == 0 || pages.empty()) return;
+    std::vector<ImVec2> flat;
+    if (!s.Flat()) FlattenStroke(s, flat);
+    const ImVec2* pts = s.Flat() ? s.points : flat.data();
+    int npts = s.Flat() ? s.count : (int)flat.size();
+    int n = std::max(1, npts - 1);
+    int last[4] = {-1, -1, -1, -1};
+    for (int i = 0; i < n; i++) {
+        ImVec2 a = pts[i];
+        ImVec2 b = (i + 1 < npts) ? pts[i + 1] : a;
+        int cx0, cy0, cx1, cy1;
+        CellRange(a, b, 0.0f, cx0, cy0, cx1, cy1);
+        // 相邻的短线段大多落在同一批格子里，刚扫过的就不用再扫
+        if (cx0 == last[0] && cy0 == last[1] && cx1 == last[2] && cy1 == last[3]) continue;
+        last[0] = cx0; last[1] = cy0; last[2] = cx1; last[3] = cy1;
+        for (int cy = cy0; cy <= cy1; cy++) {
+            for (int cx = cx0; cx <= cx1; cx++) {
+                std::vector<Entry>* c = Cell(cx, cy, false);
+                if (c) c->erase(std::remove_if(c->begin(), c->end(), [&](const Entry& e) { return e.id == s.id; }), c->end());
+            }
+        }
+    }
+}
+
+void StrokeIndex::Rebuild(const StrokeStore& strokes) {
+    Clear();
+    for (size_t i = 0; i < strokes.size(); i++) Insert(strokes.View(i));
+}
+
+void StrokeIndex::Query(ImVec2 c, float r, std::vector<Entry>& out) {
+    out.clear();
+    if (pages.empty()) return;
+    int cx0, cy0, cx1, cy1;
+    CellRange(c, c, r + maxThickness, cx0, cy0, cx1, cy1);
+    for (int cy = cy0; cy <= cy1; cy++)
+        for (int cx = cx0; cx <= cx1; cx++) {
+            const std::vector<Entry>* cell = Cell(cx, cy, false);
+            if (!cell) continue;
+            for (const auto& e : *cell) {
+                float d = r + e.thickness;
+                if (CanvasLogic::SegmentDistanceSq(c, e.a, e.b) <= d * d) out.push_back(e);
+            }
+        }
+    // 跨多个格子的线段会重复出现
+    std::sort(out.begin(), out.end(), [](const Entry& a, const Entry& b) { return a.id != b.id ? a.id < b.id : a.seg < b.seg; });
+    out.erase(std::unique(out.begin(), out.end(), [](const Entry& a, const Entry& b) { return a.id == b.id && a.seg == b.seg; }), out.end());
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Common.h"
+#include <memory>
+
+// 橡皮擦用的均匀网格索引：每个格子记录落在里面的 (笔画 id, 线段号) 以及线段端点和粗细，
+// 这样命中测试不用回头去翻 strokes。
+// 格子按 PAGE x PAGE 一页，页第一次有线段时才分配，大画布上只画了一角时不占多少内存。
+// 线段 i 连接 points[i] 和 points[i+1]；只有一个点的笔画记为退化线段 0。
+// 修改笔画的点之前先 Remove，改完再 Insert / AddSegment，保证索引和 StrokeStore 一致。
+// 样条笔画和矩形、椭圆按 FlattenStroke 展开后的折线登记，线段号是展开后的线段号；
+// 完整图形的折线只用来粗筛，橡皮擦最后按 ShapeDistance 精确判断；切过的椭圆只剩一段弧，直接按折线判断。
+class StrokeIndex {
+public:
+    struct Entry {
+        int id;
+        int seg;
+        ImVec2 a, b;
+        float thickness;
+    };
+
+    static const int CELL = 32;
+    static const int PAGE = 32; // 每页 PAGE x PAGE 个格子
+
+    static void Clear();
+    static void Insert(const StrokeView& s);
+    static void AddSegment(const StrokeView& s, int seg);
+    static void Remove(const StrokeView& s);
+    static void Rebuild(const StrokeStore& strokes);
+    // 取出到 c 的距离 <= r + 笔画粗细 的线段，按 (id, seg) 排序且不重复
+    static void Query(ImVec2 c, float r, std::vector<Entry>& out);
+
+private:
+    static void AddEntry(const Entry& e);
+    static void CellRange(ImVec2 a, ImVec2 b, float pad, int& cx0, int& cy0, int& cx1, int& cy1);
+    static std::vector<Entry>* Cell(int cx, int cy, bool create); // 页没分配且不 create 时返回 nullptr
+    struct Page {
+        std::vector<Entry> cells[PAGE * PAGE];
+    };
+    static std::vector<std::unique_ptr<Page>> pages;
+    static int pagesX, pagesY;
+    static float maxThickness;
+};
@@ -0,0 +1,285 @@
+#include "StrokeStore.h"
+#include <algorithm>
+#include <cfloat>
+
+template <class Self, class F>
+void StrokeStore::ForEachColumn(Self& s, F&& f) {
+    f(s.offset); f(s.length); f(s.color); f(s.thickness); f(s.brush); f(s.id); f(s.spline); f(s.shape);
+    f(s.seed); f(s.stampBase); f(s.phase); f(s.range); f(s.boundsMin); f(s.boundsMax); f(s.cache);
+}
+
+StrokeView StrokeStore::View(size_t i) const {
+    return {Points(i), Count(i), color[i], thickness[i], brush[i], id[i], spline[i] != 0, seed[i], stampBase[i], phase[i], shape[i], range[i]};
+}
+
+Stroke StrokeStore::Get(size_t i) const {
+    Stroke s(std::vector<ImVec2>(Points(i), Points(i) + Count(i)), color[i], thickness[i], brush[i]);
+    s.id = id[i];
+    s.spline = spline[i] != 0;
+    s.shape = shape[i];
+    s.seed = seed[i];
+    s.stampBase = stampBase[i];
+    s.phase = phase[i];
+    s.range = range[i];
+    return s;
+}
+
+StrokeStore::~StrokeStore() {
+    FinishSnapshot();
+}
+
+std::shared_ptr<StrokeSnapshot> StrokeStore::Snapshot() {
+    FinishSnapshot();
+    auto snap = std::make_shared<StrokeSnapshot>();
+    StrokeStore& s = snap->strokes;
+    s.offset = offset; s.length = length; s.color = color; s.thickness = thickness; s.brush = brush; s.id = id;
+    s.spline = spline; s.shape = shape; s.seed = seed; s.stampBase = stampBase; s.phase = phase; s.range = range;
+    s.cache.resize(size());
+    s.boundsMin.assign(size(), {FLT_MAX, FLT_MAX});
+    s.boundsMax.assign(size(), {-FLT_MAX, -FLT_MAX});
+    s.arena.reserve(arena.size() - garbage);
+    if (!snap->Done()) snapshot = StrokeSnapshotPtr(snap);
+    return snap;
+}
+
+// 按笔画顺序拷，顺带把垃圾丢掉
+void StrokeStore::CopySnapshot(size_t points) {
+    if (!snapshot) return;
+    StrokeSnapshot& snap = *snapshot;
+    StrokeStore& s = snap.strokes;
+    for (size_t copied = 0; !snap.Done() && copied < points; snap.next++) {
+        uint32_t off = s.offset[snap.next], n = s.length[snap.next];
+        s.offset[snap.next] = (uint32_t)s.arena.size();
+        s.arena.insert(s.arena.end(), arena.begin() + off, arena.begin() + off + n);
+        copied += n;
+    }
+    if (snap.Done()) snapshot.reset();
+}
+
+StrokeCache& StrokeStore::Cache(size_t i) const {
+    if (!cache[i]) cache[i].reset(new StrokeCache());
+    return *cache[i];
+}
+
+void StrokeStore::PushColumns(uint32_t off, uint32_t len, ImU32 c, float t, int b, int strokeId) {
+    offset.push_back(off);
+    length.push_back(len);
+    color.push_back(c);
+    thickness.push_back(t);
+    brush.push_back(b);
+    id.push_back(strokeId);
+    spline.push_back(0);
+    shape.push_back(StrokeShape::Path);
+    seed.push_back((uint32_t)strokeId);
+    stampBase.push_back(0);
+    phase.push_back(0.0f);
+    range.emplace_back();
+    boundsMin.push_back({FLT_MAX, FLT_MAX});
+    boundsMax.push_back({-FLT_MAX, -FLT_MAX});
+    cache.emplace_back();
+}
+
+size_t StrokeStore::Add(const Stroke& s) {
+    PushColumns((uint32_t)arena.size(), (uint32_t)s.points.size(), s.color, s.thickness, s.brush, s.id);
+    Grow(s.points.size());
+    arena.insert(arena.end(), s.points.begin(), s.points.end());
+    spline.back() = s.spline;
+    shape.back() = s.shape;
+    seed.back() = s.seed;
+    stampBase.back() = s.stampBase;
+    phase.back() = s.phase;
+    range.back() = s.range;
+    return size() - 1;
+}
+
+size_t StrokeStore::Add(const ImVec2* pts, int n, ImU32 c, float t, int b, int strokeId) {
+    PushColumns((uint32_t)arena.size(), (uint32_t)n, c, t, b, strokeId < 0 ? count++ : strokeId);
+    Grow(n);
+    arena.insert(arena.end(), pts, pts + n);
+    return size() - 1;
+}
+
+void StrokeStore::Damage(ImVec2 bmin, ImVec2 bmax) const {
+    damageMin.x = fminf(damageMin.x, bmin.x); damageMin.y = fminf(damageMin.y, bmin.y);
+    damageMax.x = fmaxf(damageMax.x, bmax.x); damageMax.y = fmaxf(damageMax.y, bmax.y);
+}
+
+bool StrokeStore::TakeDamage(ImVec2& bmin, ImVec2& bmax) {
+    bmin = damageMin;
+    bmax = damageMax;
+    damageMin = {FLT_MAX, FLT_MAX};
+    damageMax = {-FLT_MAX, -FLT_MAX};
+    return bmin.x <= bmax.x && bmin.y <= bmax.y;
+}
+
+// arena 按 1.5 倍而不是 vector 默认的 2 倍扩容：点是这里最大的一块，翻倍时平均要空着四分之一
+void StrokeStore::Grow(size_t n) {
+    if (arena.size() + n > arena.capacity()) arena.reserve(std::max(arena.size() + n, arena.capacity() + arena.capacity() / 2));
+}
+
+void StrokeStore::AppendPoint(size_t i, ImVec2 p) {
+    if (offset[i] + length[i] != arena.size()) {
+        // 后面还有别的笔画的点：整笔挪到末尾，旧位置算垃圾
+        uint32_t off = offset[i], n = length[i];
+        Grow(n + 1);
+        for (uint32_t k = 0; k < n; k++) arena.push_back(arena[off + k]);
+        offset[i] = (uint32_t)arena.size() - n;
+        garbage += n;
+    } else {
+        Grow(1);
+    }
+    arena.push_back(p);
+    length[i]++;
+    MaybeCompact();
+}
+
+void StrokeStore::SetPoints(size_t i, const ImVec2* pts, int n) {
+    FinishSnapshot();
+    if ((uint32_t)n <= length[i]) {
+        garbage += length[i] - n;
+    } else if (offset[i] + length[i] == arena.size()) {
+        Grow(n - length[i]);
+        arena.resize(offset[i] + n);
+    } else {
+        garbage += length[i];
+        offset[i] = (uint32_t)arena.size();
+        Grow(n);
+        arena.resize(arena.size() + n);
+    }
+    std::copy(pts, pts + n, arena.begin() + offset[i]);
+    length[i] = (uint32_t)n;
+    MarkDirty(i);
+    MaybeCompact();
+}
+
+void StrokeStore::Trim(size_t i, int first, int n) {
+    FinishSnapshot();
+    garbage += length[i] - n;
+    offset[i] += first;
+    length[i] = (uint32_t)n;
+    MarkDirty(i);
+}
+
+// 每一列按 order 重排，临时数组按类型复用，重排本身不分配内存
+template <class T>
+static void ReorderColumn(std::vector<T>& col, const std::vector<uint32_t>& order) {
+    static std::vector<T> tmp;
+    tmp.clear();
+    tmp.reserve(order.size());
+    for (uint32_t i : order) tmp.push_back(std::move(col[i]));
+    col.swap(tmp);
+    tmp.clear();
+}
+
+void StrokeStore::Reorder(const std::vector<uint32_t>& order) {
+    size_t before = 0, after = 0;
+    for (uint32_t n : length) before += n;
+    for (uint32_t i : order) after += length[i];
+    garbage += before - after;
+    ForEachColumn(*this, [&](auto& col) { ReorderColumn(col, order); });
+    MaybeCompact();
+}
+
+// 只删不挪：留下的笔画是几段连续的下标，每列按段原地往前搬（平凡类型就是 memmove），不用临时数组
+void StrokeStore::KeepRuns(const std::vector<Run>& runs, size_t n) {
+    ForEachColumn(*this, [&](auto& col) {
+        for (const Run& r : runs) std::move(col.begin() + r.src, col.begin() + r.src + r.len, col.begin() + r.dst);
+        col.resize(n);
+    });
+    MaybeCompact();
+}
+
+void StrokeStore::Remove(const std::vector<uint32_t>& sorted) {
+    if (sorted.empty()) return;
+    static std::vector<Run> runs;
+    runs.clear();
+    // 第 k 个删掉的笔画之后到下一个删掉的之前是一段，往前挪 k + 1 格
+    for (size_t k = 0; k < sorted.size(); k++) {
+        uint32_t i = sorted[k], next = k + 1 < sorted.size() ? sorted[k + 1] : (uint32_t)size();
+        Damage(boundsMin[i], boundsMax[i]);
+        garbage += length[i];
+        if (next > i + 1) runs.push_back({i + 1, i - (uint32_t)k, next - i - 1});
+    }
+    KeepRuns(runs, size() - sorted.size());
+}
+
+void StrokeStore::Erase(size_t first, size_t last) {
+    if (first >= last) return;
+    for (size_t i = first; i < last; i++) {
+        Damage(boundsMin[i], boundsMax[i]);
+        garbage += length[i];
+    }
+    std::vector<Run> runs;
+    if (last < size()) runs.push_back({(uint32_t)last, (uint32_t)first, (uint32_t)(size() - last)});
+    KeepRuns(runs, size() - (last - first));
+}
+
+// 先都接到末尾，再一遍重排到各自的位置
+void StrokeStore::Insert(const std::vector<std::pair<int, Stroke>>& items) {
+    if (items.empty()) return;
+    uint32_t n = (uint32_t)size();
+    for (const auto& it : items) Add(it.second);
+    static std::vector<uint32_t> order;
+    order.clear();
+    uint32_t src = 0, k = 0;
+    for (uint32_t j = 0; j < (uint32_t)size(); j++) {
+        if (k < items.size() && items[k].first == (int)j) order.push_back(n + k++);
+        else order.push_back(src++);
+    }
+    Reorder(order);
+}
+
+void StrokeStore::MoveTail(size_t first, size_t to) {
+    if (to >= first || first >= size()) return;
+    // 前后顺序变了，重叠处的颜色也会变
+    for (size_t i = to; i < size(); i++) Damage(boundsMin[i], boundsMax[i]);
+    static std::vector<uint32_t> order;
+    order.clear();
+    for (uint32_t i = 0; i < (uint32_t)to; i++) order.push_back(i);
+    for (uint32_t i = (uint32_t)first; i < (uint32_t)size(); i++) order.push_back(i);
+    for (uint32_t i = (uint32_t)to; i < (uint32_t)first; i++) order.push_back(i);
+    Reorder(order);
+}
+
+void StrokeStore::Clear() {
+    FinishSnapshot();
+    for (size_t i = 0; i < size(); i++) Damage(boundsMin[i], boundsMax[i]);
+    ForEachColumn(*this, [](auto& col) { col.clear(); });
+    arena.clear();
+    garbage = 0;
+}
+
+void StrokeStore::Reserve(size_t strokes, size_t points) {
+    ForEachColumn(*this, [&](auto& col) { col.reserve(strokes); });
+    arena.reserve(points);
+}
+
+// 垃圾超过 arena 一半时按笔画顺序重新排一遍点；每次压缩前至少又产生了同样多的垃圾，均摊 O(1)。
+// 压缩后的 arena 正好装下现有的点，删掉大半笔画后各列多出来的容量也一起还回去
+void StrokeStore::MaybeCompact() {
+    if (garbage < 4096 || garbage * 2 < arena.size()) return;
+    FinishSnapshot();
+    std::vector<ImVec2> packed;
+    packed.reserve(arena.size() - garbage);
+    for (size_t i = 0; i < size(); i++) {
+        uint32_t off = offset[i];
+        offset[i] = (uint32_t)packed.size();
+        packed.insert(packed.end(), arena.begin() + off, arena.begin() + off + length[i]);
+    }
+    arena.swap(packed);
+    garbage = 0;
+    if (id.capacity() > 2 * size()) ForEachColumn(*this, [](auto& col) { col.shrink_to_fit(); });
+}
+
+template <class T>
+static size_t Bytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+// 不算印章和顶点本身，只算笔画和（已经分配的）缓存头
+size_t StrokeStore::MemoryBytes() const {
+    size_t bytes = Bytes(arena);
+    ForEachColumn(*this, [&](const auto& col) { bytes += Bytes(col); });
+    for (const auto& c : cache) bytes += c ? sizeof(StrokeCache) : 0;
+    return bytes;
+}
\ No newline at end of file
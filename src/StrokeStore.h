@@ -0,0 +1,135 @@
+#pragma once
+#include "Common.h"
+#include <cfloat>
+#include <memory>
+
+// 一个印章：中心 (x, y) 和旋转后的半边向量 (a, b) = size * (cos, sin)（画布坐标）。
+// 四个角是中心 ± (a, b) ± (-b, a)，GPU 顶点拉取时顶点着色器按这个展开
+struct StampInstance {
+    float x, y, a, b;
+};
+
+// 每笔的渲染缓存：印章实例（画布坐标）；CPU 路径（ImDrawList 顶点 / 软件烘焙）用到时才展开成顶点，每个印章 4 个。
+// 只在末尾追加点时会自动补上新线段；其他改动点的操作由 StrokeStore 置 dirty
+struct StrokeCache {
+    std::vector<StampInstance> stamps;
+    std::vector<ImDrawVert> vtx;
+    int segments = 0;
+    int generation = -1; // 笔刷 UV 变化（切换图集）后整条重建
+    bool dirty = true;
+};
+
+// 单独分配的渲染缓存：拷贝 StrokeStore（导出时拿的快照）时跟着深拷贝，挪动时只挪指针
+class StrokeCachePtr : public std::unique_ptr<StrokeCache> {
+public:
+    StrokeCachePtr() = default;
+    StrokeCachePtr(StrokeCachePtr&&) = default;
+    StrokeCachePtr& operator=(StrokeCachePtr&&) = default;
+    StrokeCachePtr(const StrokeCachePtr& o) : std::unique_ptr<StrokeCache>(o ? new StrokeCache(*o) : nullptr) {}
+    StrokeCachePtr& operator=(const StrokeCachePtr& o) {
+        reset(o ? new StrokeCache(*o) : nullptr);
+        return *this;
+    }
+};
+
+struct StrokeSnapshot;
+// 还没拷完点的保存快照：跟着 StrokeStore 挪动，拷贝 StrokeStore 时不跟着拷
+class StrokeSnapshotPtr : public std::shared_ptr<StrokeSnapshot> {
+public:
+    StrokeSnapshotPtr() = default;
+    explicit StrokeSnapshotPtr(std::shared_ptr<StrokeSnapshot> p) : std::shared_ptr<StrokeSnapshot>(std::move(p)) {}
+    StrokeSnapshotPtr(StrokeSnapshotPtr&&) = default;
+    StrokeSnapshotPtr& operator=(StrokeSnapshotPtr&&) = default;
+    StrokeSnapshotPtr(const StrokeSnapshotPtr&) : std::shared_ptr<StrokeSnapshot>() {}
+    StrokeSnapshotPtr& operator=(const StrokeSnapshotPtr&) {
+        reset();
+        return *this;
+    }
+};
+
+// 画布上所有可编辑的笔画，按列存：所有点放在一个 arena 里，每笔只记 (offset, length)，
+// 颜色、粗细、笔刷、id、包围盒等各自是一个平行数组，按下标 i 对应第 i 笔。
+// 遍历某一列是连续内存，删笔画只挪这些小数组，不挪点；
+// 删掉或换了位置的点留在 arena 里当垃圾，垃圾超过一半时整体压缩一次（均摊 O(1)）。
+// 任何修改之后，之前 Points() / MutablePoints() 拿到的指针都可能失效。
+class StrokeStore {
+public:
+    std::vector<uint32_t> offset, length; // 点在 arena 里的位置
+    std::vector<ImU32> color;
+    std::vector<float> thickness;
+    std::vector<int> brush;
+    std::vector<int> id;
+    std::vector<uint8_t> spline;
+    std::vector<StrokeShape> shape;
+    std::vector<uint32_t> seed, stampBase;
+    std::vector<float> phase;
+    std::vector<CurveRange> range;
+    mutable std::vector<ImVec2> boundsMin, boundsMax; // 印章包围盒，重建缓存时更新
+    // 渲染缓存单独分配，第一次建缓存时才有：属性列每笔只多一个指针，删除、重排时也只挪指针
+    mutable std::vector<StrokeCachePtr> cache;
+
+    std::vector<ImVec2> arena;
+    size_t garbage = 0; // arena 里已经没有笔画引用的点数
+    // 上次 TakeDamage 以来画面变过的范围（画布坐标）：重建缓存时旧的包围盒和新长出的印章，删掉或挪动的笔画。
+    // 图层合成靠它只重画变了的瓦片
+    mutable ImVec2 damageMin = {FLT_MAX, FLT_MAX}, damageMax = {-FLT_MAX, -FLT_MAX};
+
+    StrokeStore() = default;
+    StrokeStore(const StrokeStore&) = default;
+    StrokeStore(StrokeStore&&) = default;
+    StrokeStore& operator=(const StrokeStore&) = default;
+    StrokeStore& operator=(StrokeStore&&) = default;
+    ~StrokeStore();
+
+    size_t size() const { return id.size(); }
+    bool empty() const { return id.empty(); }
+    int Count(size_t i) const { return (int)length[i]; }
+    const ImVec2* Points(size_t i) const { return arena.data() + offset[i]; }
+    ImVec2* MutablePoints(size_t i) { FinishSnapshot(); return arena.data() + offset[i]; } // 原地改点用，先拷完快照
+    StrokeView View(size_t i) const;
+    Stroke Get(size_t i) const; // 拷出一条（撤销记录、保存用）
+
+    size_t Add(const Stroke& s);                                   // 接到末尾，保留 s 的 id 和种子
+    size_t Add(const ImVec2* pts, int n, ImU32 c, float t, int b, int strokeId = -1); // strokeId < 0 时分配新 id
+    void AppendPoint(size_t i, ImVec2 p);                          // 正在画的笔画在 arena 末尾时直接追加
+    void SetPoints(size_t i, const ImVec2* pts, int n);            // 整体替换；pts 不能指向 arena
+    void Trim(size_t i, int first, int n);                         // 原地只保留第 first 个点起的 n 个
+    StrokeCache& Cache(size_t i) const; // 没有就分配一个空的（dirty）
+    void MarkDirty(size_t i) { if (cache[i]) cache[i]->dirty = true; }
+    void Damage(ImVec2 bmin, ImVec2 bmax) const;
+    bool TakeDamage(ImVec2& bmin, ImVec2& bmax); // 没有变化时返回 false
+
+    void Remove(const std::vector<uint32_t>& sorted);              // 删掉这些下标（升序）
+    void Erase(size_t first, size_t last);
+    void Insert(const std::vector<std::pair<int, Stroke>>& items); // 下标升序，相对插入之后
+    void MoveTail(size_t first, size_t to);                        // 把 [first, size) 挪到 to 处
+    void Clear();
+    void Reserve(size_t strokes, size_t points);
+    size_t MemoryBytes() const;
+
+    // 保存用的快照：属性列当场整块拷贝（不带渲染缓存），点留在 arena 里由 CopySnapshot 分几帧拷过去。
+    // 拷完之前原地改点、清空、压缩 arena 或者析构时先把剩下的一次拷完，所以快照始终是拿的那一刻的内容
+    std::shared_ptr<StrokeSnapshot> Snapshot();
+    void CopySnapshot(size_t points); // 再拷大约这么多个点
+
+private:
+    template <class Self, class F>
+    static void ForEachColumn(Self& s, F&& f); // 所有按笔画下标对应的列（不含 arena）
+    void PushColumns(uint32_t off, uint32_t len, ImU32 c, float t, int b, int strokeId);
+    struct Run {
+        uint32_t src, dst, len;
+    };
+    void Reorder(const std::vector<uint32_t>& order); // 新的第 j 笔 = 原来的第 order[j] 笔，没列出的删掉
+    void KeepRuns(const std::vector<Run>& runs, size_t n); // 把 [src, src+len) 挪到 dst，其余删掉，剩 n 笔
+    void Grow(size_t n); // arena 还要再放 n 个点
+    void MaybeCompact();
+    void FinishSnapshot() { if (snapshot) CopySnapshot(SIZE_MAX); }
+    StrokeSnapshotPtr snapshot;
+};
+
+// Done 之后 strokes 是一份完整的 StrokeStore，可以交给后台线程
+struct StrokeSnapshot {
+    StrokeStore strokes; // 还没拷的笔画 offset 指向原 arena
+    size_t next = 0;     // 前 next 笔的点拷好了
+    bool Done() const { return next == strokes.size(); }
+};
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static thread_local bool isWorker = false;
+
+struct Pool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+
+    Pool() {
+        int n = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        for (int i = 0; i < n; i++) {
+            workers.emplace_back([this] {
+                isWorker = true;
+                for (;;) {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cv.wait(lock, [this] { return stop || !jobs.empty(); });
+                        if (stop && jobs.empty()) return;
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    job();
+                }
+            });
+        }
+    }
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+};
+
+static Pool& GetPool() {
+    static Pool pool;
+    return pool;
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+    Pool& p = GetPool();
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        p.jobs.push_back(std::move(job));
+    }
+    p.cv.notify_one();
+}
+
+int ThreadPool::ThreadCount() {
+    return (int)GetPool().workers.size();
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& fn) {
+    if (count <= 0) return;
+    if (count == 1 || isWorker) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    // 晚启动的帮手可能在函数返回后才运行，所以状态放在 shared_ptr 里；
+    // 它们拿不到有效下标就直接退出，不会再碰 fn
+    struct State {
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(int)>* f = &fn;
+    auto work = [state, f, count] {
+        for (int i; (i = state->next.fetch_add(1)) < count;) {
+            (*f)(i);
+            if (state->done.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->cv.notify_all();
+            }
+        }
+    };
+
+    int helpers = std::min(ThreadCount(), count - 1);
+    for (int i = 0; i < helpers; i++) Submit(work);
+    work();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&] { return state->done.load() == count; });
+}
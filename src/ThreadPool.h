@@ -0,0 +1,11 @@
+#pragma once
+#include <functional>
+
+// 全局工作线程池（线程数 = 核数 - 1），第一次使用时启动
+class ThreadPool {
+public:
+    static void Submit(std::function<void()> job);
+    // fn(0..count-1) 分给工作线程和调用线程一起跑，全部完成后返回；在工作线程里调用时直接串行执行
+    static void ParallelFor(int count, const std::function<void(int)>& fn);
+    static int ThreadCount();
+};
@@ -0,0 +1,624 @@
+#include "TileCanvas.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+namespace fs = std::filesystem;
+
+// stb_image_write 实现了 zlib 压缩但头文件里没有声明
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+size_t TileCanvas::residentBudget = (size_t)512 << 20;
+size_t TileCanvas::packedBudget = (size_t)256 << 20;
+void (*TileCanvas::onChange)(int surface, int tx, int ty) = nullptr;
+bool (*TileCanvas::knownPixels)(int surface, int x, int y, int w, int h, unsigned char* out, size_t stride) = nullptr;
+
+static const int TILE = TileCanvas::TILE;
+static const int RESTORES_PER_FRAME = 32; // 显示时每帧最多换回这么多块，缩小看全图时不会卡一下
+static const int EVICTS_PER_FRAME = 8;    // 每帧最多换出这么多块，压缩不会卡一下
+static const int EVICT_HARD_TILES = 64;   // 超出预算这么多块以上的部分不限块数，GL 的当场同步回读
+
+struct CanvasTile {
+    GLuint texture = 0;              // GL 后端，常驻时有效
+    std::vector<unsigned char> rgba; // 软件后端，常驻时有效
+    std::vector<uint8_t> packed;     // 换出到内存时的编码
+    int64_t swapOffset = -1;         // 换出到交换文件时的位置
+    uint32_t swapBytes = 0;
+    uint64_t lastUsed = 0;
+    uint64_t version = 0;  // 最后一次改动时的 changes，异步回读回来时对一下
+    bool resident = false;
+    bool evicting = false; // 换出的回读在路上
+};
+
+// 回读回来等着压缩换出的瓦片
+struct Fetched {
+    uint64_t key, version;
+    std::vector<unsigned char> px; // 自上而下
+};
+
+static std::unordered_map<uint64_t, CanvasTile> tiles; // key = surface << 32 | (ty * TilesX + tx)
+static int selected = 0;
+static int residentCount = 0;
+static size_t packedBytes = 0, swapBytes = 0;
+static uint64_t frame = 1;
+static int restoresThisFrame = 0;
+static bool restoresDeferred = false, restoresPending = false;
+static std::fstream swapFile;
+static int64_t swapEnd = 0;
+static std::unordered_map<int, uint64_t> generations; // surface -> 最后一次改动时的 changes
+static uint64_t changes = 0, cleared = 0;             // cleared：最后一次 Init 时的 changes
+static std::vector<Fetched> fetched;
+static int evictsInFlight = 0;
+
+static uint64_t Key(int tx, int ty) {
+    return (uint64_t)(uint32_t)selected << 32 | ((uint32_t)ty * TileCanvas::TilesX() + tx);
+}
+
+static void Changed(int tx, int ty) {
+    generations[selected] = ++changes;
+    auto it = tiles.find(Key(tx, ty));
+    if (it != tiles.end()) it->second.version = changes;
+    if (TileCanvas::onChange) TileCanvas::onChange(selected, tx, ty);
+}
+
+static bool UseGL() {
+    return Renderer::backend == BakeBackend::OpenGL;
+}
+
+static void FlipRows(unsigned char* px, int w, int h) {
+    size_t row = (size_t)w * 4;
+    std::vector<unsigned char> tmp(row);
+    for (int r = 0; r < h / 2; r++) {
+        unsigned char* a = px + r * row;
+        unsigned char* b = px + (size_t)(h - 1 - r) * row;
+        memcpy(tmp.data(), a, row);
+        memcpy(a, b, row);
+        memcpy(b, tmp.data(), row);
+    }
+}
+
+// ---------------- 编码 ----------------
+static void PutRaw(std::vector<uint8_t>& out, const void* p, size_t n) {
+    out.insert(out.end(), (const uint8_t*)p, (const uint8_t*)p + n);
+}
+
+void TileCanvas::Encode(const unsigned char* px, size_t stride, int w, int h, std::vector<uint8_t>& out, int quality) {
+    const uint32_t* first = (const uint32_t*)px;
+    bool solid = true;
+    for (int r = 0; r < h && solid; r++) {
+        const uint32_t* row = (const uint32_t*)(px + r * stride);
+        for (int c = 0; c < w; c++) if (row[c] != *first) { solid = false; break; }
+    }
+    if (solid) {
+        out.push_back(TileCanvas::SOLID);
+        uint32_t n = 4;
+        PutRaw(out, &n, 4);
+        PutRaw(out, first, 4);
+        return;
+    }
+
+    std::vector<unsigned char> filtered((size_t)w * h * 4);
+    for (int r = 0; r < h; r++) {
+        const unsigned char* src = px + r * stride;
+        unsigned char* dst = &filtered[(size_t)r * w * 4];
+        for (int i = 0; i < w * 4; i++) dst[i] = (unsigned char)(src[i] - (i >= 4 ? src[i - 4] : 0));
+    }
+    int len = 0;
+    unsigned char* z = stbi_zlib_compress(filtered.data(), (int)filtered.size(), &len, quality);
+    out.push_back(TileCanvas::ZLIB);
+    uint32_t n = (uint32_t)len;
+    PutRaw(out, &n, 4);
+    PutRaw(out, z, len);
+    free(z);
+}
+
+bool TileCanvas::Decode(uint8_t type, const uint8_t* data, uint32_t size, unsigned char* px, size_t stride, int w, int h) {
+    if (type == TileCanvas::SOLID) {
+        if (size != 4) return false;
+        for (int r = 0; r < h; r++) {
+            unsigned char* row = px + r * stride;
+            for (int c = 0; c < w; c++) memcpy(row + c * 4, data, 4);
+        }
+        return true;
+    }
+    std::vector<unsigned char> filtered((size_t)w * h * 4);
+    int n = stbi_zlib_decode_buffer((char*)filtered.data(), (int)filtered.size(), (const char*)data, (int)size);
+    if (n != (int)filtered.size()) return false;
+    for (int r = 0; r < h; r++) {
+        const unsigned char* src = &filtered[(size_t)r * w * 4];
+        unsigned char* dst = px + r * stride;
+        for (int i = 0; i < w * 4; i++) dst[i] = (unsigned char)(src[i] + (i >= 4 ? dst[i - 4] : 0));
+    }
+    return true;
+}
+
+// ---------------- 常驻 / 换出 ----------------
+static void AttachTile(GLuint tex) {
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer::fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+}
+
+// 整块读成自上而下的 RGBA
+static void ReadResident(const CanvasTile& t, unsigned char* out) {
+    if (!UseGL()) {
+        memcpy(out, t.rgba.data(), TileCanvas::TILE_BYTES);
+        return;
+    }
+    AttachTile(t.texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, TILE, TILE, GL_RGBA, GL_UNSIGNED_BYTE, out);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    FlipRows(out, TILE, TILE);
+}
+
+static void MakeResident(CanvasTile& t, unsigned char* topDown) {
+    if (UseGL()) {
+        FlipRows(topDown, TILE, TILE);
+        t.texture = Renderer::CreateTexture(TILE, TILE, topDown);
+    } else {
+        t.rgba.assign(topDown, topDown + TileCanvas::TILE_BYTES);
+    }
+    t.resident = true;
+    residentCount++;
+}
+
+static void DropResident(CanvasTile& t) {
+    if (!t.resident) return;
+    if (t.texture) glDeleteTextures(1, &t.texture);
+    t.texture = 0;
+    std::vector<unsigned char>().swap(t.rgba);
+    t.resident = false;
+    residentCount--;
+}
+
+static void DropPacked(CanvasTile& t) {
+    packedBytes -= t.packed.size();
+    std::vector<uint8_t>().swap(t.packed);
+    if (t.swapOffset >= 0) {
+        swapBytes -= t.swapBytes;
+        t.swapOffset = -1;
+        t.swapBytes = 0;
+        // 交换文件里的东西都换回来了，从头开始复用
+        if (swapBytes == 0) swapEnd = 0;
+    }
+}
+
+// 1 字节类型 + 4 字节长度 + 数据解成自上而下的 TILE x TILE RGBA，坏了返回 false
+static bool DecodePacked(const std::vector<uint8_t>& src, unsigned char* px) {
+    uint32_t size = 0;
+    if (src.size() >= 5) memcpy(&size, src.data() + 1, 4);
+    return src.size() >= 5 && size == src.size() - 5 && TileCanvas::Decode(src[0], src.data() + 5, size, px, (size_t)TILE * 4, TILE, TILE);
+}
+
+static void ReadSwap(const CanvasTile& t, std::vector<uint8_t>& out) {
+    out.resize(t.swapBytes);
+    swapFile.clear();
+    swapFile.seekg(t.swapOffset);
+    swapFile.read((char*)out.data(), out.size());
+}
+
+// 换出的瓦片解码成自上而下的 RGBA，交换文件坏了返回 false
+static bool Unpack(const CanvasTile& t, unsigned char* px) {
+    if (t.swapOffset < 0) return DecodePacked(t.packed, px);
+    std::vector<uint8_t> disk;
+    ReadSwap(t, disk);
+    return DecodePacked(disk, px);
+}
+
+static void Restore(CanvasTile& t) {
+    PROFILE_SCOPE("TileCanvas::Restore");
+    std::vector<unsigned char> px(TileCanvas::TILE_BYTES, 0);
+    if (!Unpack(t, px.data())) std::fill(px.begin(), px.end(), 0); // 交换文件坏了只能当成空白
+    DropPacked(t);
+    MakeResident(t, px.data());
+}
+
+static bool SpillToSwap(CanvasTile& t) {
+    if (!swapFile.is_open()) {
+        std::string path = (fs::temp_directory_path() / "PaintApp-tiles.swap").string();
+        swapFile.open(path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!swapFile.is_open()) return false;
+    }
+    swapFile.clear();
+    swapFile.seekp(swapEnd);
+    swapFile.write((const char*)t.packed.data(), t.packed.size());
+    if (!swapFile) return false;
+    t.swapOffset = swapEnd;
+    t.swapBytes = (uint32_t)t.packed.size();
+    swapEnd += t.swapBytes;
+    swapBytes += t.swapBytes;
+    packedBytes -= t.packed.size();
+    std::vector<uint8_t>().swap(t.packed);
+    return true;
+}
+
+// 异步回读回来的瓦片：回读期间没改过、这一帧也没用到的才换出，不然作罢，下次超预算再挑
+static void TakeFetched(std::vector<CanvasTile*>& batch, std::vector<std::vector<unsigned char>>& px) {
+    for (Fetched& f : fetched) {
+        auto it = tiles.find(f.key);
+        if (it == tiles.end() || !it->second.evicting) continue;
+        CanvasTile& t = it->second;
+        if (!t.resident || t.version != f.version || t.lastUsed >= frame) {
+            t.evicting = false;
+            continue;
+        }
+        batch.push_back(&t); // evicting 留到换出为止，免得这一帧又被挑中
+        px.push_back(std::move(f.px));
+    }
+    fetched.clear();
+}
+
+// 发一块瓦片的异步回读，回来时放进 fetched，等下一次 Evict 压缩
+static bool FetchAsync(uint64_t key, CanvasTile& t) {
+    AttachTile(t.texture);
+    uint64_t version = t.version;
+    bool ok = Renderer::ReadAsync(0, 0, TILE, TILE, [key, version](const unsigned char* rgba, int, int) {
+        evictsInFlight--;
+        if (!rgba) {
+            auto it = tiles.find(key);
+            if (it != tiles.end()) it->second.evicting = false;
+            return;
+        }
+        Fetched f{key, version, std::vector<unsigned char>(TileCanvas::TILE_BYTES)};
+        for (int r = 0; r < TILE; r++)
+            memcpy(&f.px[(size_t)r * TILE * 4], rgba + (size_t)(TILE - 1 - r) * TILE * 4, (size_t)TILE * 4);
+        fetched.push_back(std::move(f));
+    });
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (ok) {
+        t.evicting = true;
+        evictsInFlight++;
+    }
+    return ok;
+}
+
+// 常驻超出 budget 时按最久没用到的顺序换出；这一帧用过的不动。
+// 撤销历史里有当前内容的直接拿来压缩；GL 后端其余的走异步回读，回来后下一次 EndFrame 才换出，回读槽满了就等下一帧。
+// 每帧最多换出 EVICTS_PER_FRAME 块，只有超出预算 EVICT_HARD_TILES 块以上的部分当场换出（GL 同步回读）。压缩分给线程池
+static void Evict(size_t budget) {
+    std::vector<CanvasTile*> batch;
+    std::vector<std::vector<unsigned char>> px;
+    if (!fetched.empty()) TakeFetched(batch, px);
+
+    size_t resident = (size_t)(residentCount - (int)batch.size() - evictsInFlight) * TileCanvas::TILE_BYTES;
+    if (resident > budget) {
+        PROFILE_SCOPE("TileCanvas::Evict");
+        std::vector<std::pair<uint64_t, CanvasTile*>> lru;
+        for (auto& kv : tiles)
+            if (kv.second.resident && !kv.second.evicting && kv.second.lastUsed < frame) lru.push_back({kv.first, &kv.second});
+        std::sort(lru.begin(), lru.end(), [](const auto& a, const auto& b) { return a.second->lastUsed < b.second->lastUsed; });
+        size_t need = (resident - budget + TileCanvas::TILE_BYTES - 1) / TileCanvas::TILE_BYTES;
+        lru.resize(std::min(lru.size(), need));
+
+        int tilesX = TileCanvas::TilesX();
+        size_t soft = 0;
+        for (size_t i = 0; i < lru.size(); i++) {
+            bool hard = need - i > EVICT_HARD_TILES;
+            if (!hard && soft++ >= EVICTS_PER_FRAME) break;
+            uint64_t key = lru[i].first;
+            CanvasTile& t = *lru[i].second;
+            int surface = (int)(uint32_t)(key >> 32), k = (int)(uint32_t)key;
+            int x = k % tilesX * TILE, y = k / tilesX * TILE;
+            std::vector<unsigned char> tile(TileCanvas::TILE_BYTES);
+            // 撤销历史只管画布内，伸出画布边的瓦片还得回读
+            bool inside = x + TILE <= canvasW && y + TILE <= canvasH;
+            bool known = inside && TileCanvas::knownPixels &&
+                         TileCanvas::knownPixels(surface, x, y, TILE, TILE, tile.data(), (size_t)TILE * 4);
+            if (!known && UseGL() && !hard) {
+                FetchAsync(key, t);
+                continue;
+            }
+            if (!known) ReadResident(t, tile.data());
+            batch.push_back(&t);
+            px.push_back(std::move(tile));
+        }
+    }
+
+    if (!batch.empty()) {
+        ThreadPool::ParallelFor((int)batch.size(), [&](int i) {
+            TileCanvas::Encode(px[i].data(), (size_t)TILE * 4, TILE, TILE, batch[i]->packed, 5);
+        });
+        for (CanvasTile* t : batch) {
+            packedBytes += t->packed.size();
+            DropResident(*t);
+            t->evicting = false;
+        }
+    }
+
+    if (packedBytes > TileCanvas::packedBudget) {
+        std::vector<CanvasTile*> lru;
+        for (auto& kv : tiles)
+            if (!kv.second.packed.empty()) lru.push_back(&kv.second);
+        std::sort(lru.begin(), lru.end(), [](const CanvasTile* a, const CanvasTile* b) { return a->lastUsed < b->lastUsed; });
+        for (CanvasTile* t : lru) {
+            if (packedBytes <= TileCanvas::packedBudget || !SpillToSwap(*t)) break;
+        }
+    }
+}
+
+static CanvasTile* Find(int tx, int ty) {
+    auto it = tiles.find(Key(tx, ty));
+    return it == tiles.end() ? nullptr : &it->second;
+}
+
+// 常驻的瓦片；没有就分配一块透明的，换出的换回来
+static CanvasTile& Acquire(int tx, int ty) {
+    CanvasTile& t = tiles[Key(tx, ty)];
+    if (!t.resident) {
+        if (t.packed.empty() && t.swapOffset < 0) {
+            std::vector<unsigned char> blank(TileCanvas::TILE_BYTES, 0);
+            MakeResident(t, blank.data());
+            t.version = changes;
+        } else {
+            Restore(t);
+        }
+    }
+    t.lastUsed = frame;
+    return t;
+}
+
+static void Drop(uint64_t key) {
+    auto it = tiles.find(key);
+    if (it == tiles.end()) return;
+    DropResident(it->second);
+    DropPacked(it->second);
+    tiles.erase(it);
+}
+
+// ---------------- 接口 ----------------
+void TileCanvas::Init(int w, int h) {
+    for (auto& kv : tiles) {
+        DropResident(kv.second);
+        DropPacked(kv.second);
+    }
+    tiles.clear();
+    fetched.clear();
+    swapEnd = 0;
+    generations.clear();
+    cleared = ++changes;
+    canvasW = w;
+    canvasH = h;
+}
+
+void TileCanvas::Select(int surface) {
+    selected = surface;
+}
+
+int TileCanvas::Selected() {
+    return selected;
+}
+
+void TileCanvas::Clear() {
+    PROFILE_SCOPE("TileCanvas::Clear");
+    ForEachPainted([](int tx, int ty) {
+        Drop(Key(tx, ty));
+        Changed(tx, ty);
+    });
+}
+
+void TileCanvas::DropSurface(int surface) {
+    for (auto it = tiles.begin(); it != tiles.end();) {
+        if ((int)(uint32_t)(it->first >> 32) != surface) { ++it; continue; }
+        DropResident(it->second);
+        DropPacked(it->second);
+        it = tiles.erase(it);
+    }
+    generations.erase(surface);
+}
+
+uint64_t TileCanvas::Generation(int surface) {
+    auto it = generations.find(surface);
+    return std::max(cleared, it == generations.end() ? 0 : it->second);
+}
+
+bool TileCanvas::Painted(int tx, int ty) {
+    return Find(tx, ty) != nullptr;
+}
+
+void TileCanvas::ForEachPainted(const std::function<void(int tx, int ty)>& fn) {
+    std::vector<uint32_t> keys;
+    for (const auto& kv : tiles)
+        if ((int)(uint32_t)(kv.first >> 32) == selected) keys.push_back((uint32_t)kv.first);
+    std::sort(keys.begin(), keys.end());
+    for (uint32_t k : keys) fn((int)(k % TilesX()), (int)(k / TilesX()));
+}
+
+GLuint TileCanvas::Texture(int tx, int ty, bool restore) {
+    CanvasTile* t = Find(tx, ty);
+    if (!t) return 0;
+    if (!t->resident) {
+        if (!restore && restoresThisFrame >= RESTORES_PER_FRAME) {
+            restoresDeferred = true;
+            return 0;
+        }
+        restoresThisFrame++;
+        Restore(*t);
+    }
+    t->lastUsed = frame;
+    return t->texture;
+}
+
+void TileCanvas::BindTarget(int tx, int ty) {
+    AttachTile(Acquire(tx, ty).texture);
+    Changed(tx, ty);
+}
+
+unsigned char* TileCanvas::Pixels(int tx, int ty) {
+    Changed(tx, ty);
+    return Acquire(tx, ty).rgba.data();
+}
+
+// 异步读一张瓦片纹理，回来时翻成自上而下交给 done
+static bool ReadTextureAsync(GLuint tex, TileCanvas::TileReadFn done) {
+    AttachTile(tex);
+    bool ok = Renderer::ReadAsync(0, 0, TILE, TILE, [done](const unsigned char* rgba, int, int) {
+        if (!rgba) return done(nullptr);
+        std::vector<unsigned char> px(TileCanvas::TILE_BYTES);
+        for (int r = 0; r < TILE; r++) memcpy(&px[(size_t)r * TILE * 4], rgba + (size_t)(TILE - 1 - r) * TILE * 4, (size_t)TILE * 4);
+        done(px.data());
+    });
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return ok;
+}
+
+bool TileCanvas::ReadAsync(int tx, int ty, TileReadFn done) {
+    CanvasTile* t = Find(tx, ty);
+    if (!t) {
+        static const std::vector<unsigned char> blank(TILE_BYTES, 0);
+        done(blank.data());
+        return true;
+    }
+    if (!t->resident) {
+        // 换出的直接解码，不用换回常驻
+        std::vector<unsigned char> px(TILE_BYTES);
+        done(Unpack(*t, px.data()) ? px.data() : nullptr);
+        return true;
+    }
+    if (!UseGL()) {
+        done(t->rgba.data());
+        return true;
+    }
+    return ReadTextureAsync(t->texture, std::move(done));
+}
+
+TileCanvas::Snapshot TileCanvas::TakeSnapshot(int tx, int ty) {
+    Snapshot s;
+    CanvasTile* t = Find(tx, ty);
+    if (!t) return s; // 空的 packed 和 rgba 是透明的
+    if (!t->resident) {
+        if (t->swapOffset < 0) s.packed = t->packed;
+        else ReadSwap(*t, s.packed);
+    } else if (!UseGL()) {
+        s.rgba = t->rgba;
+    } else {
+        s.texture = Renderer::CreateTexture(TILE, TILE, nullptr);
+        AttachTile(t->texture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, TILE, TILE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    return s;
+}
+
+bool TileCanvas::ReadSnapshot(Snapshot& s, TileReadFn done) {
+    if (!ReadTextureAsync(s.texture, std::move(done))) return false;
+    // 回读已经排在 GL 命令里了，纹理现在删掉也要等它读完才真正释放
+    glDeleteTextures(1, &s.texture);
+    s.texture = 0;
+    return true;
+}
+
+bool TileCanvas::UnpackSnapshot(const Snapshot& s, unsigned char* px) {
+    if (!s.rgba.empty()) {
+        memcpy(px, s.rgba.data(), TILE_BYTES);
+        return true;
+    }
+    if (s.packed.empty()) {
+        memset(px, 0, TILE_BYTES);
+        return true;
+    }
+    return DecodePacked(s.packed, px);
+}
+
+void TileCanvas::Read(int x, int y, int w, int h, unsigned char* out) {
+    PROFILE_SCOPE("TileCanvas::Read");
+    size_t outRow = (size_t)w * 4;
+    std::vector<unsigned char> tmp;
+    for (int ty = y / TILE; ty <= (y + h - 1) / TILE; ty++) {
+        for (int tx = x / TILE; tx <= (x + w - 1) / TILE; tx++) {
+            // 这块瓦片和请求矩形的交集，rx/ry 是瓦片内坐标
+            int ox = tx * TILE, oy = ty * TILE;
+            int rx = std::max(x, ox) - ox, ry = std::max(y, oy) - oy;
+            int rw = std::min(x + w, ox + TILE) - ox - rx, rh = std::min(y + h, oy + TILE) - oy - ry;
+            unsigned char* dst = out + (size_t)(oy + ry - y) * outRow + (size_t)(ox + rx - x) * 4;
+            if (!Painted(tx, ty)) {
+                for (int r = 0; r < rh; r++) memset(dst + r * outRow, 0, (size_t)rw * 4);
+                continue;
+            }
+            CanvasTile& t = Acquire(tx, ty);
+            if (!UseGL()) {
+                for (int r = 0; r < rh; r++)
+                    memcpy(dst + r * outRow, &t.rgba[((size_t)(ry + r) * TILE + rx) * 4], (size_t)rw * 4);
+                continue;
+            }
+            tmp.resize((size_t)rw * rh * 4);
+            AttachTile(t.texture);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(rx, TILE - ry - rh, rw, rh, GL_RGBA, GL_UNSIGNED_BYTE, tmp.data());
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            for (int r = 0; r < rh; r++) memcpy(dst + r * outRow, &tmp[(size_t)(rh - 1 - r) * rw * 4], (size_t)rw * 4);
+        }
+    }
+}
+
+void TileCanvas::Write(int x, int y, int w, int h, const unsigned char* rgba) {
+    PROFILE_SCOPE("TileCanvas::Write");
+    size_t inRow = (size_t)w * 4;
+    std::vector<unsigned char> tmp;
+    for (int ty = y / TILE; ty <= (y + h - 1) / TILE; ty++) {
+        for (int tx = x / TILE; tx <= (x + w - 1) / TILE; tx++) {
+            int ox = tx * TILE, oy = ty * TILE;
+            int rx = std::max(x, ox) - ox, ry = std::max(y, oy) - oy;
+            int rw = std::min(x + w, ox + TILE) - ox - rx, rh = std::min(y + h, oy + TILE) - oy - ry;
+            const unsigned char* src = rgba + (size_t)(oy + ry - y) * inRow + (size_t)(ox + rx - x) * 4;
+            bool blank = true;
+            for (int r = 0; r < rh && blank; r++) {
+                const unsigned char* row = src + r * inRow;
+                for (int i = 0; i < rw * 4; i++) if (row[i] != 0) { blank = false; break; }
+            }
+            if (Painted(tx, ty) || !blank) Changed(tx, ty);
+            if (blank) {
+                // 整块写成透明就把瓦片释放掉（撤销回空白时内存也退回去）；没分配的也不用分配
+                if (rw == TILE && rh == TILE) Drop(Key(tx, ty));
+                if (!Painted(tx, ty)) continue;
+            }
+            CanvasTile& t = Acquire(tx, ty);
+            if (!UseGL()) {
+                for (int r = 0; r < rh; r++)
+                    memcpy(&t.rgba[((size_t)(ry + r) * TILE + rx) * 4], src + r * inRow, (size_t)rw * 4);
+                continue;
+            }
+            tmp.resize((size_t)rw * rh * 4);
+            for (int r = 0; r < rh; r++) memcpy(&tmp[(size_t)(rh - 1 - r) * rw * 4], src + r * inRow, (size_t)rw * 4);
+            glBindTexture(GL_TEXTURE_2D, t.texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rx, TILE - ry - rh, rw, rh, GL_RGBA, GL_UNSIGNED_BYTE, tmp.data());
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
+}
+
+void TileCanvas::EndFrame() {
+    Evict(residentBudget);
+    PROFILE_COUNTER("tiles resident", residentCount);
+    PROFILE_COUNTER("tiles", tiles.size());
+    frame++;
+    restoresThisFrame = 0;
+    restoresPending = restoresDeferred;
+    restoresDeferred = false;
+}
+
+bool TileCanvas::RestoresPending() {
+    return restoresPending;
+}
+
+int TileCanvas::TileCount() {
+    return (int)tiles.size();
+}
+
+int TileCanvas::ResidentCount() {
+    return residentCount;
+}
+
+size_t TileCanvas::PackedBytes() {
+    return packedBytes;
+}
+
+size_t TileCanvas::SwapBytes() {
+    return swapBytes;
+}
\ No newline at end of file
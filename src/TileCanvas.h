@@ -0,0 +1,79 @@
+#pragma once
+#include "Common.h"
+#include <cstdint>
+#include <functional>
+
+// 底图（烘焙层）：canvasW x canvasH 切成 TILE x TILE 的瓦片，只有画到过的瓦片才分配，
+// 没分配的瓦片是透明的。内存随画过的面积增长，和画布尺寸无关。
+// 每个图层是一组独立的瓦片（surface，用图层 id 区分），下面的接口都作用在 Select 选中的那组上。
+// 瓦片里存的是预乘 alpha 的颜色：印章按 (SRC_ALPHA, 1 - SRC_ALPHA) / (1, 1 - SRC_ALPHA) 混合到透明底上正好是预乘的。
+//
+// 瓦片有三种状态：常驻（GL 后端是一张纹理，软件后端是一块 RGBA）、换出到内存（压缩数据）、
+// 换出到交换文件。所有 surface 共用预算，常驻瓦片超过 residentBudget 时，EndFrame 把最久没用到的换出去压缩
+// （GL 常驻的异步回读，过一两帧才真正换出）；
+// 压缩数据超过 packedBudget 时再把最老的写进交换文件。用到换出的瓦片时自动换回来。
+//
+// GL 纹理和 FBO 一样是自下而上的行序；Read / Write 和软件后端的 RGBA 都是画布自上而下的行序。
+class TileCanvas {
+public:
+    static const int TILE = 256;
+    static const size_t TILE_BYTES = (size_t)TILE * TILE * 4;
+    static size_t residentBudget;
+    static size_t packedBudget;
+
+    static void Init(int w, int h); // 换成 w x h 的空白画布，丢掉所有 surface 的瓦片
+    static void Select(int surface);
+    static int Selected();
+    static void Clear();                  // 选中的 surface 变回空白
+    static void DropSurface(int surface); // 删掉的图层再也撤销不回来时调用（History 丢掉删图层的记录）
+    // 某块瓦片的内容变了（烘焙、写入、清空）时回调，合成缓存用它作废；可以为空
+    static void (*onChange)(int surface, int tx, int ty);
+    // 换出时先问它：surface 上这块矩形（画布自上而下，out 每行 stride 字节）的当前内容别处已经有了（撤销历史）
+    // 就拷出来返回 true，换出直接压缩它，不用回读；可以为空
+    static bool (*knownPixels)(int surface, int x, int y, int w, int h, unsigned char* out, size_t stride);
+    static int TilesX() { return (canvasW + TILE - 1) / TILE; }
+    static int TilesY() { return (canvasH + TILE - 1) / TILE; }
+    // surface 的内容每变一次（烘焙、写入、清空、换画布）就换一个新值；拿着快照在后台干活的（油漆桶）写回前对一下
+    static uint64_t Generation(int surface);
+    static bool Painted(int tx, int ty);
+    static void ForEachPainted(const std::function<void(int tx, int ty)>& fn);
+
+    // 显示用：常驻的直接返回，换出的每帧最多换回 RESTORES_PER_FRAME 块，来不及的返回 0；
+    // restore 为 true 时（合成用）当场换回来
+    static GLuint Texture(int tx, int ty, bool restore = false);
+    static bool RestoresPending(); // 上一帧有瓦片因为限额没换回来，还要再画几帧
+    // 烘焙用：没有就分配一块透明瓦片。GL 后端把 Renderer::fbo 绑到这块瓦片上，软件后端返回它的 RGBA
+    static void BindTarget(int tx, int ty);
+    static unsigned char* Pixels(int tx, int ty);
+
+    // 异步读整块瓦片，交给 done 的是画布自上而下的 TILE x TILE RGBA（读失败时为空）：
+    // 没画过的、换出的和软件后端当场给，GL 常驻的走 Renderer::ReadAsync 过一两帧在主线程给。回读槽满了返回 false，下一帧再试
+    using TileReadFn = std::function<void(const unsigned char* rgba)>;
+    static bool ReadAsync(int tx, int ty, TileReadFn done);
+    // 保存用的快照：定格瓦片此刻的内容，之后改瓦片不影响它，拿的时候不回读也不解码。
+    // GL 常驻的在 GPU 上拷一张纹理，ReadSnapshot 过一两帧在主线程读出来（回读槽满了返回 false，下一帧再试），发出后就释放纹理；
+    // 换出的拷一份压缩数据，软件后端的拷一份 RGBA，都用 UnpackSnapshot 解，哪个线程都行
+    struct Snapshot {
+        GLuint texture = 0;
+        std::vector<uint8_t> packed;
+        std::vector<unsigned char> rgba;
+    };
+    static Snapshot TakeSnapshot(int tx, int ty);
+    static bool ReadSnapshot(Snapshot& s, TileReadFn done);
+    static bool UnpackSnapshot(const Snapshot& s, unsigned char* px); // 自上而下的 TILE x TILE RGBA
+    // 按画布坐标读写任意矩形；写进没分配的瓦片时全透明的部分不分配
+    static void Read(int x, int y, int w, int h, unsigned char* out);
+    static void Write(int x, int y, int w, int h, const unsigned char* rgba);
+
+    static void EndFrame(); // 主线程每帧最后调用：按预算换出
+    static int TileCount(); // 所有 surface 加起来
+    static int ResidentCount();
+    static size_t PackedBytes();
+    static size_t SwapBytes();
+
+    // 瓦片编码（交换和 .pdoc 共用）：纯色只存一个颜色，其余按行水平差分后 zlib。
+    // out 追加 1 字节类型 + 4 字节长度 + 数据；stride 是 px 每行的字节数
+    enum Encoding : uint8_t { SOLID = 0, ZLIB = 1 };
+    static void Encode(const unsigned char* px, size_t stride, int w, int h, std::vector<uint8_t>& out, int quality = 8);
+    static bool Decode(uint8_t type, const uint8_t* data, uint32_t size, unsigned char* px, size_t stride, int w, int h);
+};
\ No newline at end of file
@@ -4,36 +4,173 @@
 #include <imgui_impl_opengl3.h>
 #include "Renderer.h"
 #include "AppUI.h"
+#include "Layers.h"
+#include "Compositor.h"
+#include "History.h"
+#include "TileCanvas.h"
+#include "InputQueue.h"
+#include "Profiler.h"
+#include "Document.h"
+#include <stb/stb_image_write.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
 
-int main() {
-    
-    glfwInit();
+// 按图层的混合模式和不透明度把底图叠到白纸上，和 Compositor 一样每叠一层量化回 8 位
+static void Flatten(std::vector<unsigned char>& out) {
+    size_t n = (size_t)canvasW * canvasH;
+    out.assign(n * 4, 255);
+    std::vector<unsigned char> px(n * 4);
+    for (int k = 0; k < Layers::Count(); k++) {
+        const Layer& l = Layers::At(k);
+        if (!l.visible) continue;
+        Layers::Bind(l);
+        Renderer::ReadRegion(0, 0, canvasW, canvasH, px.data());
+        int o = (int)(l.opacity * 255.0f + 0.5f);
+        for (size_t i = 0; i < n; i++) {
+            const unsigned char* p = &px[i * 4];
+            if (p[3] == 0) continue;
+            int sa = (p[3] * o + 127) / 255;
+            for (int c = 0; c < 3; c++) {
+                int s = (p[c] * o + 127) / 255, d = out[i * 4 + c], keep = (d * (255 - sa) + 127) / 255;
+                switch (l.blend) {
+                case BlendMode::Multiply: d = (s * d + 127) / 255 + keep; break;
+                case BlendMode::Screen: d = s + (d * (255 - s) + 127) / 255; break;
+                case BlendMode::Add: d = s + d; break;
+                default: d = s + keep; break;
+                }
+                out[i * 4 + c] = (unsigned char)std::min(d, 255);
+            }
+        }
+    }
+    Layers::Bind(Layers::Active());
+}
+
+// 无窗口渲染：PaintApp --headless in.pdoc out.png
+// 不建窗口也不碰 GL，用软件后端把每一层的笔画烘焙进底图，叠好后存成 PNG（无显卡的渲染机用）
+static int RunHeadless(const char* in, const char* out) {
+    Renderer::Init(BakeBackend::Software);
+    Renderer::WaitForAssets();
+    Layers::Reset();
+    if (!Document::Load(in)) {
+        std::cerr << Document::status << std::endl;
+        return 1;
+    }
+    while (Document::Loading()) {
+        Document::Pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int k = 0; k < Layers::Count(); k++) {
+        Layer& l = Layers::At(k);
+        Layers::Bind(l);
+        Renderer::BakeStrokes(l.strokes, 0, l.strokes.size());
+    }
+    std::vector<unsigned char> px;
+    Flatten(px);
+    if (!stbi_write_png(out, canvasW, canvasH, 4, px.data(), canvasW * 4)) {
+        std::cerr << "Failed to write " << out << std::endl;
+        return 1;
+    }
+    std::cout << "Rendered " << in << " -> " << out << " (" << canvasW << " x " << canvasH << ")" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && strcmp(argv[1], "--headless") == 0) return RunHeadless(argv[2], argv[3]);
+
+    // 没有显示器或显卡不支持时说清楚原因就退出；交互界面离不开窗口，无窗口渲染走 --headless
+    glfwSetErrorCallback([](int code, const char* desc) { std::cerr << "GLFW error " << code << ": " << desc << std::endl; });
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW (no display?). Use --headless in.pdoc out.png to render without a window." << std::endl;
+        return 1;
+    }
     GLFWwindow* window = glfwCreateWindow(1280, 720, "Multi-File Paint", NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create an OpenGL window. Use --headless in.pdoc out.png to render without a GPU." << std::endl;
+        glfwTerminate();
+        return 1;
+    }
     glfwMakeContextCurrent(window);
-    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
-    
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "Failed to load OpenGL functions. Use --headless in.pdoc out.png to render without a GPU." << std::endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 1;
+    }
+
+    // 先装采样回调，ImGui 装自己的回调时会把它串在后面
+    InputQueue::Install(window);
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
     Renderer::Init();
+    Layers::Reset();
+    Compositor::Init();
+    TileCanvas::knownPixels = History::Known;
     bool pendingBake = false;
+    // 没事做时睡到下一个事件，超时只是给输入框的光标闪烁用；醒来后先画几帧让悬停之类的状态稳定下来
+    const double IDLE_TIMEOUT = 0.5;
+    const int SETTLE_FRAMES = 3;
+    int settle = SETTLE_FRAMES;
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+#ifdef PAINT_PROFILE
+        Profiler::FrameMark();
+#endif
+        {
+            PROFILE_SCOPE("glfwPollEvents");
+            if (settle == 0 && !AppUI::Busy()) {
+                glfwWaitEventsTimeout(IDLE_TIMEOUT);
+                settle = SETTLE_FRAMES;
+            } else {
+                glfwPollEvents();
+                if (settle > 0) settle--;
+            }
+        }
+        {
+            PROFILE_SCOPE("NewFrame");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
 
+        Renderer::PumpAssets();
         AppUI::Render(pendingBake);
+#ifdef PAINT_PROFILE
+        Profiler::DrawOverlay();
+#endif
 
-        ImGui::Render();
+        {
+            PROFILE_SCOPE("ImGui::Render");
+            ImGui::Render();
+        }
+        ImDrawData* drawData = ImGui::GetDrawData();
+        AppUI::RecordFrameStats(drawData);
+        PROFILE_COUNTER("vertices", drawData->TotalVtxCount);
+        PROFILE_COUNTER("indices", drawData->TotalIdxCount);
         glViewport(0, 0, 1280, 720);
         glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE("RenderDrawData");
+#ifdef PAINT_PROFILE
+            Profiler::GpuBegin();
+#endif
+            Renderer::RenderDrawData(drawData);
+#ifdef PAINT_PROFILE
+            Profiler::GpuEnd();
+#endif
+        }
+        Renderer::EndFrame();
+        {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
     }
 
     return 0;
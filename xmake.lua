@@ -11,4 +11,96 @@ target("PaintApp")
     set_kind("binary")
     add_files("src/*.cpp")
     add_packages("imgui", "glfw", "opengl", "glad", "stb")
-    set_languages("c++17")
\ No newline at end of file
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+    -- 分阶段计时和 Profiler 浮层只在 debug 下编进来
+    if is_mode("debug") then
+        add_defines("PAINT_PROFILE")
+    end
+
+-- 橡皮擦命中测试的基准：xmake run EraserBench
+target("EraserBench")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/EraserBench.cpp", "src/CanvasLogic.cpp", "src/StrokeIndex.cpp", "src/BrushRegistry.cpp",
+              "src/Common.cpp", "src/ThreadPool.cpp", "src/StrokeStore.cpp")
+    add_includedirs("src")
+    add_packages("imgui", "glad")
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- 无窗口回放输入录制 / 内置负载：xmake run ReplayBench [grass|sketch10k|eraser|ellipses|file.rec ...]
+target("ReplayBench")
+    set_rundir("$(projectdir)")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/ReplayBench.cpp", "src/CanvasLogic.cpp", "src/StrokeIndex.cpp", "src/BrushRegistry.cpp",
+              "src/InputRecorder.cpp", "src/Common.cpp", "src/ThreadPool.cpp", "src/StrokeStore.cpp")
+    add_includedirs("src")
+    add_packages("imgui", "glad")
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- 笔画存储布局对比（std::vector<Stroke> vs 点 arena + 属性列）：xmake run StrokeStoreBench
+target("StrokeStoreBench")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/StrokeStoreBench.cpp", "src/StrokeStore.cpp", "src/CanvasLogic.cpp", "src/StrokeIndex.cpp",
+              "src/BrushRegistry.cpp", "src/Common.cpp", "src/ThreadPool.cpp")
+    add_includedirs("src")
+    add_packages("imgui", "glad")
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- 印章旋转的批量 (SSE) 路径和标量 StampSinCos 逐位对比，不一致时返回 1：xmake run StampGenBench
+target("StampGenBench")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/StampGenBench.cpp", "src/StrokeStore.cpp", "src/CanvasLogic.cpp", "src/StrokeIndex.cpp",
+              "src/BrushRegistry.cpp", "src/Common.cpp", "src/ThreadPool.cpp")
+    add_includedirs("src")
+    add_packages("imgui", "glad")
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- 顶点拉取印章和 CPU 顶点两条路径的上传量 / 帧时间 / 像素对比（需要 GL 3.3，没显卡时用 llvmpipe）：
+-- LIBGL_ALWAYS_SOFTWARE=1 xmake run StampBench
+target("StampBench")
+    set_rundir("$(projectdir)")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/StampBench.cpp", "src/Renderer.cpp", "src/SoftRenderer.cpp", "src/TileCanvas.cpp", "src/AssetCache.cpp",
+              "src/BrushRegistry.cpp", "src/Common.cpp", "src/StrokeStore.cpp", "src/CanvasLogic.cpp", "src/StrokeIndex.cpp",
+              "src/ThreadPool.cpp")
+    add_includedirs("src")
+    add_packages("imgui", "glfw", "opengl", "glad", "stb")
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- GL 和软件烘焙后端逐像素对比，结果和差异图存成 PNG（需要 GL 3.3，没显卡时用 llvmpipe）：
+-- LIBGL_ALWAYS_SOFTWARE=1 xmake run BackendBench
+target("BackendBench")
+    set_rundir("$(projectdir)")
+    set_kind("binary")
+    set_default(false)
+    add_files("bench/BackendBench.cpp", "src/Renderer.cpp", "src/SoftRenderer.cpp", "src/TileCanvas.cpp", "src/AssetCache.cpp",
+              "src/BrushRegistry.cpp", "src/Common.cpp", "src/StrokeStore.cpp", "src/CanvasLogic.cpp", "src/StrokeIndex.cpp",
+              "src/ThreadPool.cpp")
+    add_includedirs("src")
+    add_packages("imgui", "glfw", "opengl", "glad", "stb")
+    set_languages("c++17")
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end